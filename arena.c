@@ -0,0 +1,75 @@
+#define _GNU_SOURCE // memfd_create, fallocate
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "arena.h"
+
+void initArena(MemArena *a) {
+  a->fd = -1;
+  a->units = 0;
+  a->releases = a->releasedUnits = 0;
+  a->residentKb = a->peakResidentKb = 0;
+}
+
+/* Makes a sparse memfd of units mb. It is not close-on-exec, job
+   processes inherit it and map their own part.
+   Returns false if the kernel has no memfd or the size is refused */
+bool openArena(MemArena *a, int units) {
+  initArena(a);
+  a->fd = memfd_create("hostd-arena", 0);
+  if (a->fd < 0) {
+    perror("memfd_create");
+    return false;
+  }
+  if (ftruncate(a->fd, (off_t)units * ARENA_UNIT) < 0) {
+    perror("ftruncate");
+    closeArena(a);
+    return false;
+  }
+  a->units = units;
+  return true;
+}
+
+/* Gives the pages of a freed extent back to the host */
+void releaseArena(MemArena *a, int start, int size) {
+  if (a->fd < 0 || size <= 0) return;
+  sampleArena(a); // the extent's pages count until now
+  if (fallocate(a->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                (off_t)start * ARENA_UNIT, (off_t)size * ARENA_UNIT) < 0) {
+    perror("fallocate");
+    return;
+  }
+  a->releases++;
+  a->releasedUnits += size;
+}
+
+/* Notes how much of the arena is in host memory right now, which is
+   every page some job touched and that was not released since */
+void sampleArena(MemArena *a) {
+  struct stat st;
+  if (a->fd < 0 || fstat(a->fd, &st) < 0) return;
+  a->residentKb = (long)st.st_blocks / 2; // st_blocks counts 512 byte blocks
+  if (a->residentKb > a->peakResidentKb) a->peakResidentKb = a->residentKb;
+}
+
+void closeArena(MemArena *a) {
+  if (a->fd >= 0) close(a->fd);
+  a->fd = -1;
+}
+
+/* Page faults are those of reaped job processes, so this belongs after
+   the children are gone */
+void printArenaReport(FILE *out, MemArena *a) {
+  sampleArena(a);
+  struct rusage usage;
+  getrusage(RUSAGE_CHILDREN, &usage);
+  fprintf(out, "\nMEMORY ARENA =====================================\n");
+  fprintf(out, "Backing: %d mb memfd\n", a->units);
+  fprintf(out, "Resident: %.1f mb at the end, %.1f mb at most\n", a->residentKb / 1024.0,
+      a->peakResidentKb / 1024.0);
+  fprintf(out, "Released: %ld extents, %ld mb\n", a->releases, a->releasedUnits);
+  fprintf(out, "Job page faults: %ld minor, %ld major\n", usage.ru_minflt, usage.ru_majflt);
+}
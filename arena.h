@@ -0,0 +1,32 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#define ARENA_UNIT (1L << 20) // bytes per unit of the memory map, 1 mb
+
+/* Real pages behind the simulated memory. The whole machine memory is
+   one memfd, unit u of the memory map at offset u * ARENA_UNIT, and a
+   job process maps just the extent it was given. The file is sparse,
+   so only pages a job has touched take host memory, and an extent is
+   punched out when it is freed so the next job there starts from zero
+   pages */
+typedef struct memArena {
+  int fd;              // -1 when memory is only booked, not backed
+  int units;
+  long releases;       // extents punched out
+  long releasedUnits;
+  long residentKb;     // last sample
+  long peakResidentKb;
+} MemArena;
+
+void initArena(MemArena *a);
+bool openArena(MemArena *a, int units);
+void releaseArena(MemArena *a, int start, int size);
+void sampleArena(MemArena *a);
+void closeArena(MemArena *a);
+void printArenaReport(FILE *out, MemArena *a);
+
+#endif
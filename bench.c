@@ -0,0 +1,526 @@
+#include "hostd.h"
+#include <fcntl.h>
+#include "runner.h"
+
+/* hostd-bench: generates a set of workloads with hostd-gen, replays each
+   one through hostd --virtual-time --stats and prints a table of how the
+   dispatcher itself performed. Each scenario is run several times and
+   the run with the median wall time is reported.
+   With --feedback it instead replays one workload under each scheduling
+   policy and a set of feedback queue settings and compares the
+   schedules they produce, and --compaction does the same for memory
+   compaction settings. --submit measures how fast a dispatcher started
+   with --listen takes jobs from hostd-submit at several batch sizes */
+
+#define GEN_PATH "./hostd-gen"
+#define HOSTD_PATH "./hostd"
+#define SUBMIT_PATH "./hostd-submit"
+#define MAX_ARGS 32
+
+typedef struct scenario {
+  const char *name;
+  const char *genArgs;    // passed to hostd-gen along with -n
+  const char *hostdArgs;  // passed to hostd along with -t -s
+} Scenario;
+
+static Scenario scenarios[] = {
+  {"light",        "-r 0.2 -c exp:4",              "-c 1"},
+  {"saturated",    "-r 1 -c exp:4",                "-c 4"},
+  {"overload",     "-r 2 -c exp:4",                "-c 4"},
+  {"bursty",       "-a burst -B 50 -r 1 -c exp:4", "-c 4"},
+  {"heavy-tail",   "-r 0.5 -c pareto:6",           "-c 4"},
+  {"rt-heavy",     "-r 1 -m 5,1,1,1 -c exp:3",     "-c 4"},
+  {"mem-first",    "-r 2 -M exp:200 -d 0",         "-c 8 -f first"},
+  {"mem-best",     "-r 2 -M exp:200 -d 0",         "-c 8 -f best"},
+  {"mem-next",     "-r 2 -M exp:200 -d 0",         "-c 8 -f next"},
+  {"devices",      "-r 1 -d 0.5",                  "-c 4"},
+};
+#define NUM_SCENARIOS (int)(sizeof(scenarios) / sizeof(scenarios[0]))
+
+/* Scheduling policies and feedback queue settings compared by --feedback */
+typedef struct setting {
+  const char *name;
+  const char *hostdArgs;
+} Setting;
+
+static Setting settings[] = {
+  {"default",      ""},
+  {"short-q",      "-q 250ms,500ms,1s"},
+  {"rising-q",     "-q 1s,2s,4s"},
+  {"long-q",       "-q 4s"},
+  {"boost-10s",    "-b 10s"},
+  {"boost-60s",    "-b 60s"},
+  {"age-5s",       "-a 5s"},
+  {"age-20s",      "-a 20s"},
+  {"short+boost",  "-q 250ms,500ms,1s -b 10s"},
+  {"rising+age",   "-q 1s,2s,4s -a 5s"},
+  {"fcfs",         "-S fcfs"},
+  {"sjf",          "-S sjf"},
+  {"srtf",         "-S srtf"},
+  {"lottery",      "-S lottery"},
+};
+#define NUM_SETTINGS (int)(sizeof(settings) / sizeof(settings[0]))
+
+/* Memory compaction settings compared by --compaction, off first since
+   the others are measured against it */
+static Setting compactSettings[] = {
+  {"off",          ""},
+  {"frag-0.2",     "-C 0.2"},
+  {"frag-0.5",     "-C 0.5"},
+  {"frag-0.8",     "-C 0.8"},
+  {"wait-10s",     "-w 10s"},
+  {"wait-60s",     "-w 60s"},
+  {"frag+wait",    "-C 0.5 -w 60s"},
+};
+#define NUM_COMPACT_SETTINGS (int)(sizeof(compactSettings) / sizeof(compactSettings[0]))
+
+// heavy tailed cpu bursts, mostly p1 arrivals, at a load 4 cpus only just keep up with
+#define FEEDBACK_GEN_ARGS "-r 1 -m 1,6,2,2 -c pareto:4 -d 0"
+#define FEEDBACK_HOSTD_ARGS "-c 4"
+// user jobs only, heavy tailed memory so large jobs get stuck behind holes
+#define COMPACT_GEN_ARGS "-r 1 -m 0,1,1,1 -M pareto:200 -d 0 -c exp:6"
+#define COMPACT_HOSTD_ARGS "-c 8"
+
+// jobs per message tried by --submit
+static const int submitBatches[] = {1, 16, 256, 2048};
+#define NUM_SUBMIT_BATCHES (int)(sizeof(submitBatches) / sizeof(submitBatches[0]))
+
+/* The numbers picked out of hostd's stats line */
+typedef struct result {
+  double wall, jobsPerSec, tickCpu, tickCpuMax, allocNs;
+  long ticks;
+  int jobs, maxUser, maxP3;
+} Result;
+
+/* Pulls the fields we report out of a "stats key=value ..." line */
+static bool parseStats(const char *text, Result *r) {
+  const char *line = strstr(text, "stats ticks=");
+  if (line == NULL) return false;
+  memset(r, 0, sizeof(*r));
+  const char *p;
+  if ((p = strstr(line, " ticks=")) != NULL) r->ticks = atol(p + 7);
+  if ((p = strstr(line, " wall_s=")) != NULL) r->wall = atof(p + 8);
+  if ((p = strstr(line, " jobs=")) != NULL) r->jobs = atoi(p + 6);
+  if ((p = strstr(line, " jobs_per_s=")) != NULL) r->jobsPerSec = atof(p + 12);
+  if ((p = strstr(line, " tick_cpu_us=")) != NULL) r->tickCpu = atof(p + 13);
+  if ((p = strstr(line, " tick_cpu_max_us=")) != NULL) r->tickCpuMax = atof(p + 17);
+  if ((p = strstr(line, " alloc_ns_per_call=")) != NULL) r->allocNs = atof(p + 19);
+  if ((p = strstr(line, " q_user=")) != NULL) r->maxUser = atoi(strchr(p, '/') + 1);
+  if ((p = strstr(line, " q_p3=")) != NULL) r->maxP3 = atoi(strchr(p, '/') + 1);
+  return true;
+}
+
+/* Replays list quietly with the given options. Returns false if hostd
+   failed, otherwise its stdout and stderr are left in malloc'd strings */
+static bool runSetting(const char *list, const char *hostdArgs, const char *settingArgs,
+                       const char *extraArgs, char **out, char **err) {
+  char outPath[] = "/tmp/hostd-bench-out.XXXXXX";
+  int outFd = mkstemp(outPath);
+  if (outFd < 0) {
+    perror("mkstemp");
+    return false;
+  }
+  unlink(outPath);
+
+  char *argv[MAX_ARGS];
+  char *words = strdup(hostdArgs), *setting = strdup(settingArgs);
+  char *extra = strdup(extraArgs);
+  int argc = 0;
+  argv[argc++] = HOSTD_PATH;
+  argv[argc++] = "-t";
+  argv[argc++] = "-s";
+  argv[argc++] = "-L";
+  argv[argc++] = "quiet";
+  argc = appendWords(argv, argc, MAX_ARGS, words);
+  argc = appendWords(argv, argc, MAX_ARGS, setting);
+  argc = appendWords(argv, argc, MAX_ARGS, extra);
+  argv[argc++] = (char *)list;
+  argv[argc] = NULL;
+
+  *err = runProgram(argv, outFd, NULL);
+  lseek(outFd, 0, SEEK_SET);
+  *out = readAll(outFd);
+  close(outFd);
+  free(words);
+  free(setting);
+  free(extra);
+  return *err != NULL;
+}
+
+/* Replays list under every feedback setting and prints simulated
+   throughput and turnaround tails of each user class */
+static int compareFeedback(const char *list, const char *hostdArgs, const char *extraArgs) {
+  int failures = 0, i, c;
+  printf("%-12s %8s %9s %10s %8s %8s %8s %8s %8s %8s\n", "SETTING", "JOBS", "SIM(s)",
+      "JOBS/SIM-s", "P1-P50", "P1-P99", "P2-P99", "P3-P50", "P3-P99", "P3-MAX");
+  for (i = 0; i < NUM_SETTINGS; i++) {
+    char *out, *err;
+    runSetting(list, hostdArgs, settings[i].hostdArgs, extraArgs, &out, &err);
+
+    Result r;
+    MetricRow t[3];
+    bool ok = err != NULL && parseStats(err, &r);
+    const char *classes[3] = {"p1", "p2", "p3"};
+    for (c = 0; c < 3 && ok; c++) {
+      if (!parseMetric(out, classes[c], "turnaround", &t[c])) memset(&t[c], 0, sizeof(t[c]));
+    }
+    const char *sim = err ? strstr(err, " sim_s=") : NULL;
+    double simSecs = sim ? atof(sim + 7) : 0;
+    free(err);
+    free(out);
+    if (!ok) {
+      printf("%-12s hostd failed\n", settings[i].name);
+      failures++;
+      continue;
+    }
+    printf("%-12s %8d %9.0f %10.3f %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f\n",
+        settings[i].name, r.jobs, simSecs, simSecs > 0 ? r.jobs / simSecs : 0.0,
+        t[0].p50, t[0].p99, t[1].p99, t[2].p50, t[2].p99, t[2].max);
+    fflush(stdout);
+  }
+  return failures;
+}
+
+/* Replays list under every compaction setting and prints how long user
+   jobs waited for memory and devices, how much less that was per job
+   than with compaction off, and what the compaction passes moved */
+static int compareCompaction(const char *list, const char *hostdArgs, const char *extraArgs) {
+  int failures = 0, i, c;
+  double baseline = -1;
+  printf("%-12s %8s %9s %9s %9s %9s %10s %8s %10s\n", "SETTING", "JOBS", "SIM(s)",
+      "RES-MEAN", "RES-P99", "RES-MAX", "SAVED/JOB", "PASSES", "MOVED(mb)");
+  for (i = 0; i < NUM_COMPACT_SETTINGS; i++) {
+    char *out, *err;
+    bool ok = runSetting(list, hostdArgs, compactSettings[i].hostdArgs, extraArgs, &out, &err);
+    Result r;
+    ok = ok && parseStats(err, &r);
+
+    // the resource wait of every user class, weighted by jobs
+    const char *classes[3] = {"p1", "p2", "p3"};
+    double total = 0, p99 = 0, max = 0;
+    unsigned long jobs = 0;
+    for (c = 0; c < 3 && ok; c++) {
+      MetricRow t;
+      if (!parseMetric(out, classes[c], "resources", &t)) continue;
+      total += t.mean * t.jobs;
+      jobs += t.jobs;
+      if (t.p99 > p99) p99 = t.p99;
+      if (t.max > max) max = t.max;
+    }
+    const char *sim = err ? strstr(err, " sim_s=") : NULL;
+    double simSecs = sim ? atof(sim + 7) : 0;
+    const char *passes = strstr(out, "Passes: ");
+    const char *moved = strstr(out, "Moved: ");
+    free(err);
+    if (!ok) {
+      printf("%-12s hostd failed\n", compactSettings[i].name);
+      free(out);
+      failures++;
+      continue;
+    }
+    double mean = jobs > 0 ? total / jobs : 0;
+    if (baseline < 0) baseline = mean;
+    printf("%-12s %8d %9.0f %9.1f %9.1f %9.1f %10.1f %8ld %10ld\n",
+        compactSettings[i].name, r.jobs, simSecs, mean, p99, max, baseline - mean,
+        passes ? atol(passes + 8) : 0L, moved ? atol(moved + 7) : 0L);
+    fflush(stdout);
+    free(out);
+  }
+  return failures;
+}
+
+static int compareWall(const void *a, const void *b) {
+  double x = ((const Result *)a)->wall, y = ((const Result *)b)->wall;
+  return (x > y) - (x < y);
+}
+
+/* Replays one dispatch list repeats times and keeps the median run */
+static bool benchList(const char *name, const char *list, const char *hostdArgs,
+                      const char *extraArgs, int repeats, int devNull) {
+  Result *runs = malloc(repeats * sizeof(Result));
+  assert(runs != NULL);
+  int i;
+  for (i = 0; i < repeats; i++) {
+    char *argv[MAX_ARGS];
+    char *words = strdup(hostdArgs), *extra = strdup(extraArgs);
+    int argc = 0;
+    argv[argc++] = HOSTD_PATH;
+    argv[argc++] = "-t";
+    argv[argc++] = "-s";
+    argc = appendWords(argv, argc, MAX_ARGS, words);
+    argc = appendWords(argv, argc, MAX_ARGS, extra);
+    argv[argc++] = (char *)list;
+    argv[argc] = NULL;
+
+    char *text = runProgram(argv, devNull, NULL);
+    bool ok = text != NULL && parseStats(text, &runs[i]);
+    free(text);
+    free(words);
+    free(extra);
+    if (!ok) {
+      printf("%-12s hostd failed\n", name);
+      free(runs);
+      return false;
+    }
+  }
+
+  qsort(runs, repeats, sizeof(Result), compareWall);
+  Result *r = &runs[repeats / 2];
+  printf("%-12s %8d %9ld %9.3f %10.0f %9.2f %9.1f %9.1f %6d %6d\n",
+      name, r->jobs, r->ticks, r->wall, r->jobsPerSec, r->tickCpu,
+      r->tickCpuMax, r->allocNs, r->maxUser, r->maxP3);
+  fflush(stdout);
+  free(runs);
+  return true;
+}
+
+/* One hostd-submit --load run */
+typedef struct submitResult {
+  double jobsPerSec, usPerMessage;
+  long messages;
+} SubmitResult;
+
+static int compareSubmitRate(const void *a, const void *b) {
+  double x = ((const SubmitResult *)a)->jobsPerSec, y = ((const SubmitResult *)b)->jobsPerSec;
+  return (x > y) - (x < y);
+}
+
+/* Runs one load test against sock and picks the rates out of its report */
+static bool runLoad(const char *sock, long jobs, int batch, SubmitResult *r) {
+  char outPath[] = "/tmp/hostd-bench-out.XXXXXX";
+  int outFd = mkstemp(outPath);
+  if (outFd < 0) return false;
+  unlink(outPath);
+
+  char jobsArg[32], batchArg[32];
+  snprintf(jobsArg, sizeof(jobsArg), "%ld", jobs);
+  snprintf(batchArg, sizeof(batchArg), "%d", batch);
+  char *argv[] = {SUBMIT_PATH, "-s", (char *)sock, "-n", jobsArg, "-b", batchArg, NULL};
+  char *err = runProgram(argv, outFd, NULL);
+  lseek(outFd, 0, SEEK_SET);
+  char *out = readAll(outFd);
+  close(outFd);
+  const char *line = strstr(out, "Submitted ");
+  bool ok = err != NULL && line != NULL &&
+    sscanf(line, "Submitted %*d jobs in %ld messages of up to %*d in %*f ms: %lf jobs/s, %lf us",
+           &r->messages, &r->jobsPerSec, &r->usPerMessage) == 3;
+  free(err);
+  free(out);
+  return ok;
+}
+
+/* Starts a dispatcher with nothing but a control socket and submits
+   jobs to it at each batch size, keeping the median of repeats runs.
+   The load test's jobs arrive an hour out, so the dispatcher only
+   takes them in and none of them runs */
+static int benchSubmit(long jobs, int repeats, const char *extraArgs, int devNull) {
+  char dir[] = "/tmp/hostd-bench.XXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  char sock[64];
+  snprintf(sock, sizeof(sock), "%s/hostd.sock", dir);
+
+  char *argv[MAX_ARGS], *extra = strdup(extraArgs);
+  int argc = 0;
+  argv[argc++] = HOSTD_PATH;
+  argv[argc++] = "-L";
+  argv[argc++] = "quiet";
+  argv[argc++] = "--listen";
+  argv[argc++] = sock;
+  argc = appendWords(argv, argc, MAX_ARGS, extra);
+  pid_t server = fork();
+  if (server == 0) {
+    dup2(devNull, STDOUT_FILENO);
+    execv(argv[0], argv);
+    _exit(127);
+  }
+  free(extra);
+  int waited;
+  for (waited = 0; waited < 100 && access(sock, F_OK) != 0; waited++) usleep(20000);
+
+  printf("%-8s %9s %12s %12s\n", "BATCH", "MESSAGES", "JOBS/s", "US/MESSAGE");
+  SubmitResult *runs = malloc(repeats * sizeof(SubmitResult));
+  assert(runs != NULL);
+  int failures = 0, b, i;
+  for (b = 0; b < NUM_SUBMIT_BATCHES; b++) {
+    bool ok = true;
+    for (i = 0; i < repeats && ok; i++) ok = runLoad(sock, jobs, submitBatches[b], &runs[i]);
+    if (!ok) {
+      printf("%-8d hostd-submit failed\n", submitBatches[b]);
+      failures++;
+      continue;
+    }
+    qsort(runs, repeats, sizeof(SubmitResult), compareSubmitRate);
+    SubmitResult *r = &runs[repeats / 2];
+    printf("%-8d %9ld %12.0f %12.1f\n", submitBatches[b], r->messages, r->jobsPerSec,
+        r->usPerMessage);
+    fflush(stdout);
+  }
+  free(runs);
+
+  // the dispatcher would wait an hour for its jobs, so it is stopped
+  kill(server, SIGTERM);
+  waitpid(server, NULL, 0);
+  unlink(sock);
+  rmdir(dir);
+  return failures;
+}
+
+static void printBenchUsage(char *name) {
+  printf("Usage: %s [options] [dispatch lists...]\n", name);
+  printf("Benchmarks the built in scenarios, or the given dispatch lists.\n");
+  printf("  -n, --jobs <n>          jobs per generated scenario (default 10000)\n");
+  printf("  -r, --repeat <n>        runs per scenario, the median is shown (default 3)\n");
+  printf("  -H, --hostd-args <str>  extra options for every hostd run, eg. \"-f best\"\n");
+  printf("  -k, --keep <dir>        keep the generated lists in dir\n");
+  printf("  -F, --feedback          compare scheduling policies and feedback queue settings\n");
+  printf("                          on one generated workload, or on the given lists\n");
+  printf("  -C, --compaction        compare memory compaction settings the same way\n");
+  printf("  -S, --submit            time submitting jobs over the control socket at several\n"
+         "                          batch sizes (try -n 100000)\n");
+}
+
+int main(int argc, char **argv) {
+  long jobs = 10000;
+  int repeats = 3;
+  const char *extraArgs = "";
+  const char *keepDir = NULL;
+  bool feedback = false, compaction = false, submit = false;
+
+  static struct option longOptions[] = {
+    {"jobs", required_argument, NULL, 'n'},
+    {"repeat", required_argument, NULL, 'r'},
+    {"hostd-args", required_argument, NULL, 'H'},
+    {"keep", required_argument, NULL, 'k'},
+    {"feedback", no_argument, NULL, 'F'},
+    {"compaction", no_argument, NULL, 'C'},
+    {"submit", no_argument, NULL, 'S'},
+    {NULL, 0, NULL, 0}
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "n:r:H:k:FCS", longOptions, NULL)) != -1) {
+    switch (opt) {
+      case 'n': jobs = atol(optarg); break;
+      case 'r': repeats = atoi(optarg); break;
+      case 'H': extraArgs = optarg; break;
+      case 'k': keepDir = optarg; break;
+      case 'F': feedback = true; break;
+      case 'C': compaction = true; break;
+      case 'S': submit = true; break;
+      default:
+        printBenchUsage(argv[0]);
+        return 1;
+    }
+  }
+  if (repeats < 1) repeats = 1;
+
+  int devNull = open("/dev/null", O_WRONLY);
+  assert(devNull >= 0);
+  int failures = 0, i;
+  if (submit) {
+    printf("%ld jobs per run, hostd --listen %s\n", jobs, extraArgs);
+    failures = benchSubmit(jobs, repeats, extraArgs, devNull);
+    close(devNull);
+    return failures ? 1 : 0;
+  }
+  if (feedback || compaction) {
+    int (*compare)(const char *, const char *, const char *) =
+      feedback ? compareFeedback : compareCompaction;
+    const char *genArgs = feedback ? FEEDBACK_GEN_ARGS : COMPACT_GEN_ARGS;
+    const char *hostdArgs = feedback ? FEEDBACK_HOSTD_ARGS : COMPACT_HOSTD_ARGS;
+    if (optind < argc) {
+      for (i = optind; i < argc; i++) {
+        printf("%s\n", argv[i]);
+        failures += compare(argv[i], "", extraArgs);
+      }
+      close(devNull);
+      return failures ? 1 : 0;
+    }
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s.txt", keepDir ? keepDir : "/tmp",
+        feedback ? "feedback" : "compaction");
+    char jobsArg[32], *gen = strdup(genArgs);
+    snprintf(jobsArg, sizeof(jobsArg), "%ld", jobs);
+    char *genArgv[MAX_ARGS];
+    int genArgc = 0;
+    genArgv[genArgc++] = GEN_PATH;
+    genArgv[genArgc++] = "-n";
+    genArgv[genArgc++] = jobsArg;
+    genArgc = appendWords(genArgv, genArgc, MAX_ARGS, gen);
+    genArgv[genArgc++] = path;
+    genArgv[genArgc] = NULL;
+    char *genOut = runProgram(genArgv, devNull, NULL);
+    free(gen);
+    if (genOut == NULL) {
+      printf("hostd-gen failed\n");
+      return 1;
+    }
+    free(genOut);
+    printf("workload: hostd-gen -n %s %s, hostd %s\n", jobsArg, genArgs, hostdArgs);
+    failures = compare(path, hostdArgs, extraArgs);
+    if (keepDir == NULL) unlink(path);
+    close(devNull);
+    return failures ? 1 : 0;
+  }
+
+  printf("%-12s %8s %9s %9s %10s %9s %9s %9s %6s %6s\n", "SCENARIO", "JOBS", "TICKS",
+      "WALL(s)", "JOBS/s", "TICK(us)", "MAX(us)", "ALLOC(ns)", "MAXUQ", "MAXP3");
+
+  if (optind < argc) {
+    // user supplied dispatch lists
+    for (i = optind; i < argc; i++) {
+      const char *base = strrchr(argv[i], '/');
+      if (!benchList(base ? base + 1 : argv[i], argv[i], "", extraArgs, repeats, devNull)) {
+        failures++;
+      }
+    }
+    close(devNull);
+    return failures ? 1 : 0;
+  }
+
+  char tmpDir[] = "/tmp/hostd-bench.XXXXXX";
+  const char *dir = keepDir;
+  if (dir == NULL) {
+    dir = mkdtemp(tmpDir);
+    if (dir == NULL) {
+      perror("mkdtemp");
+      return 1;
+    }
+  }
+
+  char jobsArg[32];
+  snprintf(jobsArg, sizeof(jobsArg), "%ld", jobs);
+  for (i = 0; i < NUM_SCENARIOS; i++) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s.txt", dir, scenarios[i].name);
+
+    char *genArgv[MAX_ARGS];
+    char *words = strdup(scenarios[i].genArgs);
+    int genArgc = 0;
+    genArgv[genArgc++] = GEN_PATH;
+    genArgv[genArgc++] = "-n";
+    genArgv[genArgc++] = jobsArg;
+    genArgc = appendWords(genArgv, genArgc, MAX_ARGS, words);
+    genArgv[genArgc++] = path;
+    genArgv[genArgc] = NULL;
+    char *genOut = runProgram(genArgv, devNull, NULL);
+    free(words);
+    if (genOut == NULL) {
+      printf("%-12s hostd-gen failed\n", scenarios[i].name);
+      failures++;
+      continue;
+    }
+    free(genOut);
+
+    if (!benchList(scenarios[i].name, path, scenarios[i].hostdArgs, extraArgs,
+                   repeats, devNull)) {
+      failures++;
+    }
+    if (keepDir == NULL) unlink(path);
+  }
+  if (keepDir == NULL) rmdir(dir);
+  close(devNull);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,18 @@
+#!/bin/sh
+# Replays a dispatch list in virtual time under every scheduler and fit
+# policy. The replay time is the only line that depends on the host, so
+# it is left out. With -q only the final reports are kept, plus a
+# checksum of the full schedule
+list=$1
+quiet=$2
+for sched in mlfq fcfs sjf srtf lottery; do
+  for fit in first best next; do
+    echo "=== -S $sched -f $fit"
+    if [ "$quiet" = "-q" ]; then
+      ./hostd -t -S $sched -f $fit "$list" | grep -v '^Replayed ' | cksum | sed 's/^/schedule checksum /'
+      ./hostd -t -L quiet -S $sched -f $fit "$list" | grep -v '^Replayed '
+    else
+      ./hostd -t -S $sched -f $fit "$list" | grep -v '^Replayed '
+    fi
+  done
+done
@@ -0,0 +1,133 @@
+#include "checkpoint.h"
+#include "queue.h"
+
+/* Starts a snapshot in path.tmp. endCheckpoint moves it over path, so a
+   crash while writing leaves the previous snapshot in place */
+FILE* beginCheckpoint(const char *path, uint32_t stateSize) {
+  char tmp[4096];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE *f = fopen(tmp, "wb");
+  if (f == NULL) return NULL;
+
+  CheckpointHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LEN);
+  h.version = CHECKPOINT_VERSION;
+  h.pcbSize = sizeof(PCB);
+  h.cpuSize = sizeof(Cpu);
+  h.stateSize = stateSize;
+  SAVE(f, h);
+  return f;
+}
+
+/* Finishes a snapshot: flushes it to disk and renames it into place.
+   Returns false, leaving the old snapshot alone, if any write failed */
+bool endCheckpoint(FILE *f, const char *path, long *bytes) {
+  char tmp[4096];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  bool ok = fflush(f) == 0 && !ferror(f) && fsync(fileno(f)) == 0;
+  *bytes = ftell(f);
+  ok = fclose(f) == 0 && ok;
+  if (ok) ok = rename(tmp, path) == 0;
+  if (!ok) unlink(tmp);
+  return ok;
+}
+
+/* Opens a snapshot and checks it was written by this build */
+FILE* openCheckpoint(const char *path, uint32_t stateSize) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) return NULL;
+  CheckpointHeader h;
+  if (!LOAD(f, h) || memcmp(h.magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LEN) != 0) {
+    fprintf(stderr, "%s: not a hostd checkpoint\n", path);
+  } else if (h.version != CHECKPOINT_VERSION || h.pcbSize != sizeof(PCB) ||
+             h.cpuSize != sizeof(Cpu) || h.stateSize != stateSize) {
+    fprintf(stderr, "%s: checkpoint was written by a different build of hostd\n", path);
+  } else {
+    return f;
+  }
+  fclose(f);
+  return NULL;
+}
+
+/* Write errors are sticky in the FILE and checked once by endCheckpoint */
+void saveBytes(FILE *f, const void *data, size_t size) {
+  fwrite(data, 1, size, f);
+}
+
+bool loadBytes(FILE *f, void *data, size_t size) {
+  return fread(data, 1, size, f) == size;
+}
+
+/* A PCB holds no pointers so it is written as it is. Its slot is not
+   kept, a restored job gets whichever one is free */
+void saveJob(FILE *f, const PCB *job) {
+  saveBytes(f, job, sizeof(PCB));
+}
+
+/* Reads a job into a fresh PCB of table t, or returns NULL if the file
+   ran out. Whichever part held it, every restored job is in the table,
+   which is where the dispatcher finds them all again (tableJobs) */
+PCB* loadJob(FILE *f, JobTable *t) {
+  PCB *job = newJob(t);
+  int slot = job->slot;
+  if (!loadBytes(f, job, sizeof(PCB))) {
+    job->slot = slot;
+    freeJob(t, job);
+    return NULL;
+  }
+  job->slot = slot;
+  syncJob(t, job);
+  return job;
+}
+
+/* A count followed by the jobs, in the order given */
+void saveJobs(FILE *f, PCB **jobs, int count) {
+  int i;
+  SAVE(f, count);
+  for (i = 0; i < count; i++) saveJob(f, jobs[i]);
+}
+
+/* Same as saveJobs for jobs kept by slot */
+void saveSlots(FILE *f, const JobTable *t, const int *slots, int count) {
+  int i;
+  SAVE(f, count);
+  for (i = 0; i < count; i++) saveJob(f, jobAt(t, slots[i]));
+}
+
+/* Reads jobs written by saveJobs or saveSlots into a new array of
+   their slots, in their saved order */
+bool loadSlots(FILE *f, JobTable *t, int **slots, int *count) {
+  int n, i;
+  *slots = NULL;
+  *count = 0;
+  if (!LOAD(f, n) || n < 0) return false;
+  if (n == 0) return true;
+  *slots = malloc(n * sizeof(int));
+  assert(*slots != NULL);
+  for (i = 0; i < n; i++) {
+    PCB *job = loadJob(f, t);
+    if (job == NULL) return false;
+    (*slots)[(*count)++] = job->slot;
+  }
+  return true;
+}
+
+void saveQueue(FILE *f, Queue *q) {
+  int count = getLength(q);
+  PCB *job;
+  SAVE(f, count);
+  for (job = q->process; job != NULL; job = nextInQueue(q, job)) saveJob(f, job);
+}
+
+/* Appends the saved jobs to q in their saved order */
+bool loadQueue(FILE *f, Queue *q) {
+  int count, i;
+  if (!LOAD(f, count) || count < 0) return false;
+  for (i = 0; i < count; i++) {
+    PCB *job = loadJob(f, q->jobs);
+    if (job == NULL) return false;
+    enqueueJob(q, job);
+  }
+  return true;
+}
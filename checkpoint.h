@@ -0,0 +1,39 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include "jobtable.h"
+
+/* Snapshot layout: a CheckpointHeader, then each part of the dispatcher
+   in a fixed order, every part written by the module that owns it.
+   Structs go in raw and in native byte order, so a snapshot is only
+   read back by the build that wrote it, which the sizes check */
+#define CHECKPOINT_MAGIC "HOSTDCKP"
+#define CHECKPOINT_MAGIC_LEN 8
+#define CHECKPOINT_VERSION 2 // 2 added the submitted jobs
+
+typedef struct checkpointHeader {
+  char magic[CHECKPOINT_MAGIC_LEN];
+  uint32_t version;
+  uint32_t pcbSize;     // sizeof(PCB) when the file was written
+  uint32_t cpuSize;
+  uint32_t stateSize;   // size of the dispatcher's own block of globals
+} CheckpointHeader;
+
+#define SAVE(f, x) saveBytes((f), &(x), sizeof(x))
+#define LOAD(f, x) loadBytes((f), &(x), sizeof(x))
+
+FILE* beginCheckpoint(const char *path, uint32_t stateSize);
+bool endCheckpoint(FILE *f, const char *path, long *bytes);
+FILE* openCheckpoint(const char *path, uint32_t stateSize);
+void saveBytes(FILE *f, const void *data, size_t size);
+bool loadBytes(FILE *f, void *data, size_t size);
+void saveJob(FILE *f, const PCB *job);
+PCB* loadJob(FILE *f, JobTable *t);
+void saveJobs(FILE *f, PCB **jobs, int count);
+void saveSlots(FILE *f, const JobTable *t, const int *slots, int count);
+bool loadSlots(FILE *f, JobTable *t, int **slots, int *count);
+void saveQueue(FILE *f, Queue *q);
+bool loadQueue(FILE *f, Queue *q);
+
+#endif
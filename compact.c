@@ -0,0 +1,106 @@
+#include <stddef.h>
+#include "compact.h"
+#include "stats.h"
+#include "trace.h"
+#include "checkpoint.h"
+
+void initMemHolders(MemHolders *h) {
+  memset(h, 0, sizeof(*h));
+}
+
+void addMemHolder(MemHolders *h, PCB *job) {
+  if (h->count == h->capacity) {
+    h->capacity = h->capacity ? h->capacity * 2 : 64;
+    h->jobs = realloc(h->jobs, h->capacity * sizeof(PCB *));
+    assert(h->jobs != NULL);
+  }
+  h->jobs[h->count++] = job;
+}
+
+/* Drops a job that gave its memory back. Holders are bounded by memory
+   size over job size, so a scan is cheap next to the rest of a tick */
+void removeMemHolder(MemHolders *h, PCB *job) {
+  int i;
+  for (i = 0; i < h->count; i++) {
+    if (h->jobs[i] == job) {
+      h->jobs[i] = h->jobs[--h->count];
+      return;
+    }
+  }
+}
+
+void freeMemHolders(MemHolders *h) {
+  free(h->jobs);
+  memset(h, 0, sizeof(*h));
+}
+
+void initCompactStats(CompactStats *s) {
+  memset(s, 0, sizeof(*s));
+  initHistogram(&s->unblocked);
+}
+
+static int compareStart(const void *a, const void *b) {
+  return (*(PCB * const *)a)->mem_start - (*(PCB * const *)b)->mem_start;
+}
+
+/* Slides every held block down to the bottom of memory, in address
+   order so a block only ever moves into space already vacated, and
+   updates each job's mem_start. All free space ends up as one block at
+   the top. Returns the units moved, which is what a real machine would
+   have to copy */
+int compactMemory(MemMap *m, MemHolders *h, CompactStats *s, bool forWait, int now) {
+  double t = statsNow();
+  qsort(h->jobs, h->count, sizeof(PCB *), compareStart);
+  int next = 0, moved = 0, i;
+  for (i = 0; i < h->count; i++) {
+    PCB *job = h->jobs[i];
+    if (job->mem_start != next) {
+      int from = job->mem_start;
+      moveMemBlock(m, from, next, job->mem_req);
+      job->mem_start = next;
+      moved += job->mem_req;
+      s->relocations++;
+      traceEvent(TRACE_MEM_MOVE, now, now, -1, from, job);
+    }
+    next += job->mem_req;
+  }
+  t = statsNow() - t;
+
+  s->passes++;
+  if (forWait) s->forWait++;
+  else s->forFragmentation++;
+  s->unitsMoved += moved;
+  if (moved > s->maxMoved) s->maxMoved = moved;
+  s->hostMicros += t;
+  if (t > s->maxHostMicros) s->maxHostMicros = t;
+  return moved;
+}
+
+/* Prints how often memory was compacted, what it cost and how long the
+   jobs it let in had been kept out */
+void printCompactReport(FILE *out, CompactStats *s, int tickMillis) {
+  double secs = tickMillis / 1000.0;
+  int prec = (tickMillis % 1000 == 0) ? 0 : 3;
+  Histogram *h = &s->unblocked;
+  fprintf(out, "COMPACTION REPORT ====================================\n");
+  fprintf(out, "Passes: %ld (%ld for fragmentation, %ld for a long wait)\n",
+      s->passes, s->forFragmentation, s->forWait);
+  fprintf(out, "Moved: %ld mb in %ld relocations, at most %d mb in one pass\n",
+      s->unitsMoved, s->relocations, s->maxMoved);
+  fprintf(out, "Dispatcher time: %.3f ms, longest pass %.3f ms\n",
+      s->hostMicros / 1000, s->maxHostMicros / 1000);
+  fprintf(out, "Jobs let in by a pass: %lu, kept out for p50 %.*f p99 %.*f max %.*f seconds\n",
+      (unsigned long)h->total, prec, valueAtPercentile(h, 50) * secs,
+      prec, valueAtPercentile(h, 99) * secs, prec, h->max * secs);
+  fprintf(out, "======================================================\n\n");
+}
+
+/* The counters go in as they are, the histogram only as far as it is used */
+void saveCompactStats(FILE *f, CompactStats *s) {
+  saveBytes(f, s, offsetof(CompactStats, unblocked));
+  saveHistogram(f, &s->unblocked);
+}
+
+bool loadCompactStats(FILE *f, CompactStats *s) {
+  return loadBytes(f, s, offsetof(CompactStats, unblocked)) && loadHistogram(f, &s->unblocked);
+}
@@ -0,0 +1,45 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include <stdio.h>
+#include "hostd.h"
+#include "memory.h"
+#include "histogram.h"
+
+/* When user memory is compacted. Either trigger can be off */
+typedef struct compactConfig {
+  double threshold; // fragmentation (0-1) that starts a pass, < 0 for never
+  int after;        // ticks a job kept out only by holes may wait, < 0 for never
+} CompactConfig;
+
+/* Every job that holds memory, so a pass can find and move them */
+typedef struct memHolders {
+  PCB **jobs;
+  int count;
+  int capacity;
+} MemHolders;
+
+/* What compaction cost and what it let in */
+typedef struct compactStats {
+  long passes;
+  long forFragmentation; // passes started by the threshold
+  long forWait;          // passes started by a job waiting too long
+  long unitsMoved;
+  long relocations;
+  int maxMoved;          // most units moved by a single pass
+  double hostMicros;     // dispatcher time spent compacting
+  double maxHostMicros;
+  Histogram unblocked;   // ticks waited by jobs that only fit once a pass was done
+} CompactStats;
+
+void initMemHolders(MemHolders *h);
+void addMemHolder(MemHolders *h, PCB *job);
+void removeMemHolder(MemHolders *h, PCB *job);
+void freeMemHolders(MemHolders *h);
+void initCompactStats(CompactStats *s);
+int compactMemory(MemMap *m, MemHolders *h, CompactStats *s, bool forWait, int now);
+void printCompactReport(FILE *out, CompactStats *s, int tickMillis);
+void saveCompactStats(FILE *f, CompactStats *s);
+bool loadCompactStats(FILE *f, CompactStats *s);
+
+#endif
@@ -0,0 +1,183 @@
+#include "control.h" // first, for _GNU_SOURCE (accept4)
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+/* The listening socket and every connected client sit in an epoll set
+   of their own. That set's descriptor is what the supervisor watches,
+   so one readable client wakes the dispatcher however many there are.
+   Everything is non-blocking and served from the dispatcher's thread
+   between ticks, so requests see the queues as a tick left them */
+
+static int listenFd = -1;
+static int pollFd = -1;
+static char socketPath[108]; // sun_path, removed again on close
+static int columns = DISPATCH_DEFAULT_RESOURCES; // device columns in a job line
+static char request[CONTROL_MAX_MESSAGE + 1];
+static char reply[CONTROL_MAX_MESSAGE];
+static JobRecord *records;
+static int recordsCap = 0;
+
+/* Listens on path, replacing a socket left behind by a dispatcher that
+   is gone but not one that is still answering. resources is the number
+   of device columns a job line has */
+bool openControl(const char *path, int resources) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "%s: socket path too long\n", path);
+    return false;
+  }
+  strcpy(addr.sun_path, path);
+  columns = resources;
+
+  int probe = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (probe >= 0 && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+    fprintf(stderr, "%s: another dispatcher is listening there\n", path);
+    close(probe);
+    return false;
+  }
+  if (probe >= 0) close(probe);
+  unlink(path);
+
+  listenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  pollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (listenFd < 0 || pollFd < 0 ||
+      bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFd, 64) < 0) {
+    perror(path);
+    closeControl();
+    return false;
+  }
+  strcpy(socketPath, path);
+
+  struct epoll_event ev = {0};
+  ev.events = EPOLLIN;
+  ev.data.fd = listenFd;
+  return epoll_ctl(pollFd, EPOLL_CTL_ADD, listenFd, &ev) == 0;
+}
+
+/* Readable whenever a client is waiting to connect or has sent something */
+int controlFd() {
+  return pollFd;
+}
+
+static void dropClient(int fd) {
+  epoll_ctl(pollFd, EPOLL_CTL_DEL, fd, NULL);
+  close(fd);
+}
+
+static void acceptClients() {
+  int fd;
+  while ((fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(pollFd, EPOLL_CTL_ADD, fd, &ev) < 0) close(fd);
+  }
+}
+
+/* Takes the job lines of a batch and hands them over in one go.
+   Returns the length of the reply */
+static int submitBatch(const ControlHandlers *h, char *msg, char *end) {
+  int count = 0, lines = 0;
+  char *s = msg;
+  while (s < end) {
+    char *nl = memchr(s, '\n', end - s);
+    char *e = nl ? nl : end;
+    lines++;
+    if (!jobLineEmpty(s, e)) {
+      if (count == recordsCap) {
+        recordsCap = recordsCap ? recordsCap * 2 : 256;
+        records = realloc(records, recordsCap * sizeof(JobRecord));
+        assert(records != NULL);
+      }
+      if (!parseJobRecord(s, e, columns, &records[count])) {
+        return snprintf(reply, sizeof(reply), "error line %d: malformed job\n", lines);
+      }
+      count++;
+    }
+    s = e + 1;
+  }
+  if (count == 0) return snprintf(reply, sizeof(reply), "ok 0 0\n");
+
+  int refused = -1;
+  const char *why = "";
+  int first = h->submit(records, count, &refused, &why);
+  if (first >= 0) return snprintf(reply, sizeof(reply), "ok %d %d\n", count, first);
+  if (refused < 0) return snprintf(reply, sizeof(reply), "error %s\n", why);
+  return snprintf(reply, sizeof(reply), "error job %d: %s\n", refused + 1, why);
+}
+
+/* Works out what a request asks for and writes the reply */
+static int answer(const ControlHandlers *h, char *msg, int len) {
+  char *end = msg + len, *s = msg;
+  while (s < end && (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')) s++;
+  if (s == end || (*s >= '0' && *s <= '9') || *s == '#') return submitBatch(h, msg, end);
+
+  // a command is a single word
+  while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n')) end--;
+  *end = '\0';
+  if (strcmp(s, "status") == 0) {
+    int n = snprintf(reply, sizeof(reply), "ok\n");
+    return n + h->status(reply + n, sizeof(reply) - n);
+  }
+  if (strcmp(s, "shutdown") == 0) {
+    h->shutdown();
+    return snprintf(reply, sizeof(reply), "ok\n");
+  }
+  return snprintf(reply, sizeof(reply), "error unknown command %.64s\n", s);
+}
+
+/* Reads every request a client has sent. A client that stopped reading
+   its replies, or hung up, is dropped */
+static void serveClient(const ControlHandlers *h, int fd) {
+  while (1) {
+    ssize_t n = recv(fd, request, CONTROL_MAX_MESSAGE, MSG_DONTWAIT | MSG_TRUNC);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && errno == EAGAIN) return;
+    if (n <= 0) {
+      dropClient(fd);
+      return;
+    }
+
+    int len;
+    if (n > CONTROL_MAX_MESSAGE) {
+      len = snprintf(reply, sizeof(reply), "error request longer than %d bytes\n", CONTROL_MAX_MESSAGE);
+    } else {
+      request[n] = '\0';
+      len = answer(h, request, n);
+    }
+    if (len > (int)sizeof(reply)) len = sizeof(reply);
+    if (send(fd, reply, len, MSG_DONTWAIT | MSG_NOSIGNAL) != len) {
+      dropClient(fd);
+      return;
+    }
+  }
+}
+
+/* Answers everything that has come in on the control socket */
+void serveControl(const ControlHandlers *h) {
+  struct epoll_event ready[32];
+  int n, i;
+  while ((n = epoll_wait(pollFd, ready, 32, 0)) > 0) {
+    for (i = 0; i < n; i++) {
+      if (ready[i].data.fd == listenFd) acceptClients();
+      else serveClient(h, ready[i].data.fd);
+    }
+  }
+}
+
+/* Stops listening and removes the socket. Connected clients see their
+   connection close once the dispatcher exits */
+void closeControl() {
+  if (pollFd >= 0) close(pollFd);
+  if (listenFd >= 0) close(listenFd);
+  if (socketPath[0] != '\0') unlink(socketPath);
+  pollFd = listenFd = -1;
+  socketPath[0] = '\0';
+  free(records);
+  records = NULL;
+  recordsCap = 0;
+}
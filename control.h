@@ -0,0 +1,32 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include "dispatchlist.h"
+
+/* The control socket is a unix domain SOCK_SEQPACKET socket, so every
+   request and every reply is one message and keeps its boundaries.
+   A request is either a command word or a batch of job lines in the
+   dispatch list format, with the arrival time counted in seconds from
+   when the batch is received. Replies start with "ok" or "error":
+     <job lines>  ok <jobs> <id of the first>   (all or none are taken)
+     status       ok, then one "<name> <value>..." line per figure
+     shutdown     ok, no more jobs are taken and the dispatcher exits
+                  once the ones it has are done */
+#define CONTROL_DEFAULT_PATH "hostd.sock"
+#define CONTROL_MAX_MESSAGE 65536 // longest request or reply
+
+/* What the dispatcher does for each request. submit returns the id
+   given to the first job, or -1 with the index of the job it refused
+   and why. status writes at most cap bytes and returns the length */
+typedef struct controlHandlers {
+  int (*submit)(const JobRecord *jobs, int count, int *refused, const char **why);
+  int (*status)(char *reply, int cap);
+  void (*shutdown)();
+} ControlHandlers;
+
+bool openControl(const char *path, int resources);
+int controlFd();
+void serveControl(const ControlHandlers *h);
+void closeControl();
+
+#endif
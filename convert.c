@@ -0,0 +1,126 @@
+#include "hostd.h"
+#include "dispatchlist.h"
+
+/* hostd-convert: turns a text dispatch list into the binary format
+   and back. The direction is picked from the input unless forced */
+
+#define WRITE_BATCH 4096 // records buffered per write()
+
+/* Writes every job as a JobRecord, then fills in the header */
+static bool writeBinary(DispatchReader *in, FILE *out) {
+  DispatchHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, DISPATCH_MAGIC, DISPATCH_MAGIC_LEN);
+  h.version = DISPATCH_VERSION;
+  h.recordSize = sizeof(JobRecord);
+
+  // reserve room for the header, it is rewritten once the counts are known
+  if (fwrite(&h, sizeof(h), 1, out) != 1) return false;
+
+  JobRecord *batch = malloc(WRITE_BATCH * sizeof(JobRecord));
+  assert(batch != NULL);
+  int n = 0;
+  PCB *job;
+  while ((job = readNextJob(in)) != NULL) {
+    if (h.jobCount == 0) h.firstArrival = job->arrival_time;
+    h.lastArrival = job->arrival_time;
+    h.jobCount++;
+    jobToRecord(job, &batch[n++]);
+    freeJob(in->jobs, job);
+    if (n == WRITE_BATCH) {
+      if (fwrite(batch, sizeof(JobRecord), n, out) != (size_t)n) break;
+      n = 0;
+    }
+  }
+  bool ok = fwrite(batch, sizeof(JobRecord), n, out) == (size_t)n;
+  free(batch);
+
+  if (!ok || fseek(out, 0, SEEK_SET) != 0) return false;
+  return fwrite(&h, sizeof(h), 1, out) == 1;
+}
+
+/* Writes every job back out as a comma separated line */
+static bool writeText(DispatchReader *in, FILE *out) {
+  PCB *job;
+  while ((job = readNextJob(in)) != NULL) {
+    fprintf(out, "%d, %d, %d, %d", job->arrival_time, job->priority, job->cpu_time, job->mem_req);
+    int i;
+    for (i = 0; i < in->resources; i++) fprintf(out, ", %d", job->resources[i]);
+    if (job->deadline >= 0) fprintf(out, ", %d", job->deadline - job->arrival_time);
+    fputc('\n', out);
+    freeJob(in->jobs, job);
+  }
+  return !ferror(out);
+}
+
+static void printConvertUsage(char *name) {
+  printf("Usage: %s [options] <input> <output>\n", name);
+  printf("Converts a dispatch list between text and binary.\n");
+  printf("  -b, --to-binary  write binary even if the input is binary\n");
+  printf("  -x, --to-text    write text even if the input is text\n");
+  printf("  -r, --resources <n>  device columns in a text line (default %d)\n", DISPATCH_DEFAULT_RESOURCES);
+}
+
+int main(int argc, char **argv) {
+  int toBinary = -1; // -1 = opposite of whatever the input is
+  int resources = DISPATCH_DEFAULT_RESOURCES;
+
+  static struct option longOptions[] = {
+    {"to-binary", no_argument, NULL, 'b'},
+    {"to-text", no_argument, NULL, 'x'},
+    {"resources", required_argument, NULL, 'r'},
+    {NULL, 0, NULL, 0}
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "bxr:", longOptions, NULL)) != -1) {
+    switch (opt) {
+      case 'b': toBinary = 1; break;
+      case 'x': toBinary = 0; break;
+      case 'r':
+        resources = atoi(optarg);
+        if (resources < 0 || resources > MAX_RESOURCES) {
+          printf("A job can name 0 to %d kinds of device.\n", MAX_RESOURCES);
+          return 1;
+        }
+        break;
+      default:
+        printConvertUsage(argv[0]);
+        return 1;
+    }
+  }
+  if (argc - optind != 2) {
+    printConvertUsage(argv[0]);
+    return 1;
+  }
+
+  DispatchReader in;
+  if (!openDispatchList(&in, argv[optind])) {
+    printf("Could not open file %s.\n", argv[optind]);
+    return 1;
+  }
+  in.resources = resources;
+  JobTable jobs; // one PCB at a time passes through
+  initJobTable(&jobs);
+  in.jobs = &jobs;
+  if (toBinary < 0) toBinary = !in.binary;
+
+  FILE *out = fopen(argv[optind + 1], "wb");
+  if (out == NULL) {
+    printf("Could not create file %s.\n", argv[optind + 1]);
+    closeDispatchList(&in);
+    return 1;
+  }
+
+  bool ok = toBinary ? writeBinary(&in, out) : writeText(&in, out);
+  ok = (fclose(out) == 0) && ok;
+  printf("Converted %ld jobs to %s (%ld malformed lines skipped).\n",
+      in.jobsRead, toBinary ? "binary" : "text", in.malformed);
+  closeDispatchList(&in);
+  releaseJobTable(&jobs);
+
+  if (!ok) {
+    printf("Failed writing %s.\n", argv[optind + 1]);
+    return 1;
+  }
+  return 0;
+}
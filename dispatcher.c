@@ -0,0 +1,919 @@
+#include "dispatcher.h"
+#include "log.h"
+#include "trace.h"
+#include "checkpoint.h"
+#include "jobtable.h"
+
+/* The scheduling core: queues, admission, resources, memory and the
+   cpus of one dispatcher, with no processes, signals or sleeping in
+   it. Whoever drives it moves the clock and calls dispatchPass, the
+   backend makes its decisions happen. Everything it knows is in the
+   Dispatcher passed in, so several can run side by side */
+
+static char *userName = "USER PRIORITY JOB QUEUE";
+static char *rtName =  "REALTIME PRIORITY JOB QUEUE";
+
+// labels for each scheduling level, realtime first
+#define NUM_LEVELS SCHED_LEVELS
+static char *levelLabels[NUM_LEVELS] = {"real time", "p1Q", "p2Q", "p3Q"};
+
+static void admitArrivals(Dispatcher *d);
+static PCB* nextArrival(Dispatcher *d);
+static void admitRealtime(Dispatcher *d, PCB *job, bool retry);
+static void retryDeferred(Dispatcher *d);
+static void distributeUserJobs(Dispatcher *d);
+static void admitUserJob(Dispatcher *d, PCB *job);
+static bool dispatchJobs(Dispatcher *d);
+static void preemptForRealtime(Dispatcher *d);
+static bool preemptByDeadline(Dispatcher *d);
+static bool dispatchJob(Dispatcher *d, Cpu *c);
+static void runSlice(Dispatcher *d, Cpu *c);
+static bool startJob(Dispatcher *d, PCB *job, int cpuIndex);
+static void suspendJob(Dispatcher *d, PCB *job, int cpuIndex);
+static void resumeJob(Dispatcher *d, PCB *job, int cpuIndex);
+static void terminateJob(Dispatcher *d, PCB *job);
+static void completeJob(Dispatcher *d, PCB *job, int level, bool exitSeen);
+static void endRun(Dispatcher *d, Cpu *c);
+static void queuePolicyWakeup(Dispatcher *d);
+static PCB* holeBlockedJob(Dispatcher *d, int *largest);
+static void maybeCompact(Dispatcher *d);
+static void queueCompactWakeup(Dispatcher *d);
+static int userJobsWaiting(Dispatcher *d);
+static bool queuesAreNotEmpty(Dispatcher *d);
+static void numberJob(Dispatcher *d, PCB *job);
+static bool resourcesAvailable(Dispatcher *d, PCB *job);
+static WaitResource blockingResource(Dispatcher *d, PCB *job);
+static void assignResources(Dispatcher *d, PCB *job);
+static void printJobDetails(Dispatcher *d, PCB *job);
+static bool claimMemSpace(Dispatcher *d, PCB *job, int limit);
+static void freeMemSpace(Dispatcher *d, PCB *job);
+static bool userOrReal(Dispatcher *d, PCB *job);
+static bool checkUserOrReal(Dispatcher *d, PCB *job);
+
+/* The settings hostd runs with when given no options, jobs simulated */
+void defaultDispatcher(Dispatcher *d) {
+	memset(d, 0, sizeof(*d));
+	defaultMachine(&d->machine);
+	defaultFeedbackConfig(&d->feedback);
+	d->policy = findSchedPolicy("mlfq");
+	d->admission = ADMIT_ALL;
+	d->compaction.threshold = -1;
+	d->compaction.after = -1;
+	d->fitPolicy = FIRST_FIT;
+	d->numCpus = 1;
+	d->virtualTime = true;
+	d->backend = &simulatedJobs;
+}
+
+/* Sets up the queues, cpus and memory from the settings. The machine
+   has to have been through finishMachine */
+void initDispatcher(Dispatcher *d) {
+	// every quantum, boost and aging period is a whole number of ticks
+	d->tickMillis = feedbackTickMillis(&d->feedback);
+	d->ticksPerSecond = 1000 / d->tickMillis;
+	d->clock = 0;
+	d->numJobs = d->jobsSubmitted = d->jobsCompleted = 0;
+	d->nextVirtualPid = 1;
+	d->arrivalEventTime = d->policyEventTime = d->compactEventTime = -1;
+	d->compactedAt = -1;
+	d->reportedTime = -1;
+	memcpy(d->freeUnits, d->machine.units, sizeof(d->freeUnits));
+	initJobTable(&d->jobs);
+	// listings show a column for each device of the machine
+	d->jobs.numResources = d->machine.numResources;
+	d->jobs.initials = d->machine.initials;
+
+	d->dispatchQ = initQueue(&d->jobs);
+	d->submitQ = initQueue(&d->jobs);
+	initEdfQueue(&d->realtimeQ, &d->jobs);
+	d->deferredQ = initQueue(&d->jobs);
+	d->userQ = initQueue(&d->jobs);
+	initWaitList(&d->waitList, &d->jobs);
+	d->sched = d->policy->init(&d->feedback, d->tickMillis, &d->jobs);
+	d->cpus = calloc(d->numCpus, sizeof(Cpu));
+	assert(d->cpus != NULL);
+	initMemMap(&d->memMap, d->machine.memory, userMemory(&d->machine), d->fitPolicy);
+	initArena(&d->arena);
+	d->dying = NULL;
+	d->numDying = d->dyingCap = 0;
+	initEventQueue(&d->events);
+	d->compacting = d->compaction.threshold >= 0 || d->compaction.after >= 0;
+	initMemHolders(&d->memHolders);
+	initCompactStats(&d->compactStats);
+	initJobMetrics(&d->jobMetrics, d->tickMillis);
+}
+
+/* Frees the queues and every job still in them. Jobs still on a cpu
+   are the backend's to end first */
+void freeDispatcher(Dispatcher *d) {
+	deleteQueue(d->dispatchQ);
+	deleteQueue(d->submitQ);
+	deleteEdfQueue(&d->realtimeQ);
+	deleteQueue(d->deferredQ);
+	deleteQueue(d->userQ);
+	deleteWaitList(&d->waitList);
+	d->policy->destroy(d->sched);
+	free(d->cpus);
+	destroyMemMap(&d->memMap);
+	int i;
+	for (i = 0; i < d->numDying; i++) freeJob(&d->jobs, d->dying[i]);
+	free(d->dying);
+	closeArena(&d->arena);
+	freeMemHolders(&d->memHolders);
+	destroyEventQueue(&d->events);
+	releaseJobTable(&d->jobs); // along with any job still on a cpu
+}
+
+/* Gives a job its id and turns its times into ticks. Job lines are in
+   seconds, everything else runs in ticks */
+static void numberJob(Dispatcher *d, PCB *job) {
+	d->numJobs ++;
+	job->id = d->numJobs;
+	job->arrival_time *= d->ticksPerSecond;
+	job->cpu_time *= d->ticksPerSecond;
+	job->time_left *= d->ticksPerSecond;
+	job->queued_at *= d->ticksPerSecond;
+	if (job->deadline >= 0) job->deadline *= d->ticksPerSecond;
+	syncJob(&d->jobs, job);
+}
+
+/* Queues a job read from a dispatch list, times in seconds from the
+   start. Jobs are added in arrival order and need only be added once
+   the arrival of the one before them has come */
+void addJob(Dispatcher *d, PCB *job) {
+	numberJob(d, job);
+	enqueueJob(d->dispatchQ, job);
+}
+
+/* Queues a job whose times count in seconds from now, in any order
+   with the jobs already submitted */
+void submitJob(Dispatcher *d, PCB *job) {
+	numberJob(d, job);
+	job->arrival_time += d->clock;
+	job->queued_at += d->clock;
+	if (job->deadline >= 0) job->deadline += d->clock;
+	insertByArrival(d->submitQ, job);
+	d->jobsSubmitted++;
+}
+
+/* One scheduling pass at the current clock: arrivals are admitted,
+   user jobs given their resources and every idle cpu filled. In
+   virtual time the events the next pass has to happen by are queued.
+   Returns false only if a new job could not be started */
+bool dispatchPass(Dispatcher *d) {
+	// a pass for a submission between ticks carries on under the same heading
+	if (d->clock != d->reportedTime) {
+		d->reportedTime = d->clock;
+		LOG(LOG_INFO, "\n-----------------------------------------\n"
+			"DISPATCHER TIME: %t SECONDS\n"
+			"-----------------------------------------\n", d->clock);
+
+		LOG(LOG_DEBUG, "DISPATCHER RESOURCE REPORT:\n");
+		LOG(LOG_DEBUG, "Available Memory: %d\n", d->machine.memory - d->memMap.used);
+		int r;
+		for (r = 0; r < d->machine.numResources; r++) {
+			LOG(LOG_DEBUG, "%s: %d\n", LOG_STR(d->machine.names[r]), d->freeUnits[r]);
+		}
+	}
+
+	// policy housekeeping (mlfq boosts and aging) sees the queues as
+	// the last tick left them
+	if (d->policy->tick != NULL) d->policy->tick(d->sched, d->clock, d->cpus, d->numCpus);
+
+	// move all jobs with this time from dispatch to the submission queues
+	// this happens on EVERY tick, the driver has added the list's arrivals
+	retryDeferred(d);
+	admitArrivals(d);
+
+	// distribute user jobs into their priority queues bases on resources
+	// happens on EVERY TICK
+	distributeUserJobs(d);
+
+	/* Now check all the queues for jobs to run on the idle cpus. */
+	if (!dispatchJobs(d)) return false;
+
+	// let the running jobs have their cpus until the next tick or event
+	if (d->virtualTime) queuePolicyWakeup(d);
+	if (d->virtualTime && d->compaction.after >= 0) queueCompactWakeup(d);
+	return true;
+}
+
+/* Charges every running job for the time up to the clock, ending the
+   slices that are over */
+void chargeCpus(Dispatcher *d) {
+	int i;
+	for (i = 0; i < d->numCpus; i++) {
+		if (d->cpus[i].job != NULL) runSlice(d, &d->cpus[i]);
+	}
+}
+
+/* Moves the clock to now, charging the running jobs for the time in
+   between, and makes a pass. A driver that has things of its own to
+   do between the two calls them itself */
+bool stepDispatcher(Dispatcher *d, int now) {
+	if (now > d->clock) {
+		d->clock = now;
+		chargeCpus(d);
+	}
+	return dispatchPass(d);
+}
+
+/* In virtual time, the time of the next pending event, taking it and
+   any others at that time off the queue. -1 once nothing is pending */
+int nextEventTime(Dispatcher *d) {
+	if (!eventsPending(&d->events)) return -1;
+	int next = popEvent(&d->events).time;
+	// drop any other events that fire at the same time
+	while (eventsPending(&d->events) && peekEvent(&d->events)->time <= next) {
+		popEvent(&d->events);
+	}
+	return next;
+}
+
+/* True once no job is running or queued anywhere */
+bool dispatcherIdle(Dispatcher *d) {
+	return !cpusBusy(d) && !queuesAreNotEmpty(d);
+}
+
+/* Moves every job whose arrival time has come from the dispatch list
+   or the control socket into the realtime or user submission queue */
+static void admitArrivals(Dispatcher *d) {
+	PCB *job; // pointer used to move jobs between queues
+
+	while ((job = nextArrival(d)) != NULL) {
+		//assign the jobs to the correct submission queue
+		int jobPriority = job->priority;
+		if (jobPriority == 0) { // realtimeq priority = 0
+			LOG(LOG_INFO, "A new realtime job has arrived.\n");
+			job->queued_at = d->clock;
+			admitRealtime(d, job, false);
+		} else if (jobPriority==1 || jobPriority==2 || jobPriority==3) {
+			LOG(LOG_INFO, "A new user job has arrived.\n");
+			job->queued_at = d->clock;
+			enqueueJob(d->userQ, job);
+			if (logEnabled(LOG_DEBUG)) printQueue(userName, d->userQ);
+		} else {
+			freeJob(&d->jobs, job); // not a valid priority
+		}
+	}
+
+	// in virtual time the next arrival is an event to wake up for
+	if (d->virtualTime && !isEmpty(d->dispatchQ) &&
+	    d->dispatchQ->process->arrival_time != d->arrivalEventTime) {
+		d->arrivalEventTime = d->dispatchQ->process->arrival_time;
+		pushEvent(&d->events, d->arrivalEventTime, EV_ARRIVAL, -1);
+	}
+}
+
+/* Takes the next job whose arrival time has come, whichever of the
+   dispatch list and the submitted jobs has it first. NULL if none has */
+static PCB* nextArrival(Dispatcher *d) {
+	bool listDue = !isEmpty(d->dispatchQ) && d->dispatchQ->process->arrival_time <= d->clock;
+	bool submittedDue = !isEmpty(d->submitQ) && d->submitQ->process->arrival_time <= d->clock;
+	if (listDue && (!submittedDue ||
+	    d->dispatchQ->process->arrival_time <= d->submitQ->process->arrival_time)) {
+		return dequeueFront(&d->dispatchQ);
+	}
+	return submittedDue ? dequeueFront(&d->submitQ) : NULL;
+}
+
+/* Queues a realtime job by its deadline. With admission control on, a
+   job whose deadline could not be met on top of the realtime work
+   already admitted is either dropped or held in deferredQ to be tried
+   again next tick. A held job is dropped once it can no longer finish
+   in time even with a cpu to itself */
+static void admitRealtime(Dispatcher *d, PCB *job, bool retry) {
+	if (d->admission == ADMIT_ALL || job->deadline < 0 ||
+	    edfAdmits(&d->realtimeQ, job, d->cpus, d->numCpus, d->clock)) {
+		if (retry) LOG(LOG_INFO, "Deferred realtime job %d admitted.\n", job->id);
+		edfPush(&d->realtimeQ, job);
+		if (logEnabled(LOG_DEBUG)) printEdfQueue(rtName, &d->realtimeQ);
+		return;
+	}
+
+	if (d->admission == ADMIT_DEFER && d->clock + job->time_left <= job->deadline) {
+		if (!retry) {
+			LOG(LOG_INFO, "Realtime job %d deferred until it can meet its deadline.\n", job->id);
+			recordDeferred(&d->jobMetrics, job);
+		}
+		enqueueJob(d->deferredQ, job);
+		return;
+	}
+
+	LOG(LOG_INFO, "Realtime job %d cannot meet its deadline and was rejected.\n", job->id);
+	recordRejected(&d->jobMetrics, job);
+	freeJob(&d->jobs, job);
+}
+
+/* Gives every deferred realtime job another go at admission, oldest first */
+static void retryDeferred(Dispatcher *d) {
+	int n = getLength(d->deferredQ);
+	while (n-- > 0) {
+		admitRealtime(d, dequeueFront(&d->deferredQ), true);
+	}
+}
+
+/* Gives waiting user jobs their resources and moves them into the
+   feedback queue matching their priority. New arrivals are looked at
+   once, after that a job is only looked at again when the resource it
+   was short of is released. Jobs are still looked at in arrival order */
+static void distributeUserJobs(Dispatcher *d) {
+	PCB *job;
+
+	if (d->compacting) maybeCompact(d);
+	// everything waiting arrived before the jobs still in userQ
+	beginWake(&d->waitList);
+	while (1) {
+		job = nextWaiter(&d->waitList, d->freeUnits,
+			largestFreeBlock(&d->memMap, userMemory(&d->machine)));
+		if (job == NULL) break;
+		admitUserJob(d, job);
+	}
+	endWake(&d->waitList);
+	while (!isEmpty(d->userQ)) {
+		admitUserJob(d, dequeueFront(&d->userQ));
+	}
+
+	if (waitingJobs(&d->waitList) > 0) {
+		LOG(LOG_INFO, "%d user jobs are waiting on resources...\n", waitingJobs(&d->waitList));
+	}
+	if (logEnabled(LOG_DEBUG)) d->policy->print(d->sched);
+}
+
+/* Moves a user job into its feedback queue if its resources are free,
+   otherwise files it under the first resource it is short of */
+static void admitUserJob(Dispatcher *d, PCB *job) {
+	//checking to make sure all the resources are avalable for the job
+	if (resourcesAvailable(d, job)) {
+		assignResources(d, job);
+		LOG(LOG_INFO, "Successfuly allocated resources to a new user job.\n");
+		// jobs too big for any hole before this tick's compaction got in thanks to it
+		if (d->compactedAt == d->clock && job->mem_req > d->compactedLargest) {
+			recordValue(&d->compactStats.unblocked, d->clock - job->queued_at);
+		}
+		job->user_wait += d->clock - job->queued_at;
+		traceEvent(TRACE_RESOURCE_WAIT, job->queued_at, d->clock, -1, 0, job);
+		LOG(LOG_DEBUG, "User Priority: %d\n", job->priority);
+		//hands the job to the scheduling policy
+		d->policy->arrive(d->sched, job, d->clock);
+		return;
+	}
+	// safety check on if job requires too many resources
+	if (job->mem_req > userMemory(&d->machine) || !unitsFit(job->resources, d->machine.units)) {
+		// simply remove job
+		freeJob(&d->jobs, job);
+		return;
+	}
+	addWaiter(&d->waitList, job, blockingResource(d, job));
+}
+
+/* Fills every idle cpu, highest priority queue first, so realtime
+   jobs are always placed before any user job.
+   Returns false only if a new process could not be started */
+static bool dispatchJobs(Dispatcher *d) {
+	int i;
+	preemptForRealtime(d);
+	for (i = 0; i < d->numCpus; i++) {
+		if (d->cpus[i].job == NULL && !dispatchJob(d, &d->cpus[i])) return false;
+	}
+	return preemptByDeadline(d);
+}
+
+/* If more realtime jobs are waiting than there are idle cpus, take cpus
+   away from user jobs (lowest priority first) so no realtime job waits
+   behind one. The user job goes back to the end of its own queue */
+static void preemptForRealtime(Dispatcher *d) {
+	Cpu *cpus = d->cpus;
+	int waiting = edfLength(&d->realtimeQ);
+	int idle = 0, i;
+	for (i = 0; i < d->numCpus; i++) {
+		if (cpus[i].job == NULL) idle++;
+	}
+
+	while (waiting > idle) {
+		Cpu *victim = NULL;
+		for (i = 0; i < d->numCpus; i++) {
+			if (cpus[i].job != NULL && cpus[i].level > 0 &&
+			    (victim == NULL || cpus[i].level > victim->level)) {
+				victim = &cpus[i];
+			}
+		}
+		if (victim == NULL) return; // every cpu is already running realtime work
+
+		PCB *job = victim->job;
+		setTimeLeft(&d->jobs, job, job->time_left - (d->clock - victim->lastTick));
+		job->level_used += d->clock - victim->lastTick;
+		victim->busyTime += d->clock - victim->lastTick;
+		endRun(d, victim);
+		suspendJob(d, job, victim - cpus);
+		d->policy->preempted(d->sched, job, victim->level, d->clock);
+		victim->job = NULL;
+		idle++;
+	}
+}
+
+/* Once every cpu runs realtime work, a waiting realtime job whose
+   deadline is earlier than that of a running one takes its cpu (global
+   EDF). The job with the latest deadline goes back in line first.
+   Jobs without deadlines never preempt each other.
+   Returns false only if a new process could not be started */
+static bool preemptByDeadline(Dispatcher *d) {
+	Cpu *cpus = d->cpus;
+	PCB *next;
+	while ((next = edfPeek(&d->realtimeQ)) != NULL) {
+		Cpu *victim = NULL;
+		int i;
+		for (i = 0; i < d->numCpus; i++) {
+			if (cpus[i].job != NULL && cpus[i].level == 0 && deadlineBefore(next, cpus[i].job) &&
+			    (victim == NULL || deadlineBefore(victim->job, cpus[i].job))) {
+				victim = &cpus[i];
+			}
+		}
+		if (victim == NULL) return true;
+
+		PCB *job = victim->job;
+		LOG(LOG_INFO, "Realtime job %d preempted by an earlier deadline.\n", job->id);
+		setTimeLeft(&d->jobs, job, job->time_left - (d->clock - victim->lastTick));
+		victim->busyTime += d->clock - victim->lastTick;
+		endRun(d, victim);
+		suspendJob(d, job, victim - cpus);
+		job->queued_at = d->clock;
+		edfPush(&d->realtimeQ, job);
+		victim->job = NULL;
+		if (!dispatchJob(d, victim)) return false;
+	}
+	return true;
+}
+
+/* Puts the next job on the cpu: the realtime job with the earliest
+   deadline if there is one, otherwise whatever the scheduling policy
+   picks. Realtime jobs run until they finish or an earlier deadline
+   takes the cpu, user jobs run for as long as the policy gives them.
+   Returns false only if a new process could not be started */
+static bool dispatchJob(Dispatcher *d, Cpu *c) {
+	int level = 0, clock = d->clock, cpu = c - d->cpus;
+	PCB *job;
+	if (edfLength(&d->realtimeQ) > 0) {
+		if (logEnabled(LOG_DEBUG)) printEdfQueue(rtName, &d->realtimeQ);
+		job = edfPop(&d->realtimeQ);
+	} else {
+		if (logEnabled(LOG_DEBUG) && userJobsWaiting(d) > 0) d->policy->print(d->sched);
+		job = d->policy->pickNext(d->sched, &level);
+		if (job == NULL) return true; // nothing to run
+	}
+	chargeWait(job, level, clock);
+	if (job->first_run < 0) job->first_run = clock;
+
+	bool resumed = job->pid >= 0;
+	if (!resumed) {
+		// job hasnt started yet so launch its process
+		if (!startJob(d, job, cpu)) return false;
+	} else {
+		// it was previously paused, so resume it
+		LOG(LOG_DEBUG, "Attempting to resume process...\n");
+		resumeJob(d, job, cpu);
+	}
+
+	// RT processes are only paused for an earlier deadline, never for a quantum
+	int slice = (level == 0) ? job->time_left : d->policy->slice(d->sched, job, level);
+	if (slice > job->time_left) slice = job->time_left;
+	if (slice < 1) slice = 1;
+
+	traceEvent(TRACE_DISPATCH, clock, clock, cpu, resumed, job);
+	c->job = job;
+	c->level = level;
+	c->lastTick = clock;
+	c->runStart = clock;
+	c->sliceEnd = clock + slice;
+	if (d->virtualTime) {
+		pushEvent(&d->events, c->sliceEnd,
+			(slice >= job->time_left) ? EV_COMPLETE : EV_QUANTUM, cpu);
+	}
+	return true;
+}
+
+/* Charges the running job for the time since its last tick and, once
+   its slice is over, either finishes it or, if it has used the whole
+   quantum of its level, moves it down a level */
+static void runSlice(Dispatcher *d, Cpu *c) {
+	PCB *job = c->job;
+	int clock = d->clock, cpu = c - d->cpus;
+	//decrement time
+	setTimeLeft(&d->jobs, job, job->time_left - (clock - c->lastTick));
+	job->level_used += clock - c->lastTick;
+	c->busyTime += clock - c->lastTick;
+	c->lastTick = clock;
+	if (d->numCpus > 1) {
+		LOG(LOG_INFO, "CPU %d: Time left in %s process: %t\n", cpu,
+			LOG_STR(levelLabels[c->level]), job->time_left);
+	} else {
+		LOG(LOG_INFO, "Time left in %s process: %t\n", LOG_STR(levelLabels[c->level]), job->time_left);
+	}
+
+	if (clock < c->sliceEnd) return; // still running
+
+	endRun(d, c);
+	if (job->time_left <= 0) {
+		terminateJob(d, job); // kill the process
+		completeJob(d, job, c->level, false);
+	} else {
+		// pause it and let the policy decide where it waits next
+		suspendJob(d, job, cpu);
+		int next = d->policy->expire(d->sched, job, c->level, clock);
+		if (next > c->level) traceEvent(TRACE_DEMOTE, clock, clock, cpu, next, job);
+	}
+	c->job = NULL;
+}
+
+/* Starts a brand new job */
+static bool startJob(Dispatcher *d, PCB *job, int cpuIndex) {
+	if (!d->backend->start(d, job, cpuIndex)) return false;
+	printJobDetails(d, job);
+	return true;
+}
+
+/* Asks the job to stop. A backend may confirm the stop later, so the
+   dispatcher never blocks here */
+static void suspendJob(Dispatcher *d, PCB *job, int cpuIndex) {
+	traceEvent(TRACE_SUSPEND, d->clock, d->clock, cpuIndex, 0, job);
+	d->backend->suspend(d, job, cpuIndex);
+}
+
+/* Lets a stopped job run again, maybe on a different cpu */
+static void resumeJob(Dispatcher *d, PCB *job, int cpuIndex) {
+	traceEvent(TRACE_RESUME, d->clock, d->clock, cpuIndex, 0, job);
+	d->backend->resume(d, job, cpuIndex);
+}
+
+/* Ends the job. The backend sees to anything left of it */
+static void terminateJob(Dispatcher *d, PCB *job) {
+	d->backend->terminate(d, job);
+	job->state = JOB_EXITED;
+}
+
+/* Gives back everything a finished job holds and frees it. A killed
+   process may go on touching its pages until its exit is seen, so a
+   job with real pages behind its memory keeps it until jobReaped */
+static void completeJob(Dispatcher *d, PCB *job, int level, bool exitSeen) {
+	bool held = !exitSeen && d->arena.fd >= 0 && job->mem_start >= 0;
+	if (!held) freeMemSpace(d, job); // free its memory
+	// user jobs give back their devices, realtime jobs never get any
+	if (level > 0) {
+		int r;
+		for (r = 0; r < d->machine.numResources; r++) {
+			d->freeUnits[r] += job->resources[r];
+			if (job->resources[r] > 0) resourceReleased(&d->waitList, r);
+		}
+	}
+	job->completion = d->clock;
+	recordJobMetrics(&d->jobMetrics, job);
+	traceEvent(TRACE_COMPLETE, d->clock, d->clock, -1, 0, job);
+	if (held) {
+		if (d->numDying == d->dyingCap) {
+			d->dyingCap = d->dyingCap ? d->dyingCap * 2 : 16;
+			d->dying = realloc(d->dying, d->dyingCap * sizeof(PCB *));
+			assert(d->dying != NULL);
+		}
+		d->dying[d->numDying++] = job;
+	} else {
+		freeJob(&d->jobs, job);
+	}
+	d->jobsCompleted++;
+}
+
+/* The process of a job that was killed has exited, so its memory can
+   go to the next job. Returns false if no killed job had that pid */
+bool jobReaped(Dispatcher *d, pid_t pid) {
+	int i;
+	for (i = 0; i < d->numDying; i++) {
+		if (d->dying[i]->pid == pid) break;
+	}
+	if (i == d->numDying) return false;
+	PCB *job = d->dying[i];
+	d->dying[i] = d->dying[--d->numDying];
+	freeMemSpace(d, job);
+	freeJob(&d->jobs, job);
+	return true;
+}
+
+/* A running job finished on its own before its cpu time ran out.
+   Returns false if no cpu is running the job with that pid */
+bool jobExited(Dispatcher *d, pid_t pid) {
+	Cpu *cpus = d->cpus;
+	int i;
+	for (i = 0; i < d->numCpus; i++) {
+		PCB *job = cpus[i].job;
+		if (job != NULL && job->pid == pid && job->state == JOB_RUNNING) {
+			LOG(LOG_INFO, "Process %d exited on its own with %t seconds left.\n",
+				(int)pid, job->time_left - (d->clock - cpus[i].lastTick));
+			job->state = JOB_EXITED;
+			cpus[i].busyTime += d->clock - cpus[i].lastTick;
+			endRun(d, &cpus[i]);
+			cpus[i].job = NULL;
+			completeJob(d, job, cpus[i].level, true);
+			return true;
+		}
+	}
+	return false;
+}
+
+/* A job that was told to stop exited instead. It may still be on a cpu
+   or already back in a queue */
+void jobGone(Dispatcher *d, PCB *job) {
+	Cpu *cpus = d->cpus;
+	job->state = JOB_EXITED;
+	int c;
+	for (c = 0; c < d->numCpus; c++) {
+		if (cpus[c].job == job) {
+			endRun(d, &cpus[c]);
+			cpus[c].job = NULL;
+			completeJob(d, job, cpus[c].level, true);
+			return;
+		}
+	}
+	int level = 0;
+	if (edfRemove(&d->realtimeQ, job) || d->policy->remove(d->sched, job, &level)) {
+		chargeWait(job, level, d->clock);
+		completeJob(d, job, level, true);
+	}
+}
+
+/* True while any cpu is running a job */
+bool cpusBusy(Dispatcher *d) {
+	int i;
+	for (i = 0; i < d->numCpus; i++) {
+		if (d->cpus[i].job != NULL) return true;
+	}
+	return false;
+}
+
+/* Ends the stats tick and records how long every queue is */
+void sampleStats(Dispatcher *d) {
+	int lengths[STATS_QUEUES] = {
+		getLength(d->dispatchQ) + getLength(d->submitQ),
+		getLength(d->userQ) + waitingJobs(&d->waitList),
+		edfLength(&d->realtimeQ) + getLength(d->deferredQ),
+		d->policy->waiting(d->sched, 1), d->policy->waiting(d->sched, 2),
+		d->policy->waiting(d->sched, 3)
+	};
+	endTick(&d->stats, lengths);
+}
+
+/* Records the stretch the cpu's job just spent running */
+static void endRun(Dispatcher *d, Cpu *c) {
+	traceEvent(TRACE_RUN, c->runStart, d->clock, c - d->cpus, 0, c->job);
+}
+
+/* In virtual time the policy may need waking up at a time no job
+   event falls on, eg. for an mlfq boost */
+static void queuePolicyWakeup(Dispatcher *d) {
+	if (d->policy->nextWakeup == NULL) return;
+	int due = d->policy->nextWakeup(d->sched, d->clock, d->cpus, d->numCpus);
+	if (due > d->clock && due != d->policyEventTime) {
+		d->policyEventTime = due;
+		pushEvent(&d->events, due, EV_POLICY, -1);
+	}
+}
+
+/* The earliest arrived job waiting on memory that would fit in the
+   free user memory if it were one block, but fits in no hole. Only user
+   jobs hold memory, so free user memory is what the map says is unused */
+static PCB* holeBlockedJob(Dispatcher *d, int *largest) {
+	int limit = userMemory(&d->machine);
+	int freeMem = limit - d->memMap.used;
+	*largest = largestFreeBlock(&d->memMap, limit);
+	if (*largest >= freeMem) return NULL; // already one block, nothing to gain
+	return oldestMemoryWaiter(&d->waitList, *largest + 1, freeMem);
+}
+
+/* Compacts user memory when holes are all that keep a waiting job out
+   and either fragmentation is past the threshold or that job has waited
+   too long. The jobs waiting on memory are looked at again right after */
+static void maybeCompact(Dispatcher *d) {
+	int largest, clock = d->clock;
+	PCB *job = holeBlockedJob(d, &largest);
+	if (job == NULL) return;
+	int freeMem = userMemory(&d->machine) - d->memMap.used;
+	bool waitedTooLong = d->compaction.after >= 0 && clock - job->queued_at >= d->compaction.after;
+	bool fragmented = d->compaction.threshold >= 0 &&
+		1.0 - (double)largest / freeMem >= d->compaction.threshold;
+	if (!waitedTooLong && !fragmented) return;
+
+	int relocations = d->compactStats.relocations;
+	int moved = compactMemory(&d->memMap, &d->memHolders, &d->compactStats, !fragmented, clock);
+	LOG(LOG_INFO, "Compacted memory (%s): moved %d mb in %d jobs, largest free block %d -> %d mb.\n",
+		LOG_STR(fragmented ? "fragmented" : "job waited too long"), moved,
+		(int)(d->compactStats.relocations - relocations), largest, freeMem);
+	d->compactedAt = clock;
+	d->compactedLargest = largest;
+	resourceReleased(&d->waitList, WAIT_MEMORY);
+}
+
+/* In virtual time a job kept out by holes needs a wakeup for when it
+   will have waited long enough, no other event may fall on that time */
+static void queueCompactWakeup(Dispatcher *d) {
+	int largest;
+	PCB *job = holeBlockedJob(d, &largest);
+	if (job == NULL) return;
+	int due = job->queued_at + d->compaction.after;
+	if (due <= d->clock) due = d->clock + 1; // it was filed after this tick's check
+	if (due != d->compactEventTime) {
+		d->compactEventTime = due;
+		pushEvent(&d->events, due, EV_COMPACT, -1);
+	}
+}
+
+/* Jobs waiting in the scheduling policy at any level */
+static int userJobsWaiting(Dispatcher *d) {
+	int level, n = 0;
+	for (level = 1; level < NUM_LEVELS; level++) n += d->policy->waiting(d->sched, level);
+	return n;
+}
+
+/* True while any job is still queued anywhere */
+static bool queuesAreNotEmpty(Dispatcher *d) {
+	return waitingJobs(&d->waitList) > 0 || userJobsWaiting(d) > 0 || edfLength(&d->realtimeQ) > 0 ||
+		!(isEmpty(d->dispatchQ) && isEmpty(d->submitQ) && isEmpty(d->userQ) && isEmpty(d->deferredQ));
+}
+
+/* True if need has no more units of any kind of device than have. The
+   loop is a fixed length with no early exit so it compiles to a few
+   vector compares */
+bool unitsFit(const int *need, const int *have) {
+	int r, over = 0;
+	for (r = 0; r < MAX_RESOURCES; r++) over |= need[r] > have[r];
+	return !over;
+}
+
+/* checks to see if there are enough resources to run a process */
+static bool resourcesAvailable(Dispatcher *d, PCB *job) {
+	return checkUserOrReal(d, job) && unitsFit(job->resources, d->freeUnits);
+}
+
+/* The first resource, in the order resourcesAvailable checks them,
+   that the job needs more of than is free */
+static WaitResource blockingResource(Dispatcher *d, PCB *job) {
+	if (!checkUserOrReal(d, job)) return WAIT_MEMORY;
+	int r;
+	for (r = 0; r < MAX_RESOURCES - 1 && job->resources[r] <= d->freeUnits[r]; r++);
+	return r;
+}
+
+/* assign resources and memory to a process */
+static void assignResources(Dispatcher *d, PCB *job) {
+    // assign by subtracting from the global amounts
+    // perform memory allocation here
+    userOrReal(d, job);
+	int r;
+	for (r = 0; r < MAX_RESOURCES; r++) d->freeUnits[r] -= job->resources[r];
+
+	LOG(LOG_DEBUG, "Memory block used: %d - %d\n", job->mem_start,(job->mem_start+job->mem_req));
+	for (r = 0; r < d->machine.numResources; r++) {
+		LOG(LOG_DEBUG, "Available %s: %d\n", LOG_STR(d->machine.names[r]), d->freeUnits[r]);
+	}
+	LOG(LOG_DEBUG, "\n");
+}
+
+/* Prints out jobs details */
+static void printJobDetails(Dispatcher *d, PCB *job) {
+	LOG(LOG_INFO, "\nA new process was started with parameters:\n"
+		"PID: %d\n"
+		"Priority: %d\n"
+		"CPU time remaining: %t\n", (int)job->pid, job->priority, job->time_left);
+	LOG(LOG_INFO, "Memory location: 0x%d\n"
+		"Block size: %dMb\n", job->mem_start, job->mem_req);
+	LOG(LOG_INFO, "Resources requested (%s): (", LOG_STR(d->machine.nameList));
+	int r;
+	for (r = 0; r < d->machine.numResources; r++) {
+		LOG(LOG_INFO, r == 0 ? "%d" : ",%d", job->resources[r]);
+	}
+	LOG(LOG_INFO, ")\n\n");
+}
+
+/* True if a job could be placed right now, realtime jobs anywhere and
+   user jobs below the reserved area. The allocator caches its largest
+   free block so this is O(1) between allocations */
+static bool checkMemSpace(Dispatcher *d, PCB *job, int limit){
+  int mem = job->mem_req;
+  if (mem <= 0) return true;
+  double t = d->collectStats ? statsNow() : 0;
+  bool fits = largestFreeBlock(&d->memMap, limit) >= mem;
+  if (d->collectStats) addAllocTime(&d->stats, t);
+  return fits;
+}
+
+/* Searches [0, limit) with the configured fit policy and marks the
+   block as used. mem_start stays -1 for jobs that need no memory */
+static bool claimMemSpace(Dispatcher *d, PCB *job, int limit){
+  int mem = job->mem_req;
+  if (mem <= 0) return true;
+
+  double t = d->collectStats ? statsNow() : 0;
+  int start = findMemBlock(&d->memMap, limit, mem);
+  if (start >= 0) claimMemBlock(&d->memMap, start, mem);
+  if (d->collectStats) addAllocTime(&d->stats, t);
+  if (start < 0) return false;
+  job->mem_start = start;
+  if (d->compacting) addMemHolder(&d->memHolders, job);
+  traceEvent(TRACE_MEM_ALLOC, d->clock, d->clock, -1, d->memMap.used, job);
+  return true;
+}
+
+static void freeMemSpace(Dispatcher *d, PCB *job){
+  //find the space that was allocated to that process and free it.
+  if (job->mem_start < 0) return; // never got any memory
+  double t = d->collectStats ? statsNow() : 0;
+  releaseMemBlock(&d->memMap, job->mem_start, job->mem_req);
+  if (d->compacting) removeMemHolder(&d->memHolders, job);
+  if (d->collectStats) addAllocTime(&d->stats, t);
+  releaseArena(&d->arena, job->mem_start, job->mem_req);
+  traceEvent(TRACE_MEM_FREE, d->clock, d->clock, -1, d->memMap.used, job);
+  resourceReleased(&d->waitList, WAIT_MEMORY);
+  job->mem_start = -1;
+}
+
+/* The memory a job may be placed in: all of it for realtime jobs,
+   below the reserved area for user jobs */
+static int memLimit(Dispatcher *d, PCB *job) {
+  return job->priority == 0 ? d->machine.memory : userMemory(&d->machine);
+}
+
+static bool userOrReal(Dispatcher *d, PCB *job){
+  return claimMemSpace(d, job, memLimit(d, job));
+}
+
+static bool checkUserOrReal(Dispatcher *d, PCB *job){
+  return checkMemSpace(d, job, memLimit(d, job));
+}
+
+/* Writes the cpus, every queue, the memory map, pending events and the
+   metrics so far. The driver's own state goes first */
+void saveDispatcher(Dispatcher *d, FILE *f) {
+	int i;
+	for (i = 0; i < d->numCpus; i++) {
+		SAVE(f, d->cpus[i]);
+		if (d->cpus[i].job != NULL) saveJob(f, d->cpus[i].job);
+	}
+	saveQueue(f, d->dispatchQ);
+	saveQueue(f, d->submitQ);
+	saveQueue(f, d->userQ);
+	saveQueue(f, d->deferredQ);
+	saveEdfQueue(f, &d->realtimeQ);
+	saveWaitList(f, &d->waitList);
+	d->policy->save(d->sched, f);
+	// killed jobs are not saved, their memory is free once they are gone
+	for (i = 0; i < d->numDying; i++) releaseMemBlock(&d->memMap, d->dying[i]->mem_start, d->dying[i]->mem_req);
+	saveMemMap(f, &d->memMap);
+	for (i = 0; i < d->numDying; i++) claimMemBlock(&d->memMap, d->dying[i]->mem_start, d->dying[i]->mem_req);
+	saveEventQueue(f, &d->events);
+	saveJobMetrics(f, &d->jobMetrics);
+	saveCompactStats(f, &d->compactStats);
+}
+
+/* Reads back what saveDispatcher wrote into a dispatcher just set up
+   with the same settings. The clock and counters are the driver's to
+   put back */
+bool loadDispatcher(Dispatcher *d, FILE *f) {
+	bool ok = true;
+	int i;
+	for (i = 0; i < d->numCpus && ok; i++) {
+		ok = LOAD(f, d->cpus[i]);
+		if (ok && d->cpus[i].job != NULL) ok = (d->cpus[i].job = loadJob(f, &d->jobs)) != NULL;
+	}
+	ok = ok && loadQueue(f, d->dispatchQ) && loadQueue(f, d->submitQ) && loadQueue(f, d->userQ) &&
+		loadQueue(f, d->deferredQ) && loadEdfQueue(f, &d->realtimeQ) && loadWaitList(f, &d->waitList) &&
+		d->policy->load(d->sched, f) && loadMemMap(f, &d->memMap) && loadEventQueue(f, &d->events) &&
+		loadJobMetrics(f, &d->jobMetrics) && loadCompactStats(f, &d->compactStats);
+	if (!ok) return false;
+
+	if (!d->compacting) return true;
+	PCB **jobs;
+	int count = tableJobs(&d->jobs, &jobs);
+	for (i = 0; i < count; i++) {
+		if (jobs[i]->mem_start >= 0) addMemHolder(&d->memHolders, jobs[i]);
+	}
+	free(jobs);
+	return true;
+}
+
+/* ---- simulatedJobs: no processes, the pids are only labels ---- */
+
+static bool simulatedStart(Dispatcher *d, PCB *job, int cpu) {
+	job->pid = d->nextVirtualPid++;
+	return true;
+}
+
+static void simulatedSuspend(Dispatcher *d, PCB *job, int cpu) {
+	job->state = JOB_STOPPED;
+}
+
+static void simulatedResume(Dispatcher *d, PCB *job, int cpu) {
+	job->state = JOB_RUNNING;
+}
+
+static void simulatedTerminate(Dispatcher *d, PCB *job) {
+}
+
+const JobBackend simulatedJobs = {
+	"simulated", simulatedStart, simulatedSuspend, simulatedResume, simulatedTerminate
+};
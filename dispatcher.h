@@ -0,0 +1,116 @@
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+#include "hostd.h"
+#include "queue.h"
+#include "memory.h"
+#include "event.h"
+#include "stats.h"
+#include "metrics.h"
+#include "waitlist.h"
+#include "feedback.h"
+#include "sched.h"
+#include "edf.h"
+#include "machine.h"
+#include "compact.h"
+#include "arena.h"
+
+typedef struct dispatcher Dispatcher;
+
+/* Carries out what the dispatcher decides for its jobs. The core only
+   keeps the books, a backend is what runs the jobs: processes for
+   hostd, nothing at all for simulatedJobs. start gives a new job its
+   pid and returns false if it could not be started. The rest cannot
+   fail, a backend that learns of a job dying by itself tells the core
+   with jobExited or jobGone, and of a killed one having exited with
+   jobReaped */
+typedef struct jobBackend {
+  const char *name;
+  bool (*start)(Dispatcher *d, PCB *job, int cpu);
+  void (*suspend)(Dispatcher *d, PCB *job, int cpu);
+  void (*resume)(Dispatcher *d, PCB *job, int cpu);
+  void (*terminate)(Dispatcher *d, PCB *job); // its cpu time is used up
+} JobBackend;
+
+extern const JobBackend simulatedJobs;
+
+/* Everything one dispatcher knows. The settings at the top are filled
+   in (defaultDispatcher gives the usual ones) before initDispatcher
+   sets up the rest from them, and stay fixed after that. Nothing here
+   is shared between dispatchers, and its queues point into its own job
+   table, so a dispatcher must not move once it is set up. The logger
+   and the schedule trace are one per process, so several dispatchers
+   may run in one process but only from one thread */
+struct dispatcher {
+  // settings
+  Machine machine;          // memory size and devices of the simulated machine
+  FeedbackConfig feedback;  // quanta, boost and aging of the user levels
+  const SchedPolicy *policy;// orders the user jobs that have their resources
+  AdmissionMode admission;  // what happens to realtime jobs that would miss
+  CompactConfig compaction; // after in ticks
+  FitPolicy fitPolicy;
+  int numCpus;
+  bool virtualTime;         // the clock jumps from event to event, see nextEventTime
+  bool collectStats;        // measure the dispatcher itself
+  const JobBackend *backend;
+
+  int tickMillis;           // length of a tick, set from the quanta
+  int ticksPerSecond;       // dispatch list times are whole seconds
+  int clock;                // in ticks
+  int numJobs;              // jobs added or submitted so far
+  int jobsSubmitted;        // of numJobs, how many went through submitJob
+  int jobsCompleted;
+  pid_t nextVirtualPid;     // the next pid simulatedJobs hands out
+
+  JobTable jobs;            // every PCB of this dispatcher, by slot
+  // user jobs that have their resources wait in the scheduling policy
+  Queue *dispatchQ;         // added jobs that have not arrived yet
+  Queue *submitQ;           // submitted jobs, by arrival time
+  Queue *userQ;             // user jobs that arrived this tick
+  Queue *deferredQ;         // realtime jobs held back by admission control
+  EdfQueue realtimeQ;       // realtime jobs by earliest deadline
+  WaitList waitList;        // user jobs short of resources, by what they are short of
+  Sched *sched;
+  Cpu *cpus;
+  MemMap memMap;            // bitmap of which mb are in use
+  MemArena arena;           // real pages behind memMap once the driver opens it
+  PCB **dying;              // killed jobs with real pages whose exit is not seen yet
+  int numDying, dyingCap;
+  int freeUnits[MAX_RESOURCES]; // units of each kind of device no job holds
+
+  EventQueue events;        // pending arrivals, quantum expiries and completions
+  int arrivalEventTime;     // time of the last arrival event queued
+  int policyEventTime;      // last wakeup queued for the policy
+  int compactEventTime;     // last compaction wakeup queued
+
+  bool compacting;
+  MemHolders memHolders;    // jobs holding memory, tracked only while compacting
+  CompactStats compactStats;
+  int compactedAt;          // time of the last pass
+  int compactedLargest;     // largest free block just before it
+
+  JobMetrics jobMetrics;    // latency histograms of finished jobs
+  DispatchStats stats;
+  int reportedTime;         // tick the resource report was last logged for
+};
+
+void defaultDispatcher(Dispatcher *d);
+void initDispatcher(Dispatcher *d);
+void freeDispatcher(Dispatcher *d);
+void addJob(Dispatcher *d, PCB *job);
+void submitJob(Dispatcher *d, PCB *job);
+bool dispatchPass(Dispatcher *d);
+void chargeCpus(Dispatcher *d);
+bool stepDispatcher(Dispatcher *d, int now);
+int nextEventTime(Dispatcher *d);
+bool dispatcherIdle(Dispatcher *d);
+bool cpusBusy(Dispatcher *d);
+void sampleStats(Dispatcher *d);
+bool jobExited(Dispatcher *d, pid_t pid);
+void jobGone(Dispatcher *d, PCB *job);
+bool jobReaped(Dispatcher *d, pid_t pid);
+bool unitsFit(const int *need, const int *have);
+void saveDispatcher(Dispatcher *d, FILE *f);
+bool loadDispatcher(Dispatcher *d, FILE *f);
+
+#endif
@@ -0,0 +1,323 @@
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "dispatchlist.h"
+
+#define READ_CHUNK (1 << 20) // bytes pulled in per read()
+#define JOB_FIELDS (5 + MAX_RESOURCES)
+
+static void fillBuffer(DispatchReader *r);
+
+/* Checks a binary header, warning about anything that does not add up.
+   Returns false if the records can't be read by this build */
+static bool checkHeader(DispatchReader *r, size_t dataBytes) {
+  DispatchHeader *h = &r->header;
+  bool old = (h->version == 1 && h->recordSize == JOB_RECORD_V1_SIZE) ||
+    (h->version == 2 && h->recordSize == JOB_RECORD_V2_SIZE);
+  if (!old && (h->version != DISPATCH_VERSION || h->recordSize != sizeof(JobRecord))) {
+    fprintf(stderr, "%s: unsupported binary dispatch list (version %u, record size %u)\n",
+        r->path, h->version, h->recordSize);
+    return false;
+  }
+  if (r->mapped && dataBytes != h->jobCount * h->recordSize) {
+    fprintf(stderr, "%s: header says %llu jobs but file holds %zu bytes of records\n",
+        r->path, (unsigned long long)h->jobCount, dataBytes);
+  }
+  return true;
+}
+
+/* Maps a regular file if it starts with the binary magic.
+   Returns false (and leaves the reader untouched) for text files */
+static bool mapBinaryList(DispatchReader *r) {
+  struct stat st;
+  if (fstat(r->fd, &st) < 0 || !S_ISREG(st.st_mode)) return false;
+  if (st.st_size < (off_t)sizeof(DispatchHeader)) return false;
+
+  DispatchHeader h;
+  if (pread(r->fd, &h, sizeof(h), 0) != sizeof(h)) return false;
+  if (memcmp(h.magic, DISPATCH_MAGIC, DISPATCH_MAGIC_LEN) != 0) return false;
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, r->fd, 0);
+  if (map == MAP_FAILED) return false;
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+  r->header = h;
+  r->buf = map;
+  r->cap = r->len = st.st_size;
+  r->pos = sizeof(DispatchHeader);
+  r->eof = true; // everything is already "read"
+  r->binary = true;
+  r->mapped = true;
+  return true;
+}
+
+/* Open a dispatch list for streaming. A path of "-" reads stdin.
+   Text and binary lists are told apart by the binary magic */
+bool openDispatchList(DispatchReader *r, const char *path) {
+  r->path = path;
+  r->fd = (strcmp(path, "-") == 0) ? STDIN_FILENO : open(path, O_RDONLY);
+  if (r->fd < 0) return false;
+
+  r->line = r->jobsRead = r->malformed = 0;
+  r->bufOffset = 0;
+  r->resources = DISPATCH_DEFAULT_RESOURCES;
+  r->binary = r->mapped = false;
+  if (mapBinaryList(r)) {
+    if (checkHeader(r, r->len - r->pos)) return true;
+    closeDispatchList(r);
+    return false;
+  }
+
+  r->buf = malloc(READ_CHUNK);
+  assert(r->buf != NULL); //ensure malloc worked
+  r->cap = READ_CHUNK;
+  r->len = r->pos = 0;
+  r->eof = false;
+
+  // a pipe can't be mapped, so look for the magic in the first bytes read
+  while (r->len < sizeof(DispatchHeader) && !r->eof) fillBuffer(r);
+  if (r->len >= sizeof(DispatchHeader) &&
+      memcmp(r->buf, DISPATCH_MAGIC, DISPATCH_MAGIC_LEN) == 0) {
+    memcpy(&r->header, r->buf, sizeof(DispatchHeader));
+    r->pos = sizeof(DispatchHeader);
+    r->binary = true;
+    if (checkHeader(r, 0)) return true;
+    closeDispatchList(r);
+    return false;
+  }
+  return true;
+}
+
+/* Moves the unparsed tail to the front of the buffer and reads more.
+   The buffer only grows if a single line is longer than it */
+static void fillBuffer(DispatchReader *r) {
+  if (r->pos > 0) {
+    memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+    r->bufOffset += r->pos;
+    r->len -= r->pos;
+    r->pos = 0;
+  }
+  if (r->len == r->cap) {
+    r->cap *= 2;
+    r->buf = realloc(r->buf, r->cap);
+    assert(r->buf != NULL);
+  }
+
+  ssize_t n;
+  do {
+    n = read(r->fd, r->buf + r->len, r->cap - r->len);
+  } while (n < 0 && errno == EINTR);
+
+  if (n <= 0) r->eof = true;
+  else r->len += n;
+}
+
+static bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* Parses one non-negative decimal field. Leaves *p just past it */
+static bool parseField(const char **p, const char *end, int *out) {
+  const char *s = *p;
+  while (s < end && isBlank(*s)) s++;
+
+  int value = 0, digits = 0;
+  while (s < end && *s >= '0' && *s <= '9') {
+    if (++digits > 9) return false; // would overflow an int
+    value = value * 10 + (*s - '0');
+    s++;
+  }
+  if (digits == 0) return false;
+
+  while (s < end && isBlank(*s)) s++;
+  *p = s;
+  *out = value;
+  return true;
+}
+
+/* True for a line with nothing to parse: blank or a # comment */
+bool jobLineEmpty(const char *s, const char *end) {
+  while (s < end && isBlank(*s)) s++;
+  return s == end || *s == '#';
+}
+
+/* Parses the fields of one job line with the given number of device
+   columns into rec. Returns false if the line is malformed */
+bool parseJobRecord(const char *s, const char *end, int resources, JobRecord *rec) {
+  // arrival, priority, cpu time, memory, the devices and maybe a deadline
+  int fields[JOB_FIELDS] = {0};
+  int required = 4 + resources, n = 0;
+  const char *p = s;
+  bool ok = true;
+  while (ok) {
+    ok = parseField(&p, end, &fields[n]);
+    if (!ok) break;
+    n++;
+    if (p == end || n == required + 1 || *p != ',') break;
+    p++;
+  }
+  if (!ok || n < required || p != end) return false;
+
+  memset(rec, 0, sizeof(*rec));
+  rec->arrival_time = fields[0];
+  rec->priority = fields[1];
+  rec->cpu_time = fields[2];
+  rec->mem_req = fields[3];
+  rec->deadline = fields[required];
+  int i;
+  for (i = 0; i < resources; i++) rec->resources[i] = fields[4 + i];
+  return true;
+}
+
+/* Turns one line into a PCB. Returns NULL for blank, comment and
+   malformed lines, reporting the malformed ones */
+static PCB* parseJobLine(DispatchReader *r, const char *s, const char *end) {
+  if (jobLineEmpty(s, end)) return NULL; // nothing to parse
+
+  JobRecord rec;
+  if (!parseJobRecord(s, end, r->resources, &rec)) {
+    r->malformed++;
+    while (end > s && isBlank(end[-1])) end--;
+    fprintf(stderr, "%s:%ld: skipping malformed job: %.*s\n",
+        r->path, r->line, (int)(end - s), s);
+    return NULL;
+  }
+  return newJobFromRecord(r->jobs, &rec);
+}
+
+/* Widens a version 1 or 2 record, which had four fixed device fields */
+static void upgradeRecord(const int32_t *old, uint32_t size, JobRecord *rec) {
+  memset(rec, 0, sizeof(*rec));
+  rec->arrival_time = old[0];
+  rec->priority = old[1];
+  rec->cpu_time = old[2];
+  rec->mem_req = old[3];
+  memcpy(rec->resources, old + 4, DISPATCH_DEFAULT_RESOURCES * sizeof(int32_t));
+  if (size == JOB_RECORD_V2_SIZE) rec->deadline = old[8];
+}
+
+/* Returns the next record of a binary list, or NULL at the end */
+static PCB* readNextRecord(DispatchReader *r) {
+  size_t size = r->header.recordSize;
+  while (r->len - r->pos < size && !r->eof) fillBuffer(r);
+  if (r->len - r->pos < size) {
+    if (r->pos != r->len) {
+      fprintf(stderr, "%s: ignoring %zu trailing bytes of a partial record\n",
+          r->path, r->len - r->pos);
+      r->pos = r->len;
+    }
+    return NULL;
+  }
+
+  // records are 4 byte aligned both in the map and in the buffer
+  const JobRecord *rec = (const JobRecord *)(r->buf + r->pos);
+  JobRecord widened;
+  if (r->header.version < DISPATCH_VERSION) {
+    upgradeRecord((const int32_t *)rec, size, &widened);
+    rec = &widened;
+  }
+  r->pos += size;
+  r->line++;
+  r->jobsRead++;
+  return newJobFromRecord(r->jobs, rec);
+}
+
+/* Creates a PCB in table t for a job that has not started yet */
+PCB* newJobFromRecord(JobTable *t, const JobRecord *rec) {
+  PCB *job = newJob(t);
+  job->id = 0; // numbered by whoever reads the list
+  job->pid = -1; //process is not 'live' yet
+  job->mem_start = -1; // no memory assigned yet
+  job->state = JOB_NEW;
+  job->arrival_time = rec->arrival_time;
+  job->priority = rec->priority;
+  job->cpu_time = rec->cpu_time;
+  job->time_left = rec->cpu_time;
+  job->level_used = 0;
+  job->deadline = (rec->deadline > 0) ? rec->arrival_time + rec->deadline : -1;
+  job->mem_req = rec->mem_req;
+  memcpy(job->resources, rec->resources, sizeof(job->resources));
+  job->first_run = -1;
+  job->completion = -1;
+  job->queued_at = rec->arrival_time;
+  job->user_wait = 0;
+  memset(job->level_wait, 0, sizeof(job->level_wait));
+  syncJob(t, job);
+  return job;
+}
+
+/* Copies the dispatch list fields of a job into a record */
+void jobToRecord(const PCB *job, JobRecord *rec) {
+  rec->arrival_time = job->arrival_time;
+  rec->priority = job->priority;
+  rec->cpu_time = job->cpu_time;
+  rec->mem_req = job->mem_req;
+  memcpy(rec->resources, job->resources, sizeof(rec->resources));
+  rec->deadline = (job->deadline >= 0) ? job->deadline - job->arrival_time : 0;
+}
+
+/* Returns the next job in the file or NULL once it is exhausted.
+   Each line holds arrival time, priority, cpu time, memory, one column
+   per kind of device (printers, scanners, modems and CDs unless the
+   machine says otherwise), and optionally a deadline */
+PCB* readNextJob(DispatchReader *r) {
+  if (r->binary) return readNextRecord(r);
+
+  while (1) {
+    char *start = r->buf + r->pos;
+    char *nl = memchr(start, '\n', r->len - r->pos);
+
+    if (nl == NULL) {
+      if (!r->eof) {
+        fillBuffer(r);
+        continue;
+      }
+      if (r->pos == r->len) return NULL; // nothing left at all
+      nl = r->buf + r->len; // last line has no newline
+      r->pos = r->len;
+    } else {
+      r->pos = nl - r->buf + 1;
+    }
+
+    r->line++;
+    PCB *job = parseJobLine(r, start, nl);
+    if (job != NULL) {
+      r->jobsRead++;
+      return job;
+    }
+  }
+}
+
+/* True once every line has been consumed */
+bool dispatchListDone(DispatchReader *r) {
+  return r->eof && r->pos == r->len;
+}
+
+/* File offset of the next line or record to be read */
+long dispatchListOffset(DispatchReader *r) {
+  return r->bufOffset + r->pos;
+}
+
+/* Carries on reading from an offset returned by dispatchListOffset,
+   eg. when restoring a checkpoint. Fails for lists that can't seek */
+bool seekDispatchList(DispatchReader *r, long offset) {
+  if (r->mapped) {
+    if (offset < (long)sizeof(DispatchHeader) || offset > (long)r->len) return false;
+    r->pos = offset;
+    return true;
+  }
+  if (lseek(r->fd, offset, SEEK_SET) < 0) return false;
+  r->bufOffset = offset;
+  r->len = r->pos = 0;
+  r->eof = false;
+  return true;
+}
+
+void closeDispatchList(DispatchReader *r) {
+  if (r->fd > STDIN_FILENO) close(r->fd);
+  if (r->mapped) munmap(r->buf, r->len);
+  else free(r->buf);
+  r->buf = NULL;
+  r->fd = -1;
+}
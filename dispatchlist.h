@@ -0,0 +1,73 @@
+#ifndef DISPATCHLIST_H
+#define DISPATCHLIST_H
+
+#include "jobtable.h"
+
+#include <stdint.h>
+
+/* Binary dispatch list layout (native byte order):
+   a DispatchHeader followed by jobCount fixed size JobRecords,
+   sorted by ascending arrival time like the text format */
+#define DISPATCH_MAGIC "HOSTDJOB"
+#define DISPATCH_MAGIC_LEN 8
+#define DISPATCH_VERSION 3 // versions 1 and 2 had four fixed devices, they are still read
+
+typedef struct dispatchHeader {
+  char magic[DISPATCH_MAGIC_LEN];
+  uint32_t version;
+  uint32_t recordSize;   // sizeof(JobRecord) when the file was written
+  uint64_t jobCount;
+  int32_t firstArrival;
+  int32_t lastArrival;
+} DispatchHeader;
+
+/* The fields of a dispatch line. A text line has the device columns
+   after memory, one per machine device, and the deadline last. The
+   deadline is optional in text, in seconds after arrival and 0 for none */
+typedef struct jobRecord {
+  int32_t arrival_time;
+  int32_t priority;
+  int32_t cpu_time;
+  int32_t mem_req;
+  int32_t deadline;
+  int32_t resources[MAX_RESOURCES]; // unused kinds are 0
+} JobRecord;
+
+#define JOB_RECORD_V1_SIZE 32 // arrival, priority, cpu, memory and 4 devices
+#define JOB_RECORD_V2_SIZE 36 // the same followed by the deadline
+#define DISPATCH_DEFAULT_RESOURCES 4 // printers, scanners, modems and cds
+
+/* Streams jobs out of a dispatch list with large buffered reads.
+   Only the unread part of the current buffer is held in memory.
+   Binary lists in regular files are mmap'd and read in place */
+typedef struct dispatchReader {
+  const char *path;
+  int fd;
+  char *buf;
+  size_t cap;
+  size_t len;       // bytes currently in buf
+  size_t pos;       // start of the next unparsed line or record
+  long bufOffset;   // file offset buf starts at
+  bool eof;
+  bool binary;      // file holds JobRecords instead of text
+  bool mapped;      // buf is an mmap of the whole file
+  DispatchHeader header; // only valid for binary lists
+  long line;        // number of the last line parsed
+  long jobsRead;
+  long malformed;   // lines that were skipped because they did not parse
+  int resources;    // device columns in a text line
+  JobTable *jobs;   // where the jobs read get their PCBs, set by the caller
+} DispatchReader;
+
+bool openDispatchList(DispatchReader *r, const char *path);
+PCB* readNextJob(DispatchReader *r);
+bool dispatchListDone(DispatchReader *r);
+void closeDispatchList(DispatchReader *r);
+long dispatchListOffset(DispatchReader *r);
+bool seekDispatchList(DispatchReader *r, long offset);
+bool jobLineEmpty(const char *s, const char *end);
+bool parseJobRecord(const char *s, const char *end, int resources, JobRecord *rec);
+PCB* newJobFromRecord(JobTable *t, const JobRecord *rec);
+void jobToRecord(const PCB *job, JobRecord *rec);
+
+#endif
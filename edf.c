@@ -0,0 +1,184 @@
+#include "edf.h"
+#include "queue.h"
+#include "checkpoint.h"
+#include "jobtable.h"
+
+void initEdfQueue(EdfQueue *q, JobTable *jobs) {
+  memset(q, 0, sizeof(*q));
+  q->jobs = jobs;
+}
+
+/* True if a has to be run before b. No deadline counts as the latest */
+bool deadlineBefore(const PCB *a, const PCB *b) {
+  if (a->deadline < 0) return false;
+  return b->deadline < 0 || a->deadline < b->deadline;
+}
+
+static bool entryBefore(const EdfEntry *a, const EdfEntry *b) {
+  if (deadlineBefore(a->job, b->job)) return true;
+  if (deadlineBefore(b->job, a->job)) return false;
+  return a->seq < b->seq;
+}
+
+static void siftUp(EdfQueue *q, int i) {
+  EdfEntry e = q->heap[i];
+  while (i > 0 && entryBefore(&e, &q->heap[(i - 1) / 2])) {
+    q->heap[i] = q->heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  q->heap[i] = e;
+}
+
+static void siftDown(EdfQueue *q, int i) {
+  EdfEntry e = q->heap[i];
+  while (1) {
+    int child = 2 * i + 1;
+    if (child >= q->size) break;
+    if (child + 1 < q->size && entryBefore(&q->heap[child + 1], &q->heap[child])) child++;
+    if (!entryBefore(&q->heap[child], &e)) break;
+    q->heap[i] = q->heap[child];
+    i = child;
+  }
+  q->heap[i] = e;
+}
+
+/* Queues a job behind every job with the same or an earlier deadline */
+void edfPush(EdfQueue *q, PCB *job) {
+  if (q->size == q->capacity) {
+    q->capacity = q->capacity ? q->capacity * 2 : 16;
+    q->heap = realloc(q->heap, q->capacity * sizeof(EdfEntry));
+    assert(q->heap != NULL);
+  }
+  q->heap[q->size].job = job;
+  q->heap[q->size].seq = q->seq++;
+  siftUp(q, q->size++);
+}
+
+/* Takes out the job with the earliest deadline, NULL if there is none */
+PCB* edfPop(EdfQueue *q) {
+  if (q->size == 0) return NULL;
+  PCB *job = q->heap[0].job;
+  q->heap[0] = q->heap[--q->size];
+  if (q->size > 0) siftDown(q, 0);
+  return job;
+}
+
+PCB* edfPeek(EdfQueue *q) {
+  return q->size > 0 ? q->heap[0].job : NULL;
+}
+
+/* Unlinks a job from anywhere in the heap without freeing it.
+   This is a linear search so it is only meant for rare events */
+bool edfRemove(EdfQueue *q, PCB *job) {
+  int i;
+  for (i = 0; i < q->size; i++) {
+    if (q->heap[i].job == job) break;
+  }
+  if (i == q->size) return false;
+  q->heap[i] = q->heap[--q->size];
+  if (i < q->size) {
+    siftUp(q, i);
+    siftDown(q, i);
+  }
+  return true;
+}
+
+int edfLength(EdfQueue *q) {
+  return q->size;
+}
+
+static int compareEntries(const void *a, const void *b) {
+  return entryBefore(a, b) ? -1 : entryBefore(b, a) ? 1 : 0;
+}
+
+/* Logs the waiting jobs in the order they will be dispatched */
+void printEdfQueue(char *name, EdfQueue *q) {
+  EdfEntry *sorted = malloc((q->size + 1) * sizeof(EdfEntry));
+  PCB **jobs = malloc((q->size + 1) * sizeof(PCB *));
+  assert(sorted != NULL && jobs != NULL);
+  memcpy(sorted, q->heap, q->size * sizeof(EdfEntry));
+  qsort(sorted, q->size, sizeof(EdfEntry), compareEntries);
+  int i;
+  for (i = 0; i < q->size; i++) jobs[i] = sorted[i].job;
+  printJobs(q->jobs, name, jobs, q->size);
+  free(jobs);
+  free(sorted);
+}
+
+/* Frees the heap and every job still in it */
+void deleteEdfQueue(EdfQueue *q) {
+  int i;
+  for (i = 0; i < q->size; i++) freeJob(q->jobs, q->heap[i].job);
+  free(q->heap);
+  memset(q, 0, sizeof(*q));
+}
+
+/* Writes the heap as it is, each job with its place in line */
+void saveEdfQueue(FILE *f, EdfQueue *q) {
+  int i;
+  SAVE(f, q->seq);
+  SAVE(f, q->size);
+  for (i = 0; i < q->size; i++) {
+    SAVE(f, q->heap[i].seq);
+    saveJob(f, q->heap[i].job);
+  }
+}
+
+/* Reads a heap written by saveEdfQueue into an empty queue */
+bool loadEdfQueue(FILE *f, EdfQueue *q) {
+  int size, i;
+  if (!LOAD(f, q->seq) || !LOAD(f, size) || size < 0) return false;
+  for (i = 0; i < size; i++) {
+    unsigned long seq;
+    PCB *job = LOAD(f, seq) ? loadJob(f, q->jobs) : NULL;
+    if (job == NULL) return false;
+    if (q->size == q->capacity) {
+      q->capacity = q->capacity ? q->capacity * 2 : 16;
+      q->heap = realloc(q->heap, q->capacity * sizeof(EdfEntry));
+      assert(q->heap != NULL);
+    }
+    q->heap[q->size].job = job;
+    q->heap[q->size++].seq = seq;
+  }
+  return true;
+}
+
+/* Share of a cpu the job needs from now until its deadline, or -1 for
+   jobs it means nothing for: no deadline, or one already gone by */
+static double density(const PCB *job, int now) {
+  if (job->deadline <= now) return -1;
+  return (double)job->time_left / (job->deadline - now);
+}
+
+/* Utilization based admission test. A set of one-off jobs meets every
+   deadline under global EDF on m cpus if their densities add up to at
+   most m - (m - 1) * the largest one (Goossens, Funk and Baruah's bound,
+   which is just "at most 1" on one cpu). The test counts the waiting
+   and running realtime jobs plus the new one. It is sufficient, not
+   exact, so it can turn away a job that would in fact have made it */
+bool edfAdmits(EdfQueue *q, PCB *job, Cpu *cpus, int numCpus, int now) {
+  double d = density(job, now);
+  if (d < 0) return job->deadline < 0;
+  double total = d, max = d, od;
+  int i;
+  for (i = 0; i < q->size; i++) {
+    if ((od = density(q->heap[i].job, now)) < 0) continue;
+    total += od;
+    if (od > max) max = od;
+  }
+  for (i = 0; i < numCpus; i++) {
+    if (cpus[i].job == NULL || cpus[i].level != 0) continue;
+    if ((od = density(cpus[i].job, now)) < 0) continue;
+    total += od;
+    if (od > max) max = od;
+  }
+  return max <= 1 && total <= numCpus - (numCpus - 1) * max;
+}
+
+bool parseAdmissionMode(const char *name, AdmissionMode *mode) {
+  if (strcmp(name, "off") == 0) *mode = ADMIT_ALL;
+  else if (strcmp(name, "reject") == 0) *mode = ADMIT_REJECT;
+  else if (strcmp(name, "defer") == 0) *mode = ADMIT_DEFER;
+  else return false;
+  return true;
+}
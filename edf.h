@@ -0,0 +1,44 @@
+#ifndef EDF_H
+#define EDF_H
+
+#include "jobtable.h"
+
+/* How realtime jobs with deadlines are admitted */
+typedef enum {
+  ADMIT_ALL,    // no admission control
+  ADMIT_REJECT, // drop a job that would not fit
+  ADMIT_DEFER   // hold it back until it fits or can no longer make it
+} AdmissionMode;
+
+/* One waiting realtime job and its place in line */
+typedef struct edfEntry {
+  PCB *job;
+  unsigned long seq; // queueing order, breaks ties between equal deadlines
+} EdfEntry;
+
+/* Realtime jobs waiting for a cpu as a min-heap on (deadline, seq).
+   Jobs without a deadline sort after every job that has one, in the
+   order they were queued, so with no deadlines this is plain FIFO */
+typedef struct edfQueue {
+  JobTable *jobs; // the table its jobs are in
+  EdfEntry *heap;
+  int size;
+  int capacity;
+  unsigned long seq;
+} EdfQueue;
+
+void initEdfQueue(EdfQueue *q, JobTable *jobs);
+void edfPush(EdfQueue *q, PCB *job);
+PCB* edfPop(EdfQueue *q);
+PCB* edfPeek(EdfQueue *q);
+bool edfRemove(EdfQueue *q, PCB *job);
+int edfLength(EdfQueue *q);
+void printEdfQueue(char *name, EdfQueue *q);
+void deleteEdfQueue(EdfQueue *q);
+void saveEdfQueue(FILE *f, EdfQueue *q);
+bool loadEdfQueue(FILE *f, EdfQueue *q);
+bool deadlineBefore(const PCB *a, const PCB *b);
+bool edfAdmits(EdfQueue *q, PCB *job, Cpu *cpus, int numCpus, int now);
+bool parseAdmissionMode(const char *name, AdmissionMode *mode);
+
+#endif
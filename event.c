@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "event.h"
+
+#define INITIAL_EVENTS 64
+
+/* True if event a has to fire before event b */
+static bool before(Event *a, Event *b) {
+  if (a->time != b->time) return a->time < b->time;
+  return a->seq < b->seq;
+}
+
+static void swapEvents(Event *a, Event *b) {
+  Event temp = *a;
+  *a = *b;
+  *b = temp;
+}
+
+void initEventQueue(EventQueue *q) {
+  q->heap = malloc(INITIAL_EVENTS * sizeof(Event));
+  assert(q->heap != NULL); //ensure malloc worked
+  q->size = 0;
+  q->capacity = INITIAL_EVENTS;
+  q->seq = 0;
+}
+
+void destroyEventQueue(EventQueue *q) {
+  free(q->heap);
+  q->heap = NULL;
+  q->size = q->capacity = 0;
+}
+
+/* Adds an event and sifts it up to its place in the heap */
+void pushEvent(EventQueue *q, int time, EventType type, int cpu) {
+  if (q->size == q->capacity) {
+    q->capacity *= 2;
+    q->heap = realloc(q->heap, q->capacity * sizeof(Event));
+    assert(q->heap != NULL);
+  }
+
+  int i = q->size++;
+  q->heap[i].time = time;
+  q->heap[i].type = type;
+  q->heap[i].cpu = cpu;
+  q->heap[i].seq = q->seq++;
+
+  while (i > 0 && before(&q->heap[i], &q->heap[(i - 1) / 2])) {
+    swapEvents(&q->heap[i], &q->heap[(i - 1) / 2]);
+    i = (i - 1) / 2;
+  }
+}
+
+/* Removes and returns the earliest event. The queue must not be empty */
+Event popEvent(EventQueue *q) {
+  assert(q->size > 0);
+  Event top = q->heap[0];
+  q->heap[0] = q->heap[--q->size];
+
+  int i = 0;
+  while (1) {
+    int left = 2 * i + 1, right = left + 1, smallest = i;
+    if (left < q->size && before(&q->heap[left], &q->heap[smallest])) smallest = left;
+    if (right < q->size && before(&q->heap[right], &q->heap[smallest])) smallest = right;
+    if (smallest == i) break;
+    swapEvents(&q->heap[i], &q->heap[smallest]);
+    i = smallest;
+  }
+  return top;
+}
+
+/* Returns the earliest event without removing it, or NULL */
+Event* peekEvent(EventQueue *q) {
+  return (q->size > 0) ? &q->heap[0] : NULL;
+}
+
+bool eventsPending(EventQueue *q) {
+  return q->size > 0;
+}
+
+/* Writes the pending events, in heap order, for a checkpoint */
+void saveEventQueue(FILE *f, EventQueue *q) {
+  fwrite(&q->seq, sizeof(q->seq), 1, f);
+  fwrite(&q->size, sizeof(q->size), 1, f);
+  fwrite(q->heap, sizeof(Event), q->size, f);
+}
+
+/* Replaces the events with ones written by saveEventQueue. The heap
+   order is kept so ties between equal times break the same way */
+bool loadEventQueue(FILE *f, EventQueue *q) {
+  int size;
+  if (fread(&q->seq, sizeof(q->seq), 1, f) != 1 ||
+      fread(&size, sizeof(size), 1, f) != 1 || size < 0) {
+    return false;
+  }
+  while (q->capacity < size) {
+    q->capacity *= 2;
+    q->heap = realloc(q->heap, q->capacity * sizeof(Event));
+    assert(q->heap != NULL);
+  }
+  q->size = size;
+  return fread(q->heap, sizeof(Event), size, f) == (size_t)size;
+}
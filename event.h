@@ -0,0 +1,40 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Things that can wake the dispatcher up in virtual time */
+typedef enum {
+  EV_ARRIVAL,   // next job in the dispatch list arrives
+  EV_QUANTUM,   // running job used up its time slice
+  EV_COMPLETE,  // running job finished its cpu time
+  EV_POLICY,    // the scheduling policy asked to be woken, eg. for a boost
+  EV_COMPACT    // a job kept out by memory holes has waited long enough
+} EventType;
+
+typedef struct event {
+  int time;
+  EventType type;
+  int cpu;             // cpu the event belongs to, -1 for arrivals and policy wakeups
+  unsigned long seq;   // insertion order, breaks ties between equal times
+} Event;
+
+/* Binary min-heap of events ordered by (time, seq) */
+typedef struct eventQueue {
+  Event *heap;
+  int size;
+  int capacity;
+  unsigned long seq;
+} EventQueue;
+
+void initEventQueue(EventQueue *q);
+void destroyEventQueue(EventQueue *q);
+void pushEvent(EventQueue *q, int time, EventType type, int cpu);
+Event popEvent(EventQueue *q);
+Event* peekEvent(EventQueue *q);
+bool eventsPending(EventQueue *q);
+void saveEventQueue(FILE *f, EventQueue *q);
+bool loadEventQueue(FILE *f, EventQueue *q);
+
+#endif
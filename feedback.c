@@ -0,0 +1,63 @@
+#include <stdlib.h>
+#include <string.h>
+#include "feedback.h"
+
+/* One second quanta at every level and no boost or aging, which is how
+   the dispatcher has always behaved */
+void defaultFeedbackConfig(FeedbackConfig *f) {
+  int i;
+  for (i = 0; i < FEEDBACK_LEVELS; i++) f->quantum[i] = 1000;
+  f->boostEvery = 0;
+  f->ageAfter = 0;
+}
+
+/* Reads a duration such as "250ms", "2s" or "1.5s". A bare number is
+   milliseconds. The result must be a whole number of milliseconds */
+bool parseDuration(const char *text, int *millis) {
+  char *end;
+  double value = strtod(text, &end);
+  if (end == text || value < 0) return false;
+  if (strcmp(end, "s") == 0) value *= 1000;
+  else if (*end != '\0' && strcmp(end, "ms") != 0) return false;
+  if (value > 1e9 || value != (int)value) return false;
+  *millis = (int)value;
+  return true;
+}
+
+/* Reads comma separated quanta for p1Q, p2Q and p3Q. Levels left out
+   reuse the last quantum given, so "500ms" sets all three */
+bool parseQuanta(const char *text, FeedbackConfig *f) {
+  char *copy = strdup(text), *save, *word;
+  int level = 0;
+  bool ok = copy != NULL;
+  for (word = ok ? strtok_r(copy, ",", &save) : NULL; word != NULL && ok;
+       word = strtok_r(NULL, ",", &save)) {
+    ok = level < FEEDBACK_LEVELS && parseDuration(word, &f->quantum[level]) &&
+      f->quantum[level] > 0;
+    level++;
+  }
+  free(copy);
+  if (!ok || level == 0) return false;
+  for (; level < FEEDBACK_LEVELS; level++) f->quantum[level] = f->quantum[level - 1];
+  return true;
+}
+
+static int gcd(int a, int b) {
+  while (b != 0) {
+    int t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/* The dispatcher tick: the longest length that every quantum, the boost
+   and aging periods, and whole seconds (the unit of the dispatch list)
+   are all multiples of */
+int feedbackTickMillis(const FeedbackConfig *f) {
+  int tick = 1000, i;
+  for (i = 0; i < FEEDBACK_LEVELS; i++) tick = gcd(tick, f->quantum[i]);
+  if (f->boostEvery > 0) tick = gcd(tick, f->boostEvery);
+  if (f->ageAfter > 0) tick = gcd(tick, f->ageAfter);
+  return tick;
+}
@@ -0,0 +1,20 @@
+#ifndef FEEDBACK_H
+#define FEEDBACK_H
+
+#include <stdbool.h>
+
+#define FEEDBACK_LEVELS 3 // p1Q, p2Q and p3Q
+
+/* How the user feedback queues behave. All times are in milliseconds */
+typedef struct feedbackConfig {
+  int quantum[FEEDBACK_LEVELS]; // cpu time a job gets at a level before moving down
+  int boostEvery;               // put every user job back in p1Q this often, 0 = never
+  int ageAfter;                 // move a job waiting this long in p2Q or p3Q up one level, 0 = never
+} FeedbackConfig;
+
+void defaultFeedbackConfig(FeedbackConfig *f);
+bool parseDuration(const char *text, int *millis);
+bool parseQuanta(const char *text, FeedbackConfig *f);
+int feedbackTickMillis(const FeedbackConfig *f);
+
+#endif
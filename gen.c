@@ -0,0 +1,229 @@
+#include "hostd.h"
+#include <stdint.h>
+#include <math.h>
+
+/* hostd-gen: writes a synthetic dispatch list. Arrivals, the priority mix,
+   cpu times, memory and device demand are all configurable and the same
+   seed always produces the same list */
+
+#define MAX_USER_MEMORY 960
+#define MAX_RT_MEMORY 64 // realtime jobs are expected to fit the reserved area
+#define MAX_CPU_TIME 1000000
+
+/* How a random quantity is drawn. The mean is given by the user */
+typedef enum {
+  DIST_FIXED,      // always the mean
+  DIST_UNIFORM,    // uniform on [1, 2*mean - 1]
+  DIST_EXP,        // exponential, the classic memoryless job length
+  DIST_PARETO      // heavy tailed, a few jobs dominate the total
+} Dist;
+
+typedef struct distSpec {
+  Dist dist;
+  double mean;
+} DistSpec;
+
+typedef enum {
+  ARRIVE_UNIFORM,  // evenly spaced at the given rate
+  ARRIVE_POISSON,  // exponential gaps at the given rate
+  ARRIVE_BURST     // groups of burst jobs at the same second
+} ArrivalPattern;
+
+static uint64_t rngState = 0x9e3779b97f4a7c15ULL;
+
+/* xorshift64*, so lists are reproducible whatever libc rand() does */
+static uint64_t nextRandom() {
+  rngState ^= rngState >> 12;
+  rngState ^= rngState << 25;
+  rngState ^= rngState >> 27;
+  return rngState * 0x2545f4914f6cdd1dULL;
+}
+
+/* Uniform on (0, 1) */
+static double randomUnit() {
+  return ((nextRandom() >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static double exponential(double mean) {
+  return -mean * log(randomUnit());
+}
+
+/* Draws a value >= 1 from spec, rounded to the nearest integer */
+static int draw(DistSpec *spec) {
+  double x;
+  switch (spec->dist) {
+    case DIST_UNIFORM: x = 1 + randomUnit() * (2 * spec->mean - 2); break;
+    case DIST_EXP: x = exponential(spec->mean); break;
+    case DIST_PARETO: {
+      // shape 1.5 gives a finite mean of 3 * scale
+      double scale = spec->mean / 3.0;
+      x = scale / pow(randomUnit(), 1 / 1.5);
+      break;
+    }
+    default: x = spec->mean; break;
+  }
+  if (x < 1) x = 1;
+  if (x > MAX_CPU_TIME) x = MAX_CPU_TIME;
+  return (int)(x + 0.5);
+}
+
+/* Parses "kind:mean", eg. exp:5 or fixed:64 */
+static bool parseDist(const char *arg, DistSpec *spec) {
+  const char *colon = strchr(arg, ':');
+  if (colon == NULL) return false;
+  size_t n = colon - arg;
+  if (strncmp(arg, "fixed", n) == 0 && n == 5) spec->dist = DIST_FIXED;
+  else if (strncmp(arg, "uniform", n) == 0 && n == 7) spec->dist = DIST_UNIFORM;
+  else if (strncmp(arg, "exp", n) == 0 && n == 3) spec->dist = DIST_EXP;
+  else if (strncmp(arg, "pareto", n) == 0 && n == 6) spec->dist = DIST_PARETO;
+  else return false;
+  spec->mean = atof(colon + 1);
+  return spec->mean >= 1;
+}
+
+/* Parses the "rt,p1,p2,p3" weights of the priority mix */
+static bool parseMix(const char *arg, double mix[4]) {
+  double total = 0;
+  if (sscanf(arg, "%lf,%lf,%lf,%lf", &mix[0], &mix[1], &mix[2], &mix[3]) != 4) return false;
+  int i;
+  for (i = 0; i < 4; i++) {
+    if (mix[i] < 0) return false;
+    total += mix[i];
+  }
+  return total > 0;
+}
+
+static int drawPriority(double mix[4]) {
+  double total = mix[0] + mix[1] + mix[2] + mix[3];
+  double x = randomUnit() * total;
+  int p;
+  for (p = 0; p < 3; p++) {
+    if (x < mix[p]) return p;
+    x -= mix[p];
+  }
+  return 3;
+}
+
+/* Asks for each unit of a device with the given probability */
+static int drawDevices(int max, double p) {
+  int n = 0, i;
+  for (i = 0; i < max; i++) {
+    if (randomUnit() < p) n++;
+  }
+  return n;
+}
+
+static void printGenUsage(char *name) {
+  printf("Usage: %s [options] [output]\n", name);
+  printf("Writes a synthetic dispatch list to output or stdout.\n");
+  printf("  -n, --jobs <n>           number of jobs (default 1000)\n");
+  printf("  -a, --arrival <uniform|poisson|burst>  arrival pattern (default poisson)\n");
+  printf("  -r, --rate <jobs/s>      mean arrival rate (default 1)\n");
+  printf("  -B, --burst <n>          jobs per burst for burst arrivals (default 10)\n");
+  printf("  -m, --mix <rt,p1,p2,p3>  priority weights (default 1,3,3,3)\n");
+  printf("  -c, --cpu-time <dist:mean>  cpu time, dist is fixed, uniform, exp or pareto (default exp:4)\n");
+  printf("  -M, --mem <dist:mean>    memory in mb (default uniform:64)\n");
+  printf("  -d, --devices <p>        chance of asking for each printer, scanner, modem and cd (default 0.1)\n");
+  printf("  -S, --seed <n>           random seed (default 1)\n");
+  printf("  -D, --deadline <factor>  give realtime jobs a deadline of factor x their cpu time (default none)\n");
+}
+
+int main(int argc, char **argv) {
+  long jobs = 1000;
+  ArrivalPattern arrival = ARRIVE_POISSON;
+  double rate = 1.0, devices = 0.1;
+  int burst = 10;
+  double mix[4] = {1, 3, 3, 3};
+  DistSpec cpuTime = {DIST_EXP, 4};
+  DistSpec mem = {DIST_UNIFORM, 64};
+  unsigned long seed = 1;
+  double deadlineFactor = 0; // none
+
+  static struct option longOptions[] = {
+    {"jobs", required_argument, NULL, 'n'},
+    {"arrival", required_argument, NULL, 'a'},
+    {"rate", required_argument, NULL, 'r'},
+    {"burst", required_argument, NULL, 'B'},
+    {"mix", required_argument, NULL, 'm'},
+    {"cpu-time", required_argument, NULL, 'c'},
+    {"mem", required_argument, NULL, 'M'},
+    {"devices", required_argument, NULL, 'd'},
+    {"seed", required_argument, NULL, 'S'},
+    {"deadline", required_argument, NULL, 'D'},
+    {NULL, 0, NULL, 0}
+  };
+  int opt;
+  bool ok = true;
+  while (ok && (opt = getopt_long(argc, argv, "n:a:r:B:m:c:M:d:S:D:", longOptions, NULL)) != -1) {
+    switch (opt) {
+      case 'n': jobs = atol(optarg); break;
+      case 'a':
+        if (strcmp(optarg, "uniform") == 0) arrival = ARRIVE_UNIFORM;
+        else if (strcmp(optarg, "poisson") == 0) arrival = ARRIVE_POISSON;
+        else if (strcmp(optarg, "burst") == 0) arrival = ARRIVE_BURST;
+        else ok = false;
+        break;
+      case 'r': rate = atof(optarg); ok = rate > 0; break;
+      case 'B': burst = atoi(optarg); ok = burst > 0; break;
+      case 'm': ok = parseMix(optarg, mix); break;
+      case 'c': ok = parseDist(optarg, &cpuTime); break;
+      case 'M': ok = parseDist(optarg, &mem); break;
+      case 'd': devices = atof(optarg); break;
+      case 'S': seed = strtoul(optarg, NULL, 0); break;
+      case 'D': deadlineFactor = atof(optarg); ok = deadlineFactor >= 1; break;
+      default: ok = false; break;
+    }
+  }
+  if (!ok || argc - optind > 1) {
+    printGenUsage(argv[0]);
+    return 1;
+  }
+
+  FILE *out = stdout;
+  if (optind < argc) {
+    out = fopen(argv[optind], "w");
+    if (out == NULL) {
+      printf("Could not create file %s.\n", argv[optind]);
+      return 1;
+    }
+  }
+  rngState ^= seed * 0x100000001b3ULL;
+  if (rngState == 0) rngState = 1;
+
+  // arrivals are drawn in fractional seconds and truncated, so they stay sorted
+  double now = 0;
+  long i;
+  for (i = 0; i < jobs; i++) {
+    switch (arrival) {
+      case ARRIVE_UNIFORM: now = i / rate; break;
+      case ARRIVE_POISSON: if (i > 0) now += exponential(1.0 / rate); break;
+      case ARRIVE_BURST: now = (i / burst) * (burst / rate); break;
+    }
+
+    int priority = drawPriority(mix);
+    int memReq = draw(&mem);
+    int limit = (priority == 0) ? MAX_RT_MEMORY : MAX_USER_MEMORY;
+    if (memReq > limit) memReq = limit;
+
+    // realtime jobs never get devices
+    int p = 0, s = 0, m = 0, c = 0;
+    if (priority > 0) {
+      p = drawDevices(2, devices);
+      s = drawDevices(1, devices);
+      m = drawDevices(1, devices);
+      c = drawDevices(2, devices);
+    }
+    int cpu = draw(&cpuTime);
+    fprintf(out, "%d, %d, %d, %d, %d, %d, %d, %d",
+        (int)now, priority, cpu, memReq, p, s, m, c);
+    // the deadline is relative to arrival, the job has factor x its cpu time
+    if (priority == 0 && deadlineFactor > 0) fprintf(out, ", %d", (int)ceil(cpu * deadlineFactor));
+    fprintf(out, "\n");
+  }
+
+  if (out != stdout && fclose(out) != 0) {
+    printf("Failed writing %s.\n", argv[optind]);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,80 @@
+#include <string.h>
+#include "histogram.h"
+
+/* Bucket holding value. Small values map to themselves, larger ones keep
+   their top HIST_SUB_BITS bits */
+static int bucketOf(uint64_t value) {
+  if (value < 2 * HIST_HALF) return (int)value;
+  int shift = 63 - __builtin_clzll(value) - (HIST_SUB_BITS - 1);
+  return (shift + 1) * HIST_HALF + (int)(value >> shift) - HIST_HALF;
+}
+
+/* Largest value that lands in bucket b */
+static uint64_t bucketTop(int b) {
+  if (b < 2 * HIST_HALF) return b;
+  int shift = b / HIST_HALF - 1;
+  uint64_t sub = b % HIST_HALF + HIST_HALF;
+  return ((sub + 1) << shift) - 1;
+}
+
+void initHistogram(Histogram *h) {
+  memset(h, 0, sizeof(*h));
+}
+
+/* Negative values are clamped to zero */
+void recordValue(Histogram *h, int64_t value) {
+  if (value < 0) value = 0;
+  h->counts[bucketOf((uint64_t)value)]++;
+  if (h->total == 0 || value < h->min) h->min = value;
+  if (value > h->max) h->max = value;
+  h->total++;
+  h->sum += value;
+}
+
+/* Smallest recorded value (to bucket precision) that percentile percent
+   of the values are at or below. Returns 0 for an empty histogram */
+int64_t valueAtPercentile(Histogram *h, double percentile) {
+  if (h->total == 0) return 0;
+  uint64_t rank = (uint64_t)(percentile / 100.0 * h->total + 0.5);
+  if (rank < 1) rank = 1;
+  if (rank > h->total) rank = h->total;
+
+  uint64_t seen = 0;
+  int b;
+  for (b = 0; b < HIST_BUCKETS; b++) {
+    seen += h->counts[b];
+    if (seen >= rank) {
+      int64_t top = (int64_t)bucketTop(b);
+      return top < h->max ? top : h->max;
+    }
+  }
+  return h->max;
+}
+
+double histogramMean(Histogram *h) {
+  return h->total ? h->sum / h->total : 0.0;
+}
+
+/* Writes the buckets up to the last one in use, which for dispatcher
+   latencies is a small part of them, then the summary fields */
+void saveHistogram(FILE *f, Histogram *h) {
+  int used = HIST_BUCKETS;
+  while (used > 0 && h->counts[used - 1] == 0) used--;
+  fwrite(&used, sizeof(used), 1, f);
+  fwrite(h->counts, sizeof(uint64_t), used, f);
+  fwrite(&h->total, sizeof(h->total), 1, f);
+  fwrite(&h->min, sizeof(h->min), 1, f);
+  fwrite(&h->max, sizeof(h->max), 1, f);
+  fwrite(&h->sum, sizeof(h->sum), 1, f);
+}
+
+bool loadHistogram(FILE *f, Histogram *h) {
+  int used;
+  initHistogram(h);
+  if (fread(&used, sizeof(used), 1, f) != 1 || used < 0 || used > HIST_BUCKETS) return false;
+  return fread(h->counts, sizeof(uint64_t), used, f) == (size_t)used &&
+    fread(&h->total, sizeof(h->total), 1, f) == 1 &&
+    fread(&h->min, sizeof(h->min), 1, f) == 1 &&
+    fread(&h->max, sizeof(h->max), 1, f) == 1 &&
+    fread(&h->sum, sizeof(h->sum), 1, f) == 1;
+}
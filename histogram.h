@@ -0,0 +1,31 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Log-bucketed histogram in the style of HdrHistogram. Values below
+   2^HIST_SUB_BITS get a bucket each, larger values share buckets whose
+   width doubles every power of two, so any value is off by at most
+   1/16 (about 6%). Recording is a count-leading-zeros and an increment */
+#define HIST_SUB_BITS 5
+#define HIST_HALF (1 << (HIST_SUB_BITS - 1))
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 2) * HIST_HALF)
+
+typedef struct histogram {
+  uint64_t counts[HIST_BUCKETS];
+  uint64_t total;
+  int64_t min;
+  int64_t max;
+  double sum;
+} Histogram;
+
+void initHistogram(Histogram *h);
+void recordValue(Histogram *h, int64_t value);
+int64_t valueAtPercentile(Histogram *h, double percentile);
+double histogramMean(Histogram *h);
+void saveHistogram(FILE *f, Histogram *h);
+bool loadHistogram(FILE *f, Histogram *h);
+
+#endif
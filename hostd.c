@@ -1,671 +1,735 @@
-#include "hostd.h"
-#include "queue.h"
-
-#define MAX_MEMORY 1024
-#define MAX_USER_MEMORY 960
-#define RESERVED_MEMORY 64
-#define PRINTERS 2
-#define SCANNERS 1
-#define MODEMS 1
-#define CDDRIVES 2
-#define MAX_PROCESSES 1000
-#define VERBOSE 1 // toggle this for detailed output
-#define SUPERVERBOSE  0 // even more detailed output!
-
-// global vars representing the 5 process queues, resources and time
-Queue *dispatchQ, *userQ, *realtimeQ, *p1Q, *p2Q, *p3Q; 
-int clock = 0; // represents global time of dispatcher
-int numJobs = 0; // total number of jobs from file
-volatile int availableMem = MAX_MEMORY; //mb available
-volatile int MemArray[1024]= {0};
-volatile int availableUserMem = MAX_USER_MEMORY;
-volatile int printers = PRINTERS;
-volatile int scanner = SCANNERS;
-volatile int modem = MODEMS;
-volatile int cddrives = CDDRIVES;
+#include "dispatcher.h"
+#include "procbackend.h"
+#include "taskbackend.h"
+#include "dispatchlist.h"
+#include "supervisor.h"
+#include "launcher.h"
+#include "log.h"
+#include "trace.h"
+#include "checkpoint.h"
+#include "control.h"
+#include "jobtable.h"
+
+#define PROCESS_PATH "./process" // program every job runs
+#define LOG_RING_SIZE 65536 // messages buffered for the logger thread
+
+Dispatcher dispatcher; // the scheduling core, everything below drives it
+DispatchReader dispatchList; // streams jobs in as their arrival time nears
+bool haveList = true; // a server may run without a dispatch list
 char *dispatchName = "DISPATCH QUEUE";
-char *userName = "USER PRIORITY JOB QUEUE";
-char *rtName =  "REALTIME PRIORITY JOB QUEUE";
-char *p1Name = "PRIORITY 1 QUEUE";
-char *p2Name = "PRIORITY 2 QUEUE";
-char *p3Name = "PRIORITY 3 QUEUE";
+char *checkpointPath = NULL; // where checkpoints go, none without --checkpoint
+int checkpointEvery = -1; // ticks between periodic checkpoints, -1 for only on SIGUSR2
+int nextCheckpoint = -1;
+char listPath[4096]; // the dispatch list, absolute so a restore can find it anywhere
+char *controlPath = NULL; // socket jobs are submitted on, none without --listen
+bool shuttingDown = false; // a client asked for an exit once the jobs are done
+
+/* The dispatcher's own part of a checkpoint: how the run was set up,
+   which a restore takes over in place of its own options, and how far
+   it had got. The queues, cpus and everything else follow it */
+typedef struct dispatcherState {
+	Machine machine;
+	FeedbackConfig feedback;
+	char policy[16];
+	AdmissionMode admission;
+	CompactConfig compaction;
+	FitPolicy fitPolicy;
+	int numCpus;
+	bool virtualTime;
+	char listPath[4096];
+	long listOffset; // where the dispatch list carries on
+	long listLine;
+	long jobsRead;
+	long malformed;
+	int clock;
+	int numJobs;
+	int jobsSubmitted;
+	int jobsCompleted;
+	pid_t nextVirtualPid;
+	int freeUnits[MAX_RESOURCES];
+	int arrivalEventTime;
+	int policyEventTime;
+	int compactEventTime;
+	int compactedAt;
+	int compactedLargest;
+	int nextCheckpoint;
+} DispatcherState;
+
+DispatcherState restored; // read by --restore before anything is set up
+FILE *restoreFile = NULL; // open between reading the settings and the rest
 
 //Function prototypes
-void createDispatchList(FILE *fd);
-void initQueues();
-void freeQueues();
-bool queuesAreNotEmpty();
-bool findMemSpaceReal(Queue *head);
-bool checkMemSpaceReal(Queue *head);
-int createProcess(Queue *q); 
-bool findMemSpaceUser(Queue *head);
-bool checkMemSpaceUser(Queue *head);
-void freeMemSpace(Queue *head);
-bool resourcesAvailable(Queue *head);
-void assignResources(Queue *head);
-bool userOrReal( Queue *head);
-bool checkUserOrReal( Queue *head);
-void printJobDetails( Queue *head);
+void loadArrivals();
+void printCpuReport();
+bool advanceClock();
+void writeCheckpoint();
+bool readCheckpointSettings(const char *path);
+bool restoreCheckpoint();
+int submitJobs(const JobRecord *jobs, int count, int *refused, const char **why);
+int controlStatus(char *reply, int cap);
+void shutdownServer();
+void printUsage(char *name);
+
+ControlHandlers controlHandlers = {submitJobs, controlStatus, shutdownServer};
 
 int main(int argc, char **argv) {
-	PCB *job; // pointer used to move jobs between queues
-	
-	int jobPriority;
-	int processStatus;
-	//open file of jobs
-	if(argc < 2) {
+	Dispatcher *d = &dispatcher;
+	LaunchMode launchMode = LAUNCH_FORK;
+	int poolSize = 4;
+	LogLevel level = LOG_INFO;
+	int compactAfterMillis = -1;
+	char *tracePath = NULL;
+	char *restorePath = NULL;
+	int checkpointMillis = -1;
+	bool pinJobs = false; // pin each child to the host core matching its cpu
+	int taskWorkers = 0; // run jobs as tasks on this many threads, 0 for processes
+	bool backMemory = false; // give job processes real pages from a memfd arena
+	defaultDispatcher(d);
+	d->virtualTime = false; // replay the schedule without forking or sleeping
+
+	// parse command line options
+	static struct option longOptions[] = {
+		{"fit", required_argument, NULL, 'f'},
+		{"virtual-time", no_argument, NULL, 't'},
+		{"cpus", required_argument, NULL, 'c'},
+		{"pin", no_argument, NULL, 'p'},
+		{"launcher", required_argument, NULL, 'l'},
+		{"pool-size", required_argument, NULL, 'P'},
+		{"stats", no_argument, NULL, 's'},
+		{"log-level", required_argument, NULL, 'L'},
+		{"trace", required_argument, NULL, 'T'},
+		{"quanta", required_argument, NULL, 'q'},
+		{"boost", required_argument, NULL, 'b'},
+		{"age", required_argument, NULL, 'a'},
+		{"sched", required_argument, NULL, 'S'},
+		{"admission", required_argument, NULL, 'A'},
+		{"machine", required_argument, NULL, 'M'},
+		{"memory", required_argument, NULL, 'm'},
+		{"reserved", required_argument, NULL, 'R'},
+		{"resources", required_argument, NULL, 'r'},
+		{"compact", required_argument, NULL, 'C'},
+		{"compact-after", required_argument, NULL, 'w'},
+		{"checkpoint", required_argument, NULL, 'k'},
+		{"checkpoint-every", required_argument, NULL, 'K'},
+		{"restore", required_argument, NULL, 'U'},
+		{"listen", required_argument, NULL, 'u'},
+		{"tasks", required_argument, NULL, 'j'},
+		{"memfd", no_argument, NULL, 'B'},
+		{NULL, 0, NULL, 0}
+	};
+	int opt;
+	while ((opt = getopt_long(argc, argv, "f:tc:pl:P:sL:T:q:b:a:S:A:M:m:R:r:C:w:k:K:U:u:j:B", longOptions, NULL)) != -1) {
+		switch (opt) {
+			case 'f':
+				if (!parseFitPolicy(optarg, &d->fitPolicy)) {
+					printf("Unknown fit policy %s (use first, best or next).\n", optarg);
+					return 0;
+				}
+				break;
+			case 't':
+				d->virtualTime = true;
+				break;
+			case 'c':
+				d->numCpus = atoi(optarg);
+				if (d->numCpus < 1) {
+					printf("Need at least one cpu.\n");
+					return 0;
+				}
+				break;
+			case 'p':
+				pinJobs = true;
+				break;
+			case 'l':
+				if (!parseLaunchMode(optarg, &launchMode)) {
+					printf("Unknown launcher %s (use fork, spawn or pool).\n", optarg);
+					return 0;
+				}
+				break;
+			case 'P':
+				poolSize = atoi(optarg);
+				break;
+			case 's':
+				d->collectStats = true;
+				break;
+			case 'L':
+				if (!parseLogLevel(optarg, &level)) {
+					printf("Unknown log level %s (use quiet, info or debug).\n", optarg);
+					return 0;
+				}
+				break;
+			case 'T':
+				tracePath = optarg;
+				break;
+			case 'q':
+				if (!parseQuanta(optarg, &d->feedback)) {
+					printf("Bad quanta %s (eg. 1s,500ms,250ms).\n", optarg);
+					return 0;
+				}
+				break;
+			case 'b':
+				if (!parseDuration(optarg, &d->feedback.boostEvery)) {
+					printf("Bad boost period %s (eg. 30s).\n", optarg);
+					return 0;
+				}
+				break;
+			case 'a':
+				if (!parseDuration(optarg, &d->feedback.ageAfter)) {
+					printf("Bad aging threshold %s (eg. 10s).\n", optarg);
+					return 0;
+				}
+				break;
+			case 'S':
+				d->policy = findSchedPolicy(optarg);
+				if (d->policy == NULL) {
+					printf("Unknown scheduler %s (use mlfq, fcfs, sjf, srtf or lottery).\n", optarg);
+					return 0;
+				}
+				break;
+			case 'A':
+				if (!parseAdmissionMode(optarg, &d->admission)) {
+					printf("Unknown admission mode %s (use off, reject or defer).\n", optarg);
+					return 0;
+				}
+				break;
+			case 'M':
+				if (!loadMachine(optarg, &d->machine)) {
+					printf("Could not load machine file %s.\n", optarg);
+					return 0;
+				}
+				break;
+			case 'm':
+				d->machine.memory = atoi(optarg);
+				break;
+			case 'R':
+				d->machine.reserved = atoi(optarg);
+				break;
+			case 'r':
+				if (!parseResources(optarg, &d->machine)) {
+					printf("Bad resource list %s (eg. printer=2,scanner=1, at most %d kinds).\n",
+						optarg, MAX_RESOURCES);
+					return 0;
+				}
+				break;
+			case 'C':
+				d->compaction.threshold = atof(optarg);
+				if (d->compaction.threshold < 0 || d->compaction.threshold > 1) {
+					printf("Compaction threshold must be a fragmentation between 0 and 1.\n");
+					return 0;
+				}
+				break;
+			case 'w':
+				if (!parseDuration(optarg, &compactAfterMillis)) {
+					printf("Bad compaction wait %s (eg. 10s).\n", optarg);
+					return 0;
+				}
+				break;
+			case 'k':
+				checkpointPath = optarg;
+				break;
+			case 'K':
+				if (!parseDuration(optarg, &checkpointMillis) || checkpointMillis == 0) {
+					printf("Bad checkpoint period %s (eg. 30s).\n", optarg);
+					return 0;
+				}
+				break;
+			case 'U':
+				restorePath = optarg;
+				break;
+			case 'u':
+				controlPath = optarg;
+				break;
+			case 'j':
+				taskWorkers = atoi(optarg);
+				if (taskWorkers < 1) {
+					printf("Tasks need at least one worker thread.\n");
+					return 0;
+				}
+				break;
+			case 'B':
+				backMemory = true;
+				break;
+			default:
+				printUsage(argv[0]);
+				return 0;
+		}
+	}
+
+	// a restored run is set up the way the checkpointed one was
+	if (restorePath != NULL && !readCheckpointSettings(restorePath)) {
+		printf("Could not restore checkpoint %s.\n", restorePath);
+		return 0;
+	}
+	if (checkpointMillis >= 0 && checkpointPath == NULL) {
+		printf("A checkpoint period needs a --checkpoint file.\n");
+		return 0;
+	}
+	if (taskWorkers > 0 && d->virtualTime) {
+		printf("Tasks only run in real time, virtual time simulates its jobs anyway.\n");
+		return 0;
+	}
+	if (backMemory && (d->virtualTime || taskWorkers > 0)) {
+		printf("Only job processes can be given real memory.\n");
+		return 0;
+	}
+	// a job process cannot follow its block to a new place, whether the
+	// compaction was asked for now or restored with the checkpoint
+	if (backMemory && (d->compaction.threshold >= 0 || d->compaction.after >= 0 || compactAfterMillis >= 0)) {
+		printf("Compaction cannot move memory that jobs have mapped.\n");
+		return 0;
+	}
+	// a new memfd would not be the one the adopted processes have mapped
+	if (backMemory && restorePath != NULL) {
+		printf("Restored jobs cannot be given real memory.\n");
+		return 0;
+	}
+	if (controlPath != NULL && d->virtualTime) {
+		printf("Jobs can only be submitted to a dispatcher running in real time.\n");
+		return 0;
+	}
+
+	if (!finishMachine(&d->machine)) {
+		printf("The machine needs memory left for user jobs once the reserved area is taken.\n");
+		return 0;
+	}
+
+	//open file of jobs, a restore carries on with the checkpointed one
+	char *listArg = (optind < argc) ? argv[optind] : NULL;
+	if (listArg == NULL && restorePath != NULL && restored.listPath[0] != '\0') {
+		listArg = restored.listPath;
+	}
+	// a server can start empty and take all of its jobs from the socket
+	haveList = listArg != NULL;
+	if(!haveList && controlPath == NULL) {
 		printf("Dispatch list not found!\n");
+		printUsage(argv[0]);
+		return 0;
+	}
+	if (checkpointPath != NULL && haveList && strcmp(listArg, "-") == 0) {
+		printf("Checkpoints need the dispatch list in a file, not on stdin.\n");
 		return 0;
 	}
 
-	FILE *fd;
-	fd = fopen(argv[1], "r");
-	
-	if(fd == NULL) {
-		printf("Could not open file %s.\n", argv[1]);
+	if(haveList && !openDispatchList(&dispatchList, listArg)) {
+		printf("Could not open file %s.\n", listArg);
 		return 0;
 	}
+	if (haveList && realpath(listArg, listPath) == NULL) snprintf(listPath, sizeof(listPath), "%s", listArg);
+	dispatchList.resources = d->machine.numResources; // one column per device
+	dispatchList.jobs = &d->jobs;
+
+	// every quantum, boost and aging period is a whole number of ticks
+	int tickMillis = feedbackTickMillis(&d->feedback);
+	setLogTick(tickMillis);
+	// the wait is rounded up to a whole tick rather than shortening the tick
+	if (compactAfterMillis >= 0) d->compaction.after = (compactAfterMillis + tickMillis - 1) / tickMillis;
+	if (checkpointMillis > 0) {
+		checkpointEvery = (checkpointMillis + tickMillis - 1) / tickMillis;
+		nextCheckpoint = checkpointEvery;
+	}
+	if (taskWorkers > 0) d->backend = &taskJobs;
+	else if (!d->virtualTime) d->backend = &processJobs;
+	initDispatcher(d);
+	if (d->backend == &processJobs) initProcessJobs(PROCESS_PATH, pinJobs);
+	// opened before any pool worker is spawned, so they all inherit it
+	if (backMemory && !openArena(&d->arena, d->machine.memory)) {
+		printf("Could not back %d mb of job memory with a memfd.\n", d->machine.memory);
+		return 0;
+	}
+	if (taskWorkers > 0 && !initTaskJobs(taskWorkers)) {
+		printf("Could not start %d task workers.\n", taskWorkers);
+		return 0;
+	}
+	if (tracePath != NULL && !initTrace(tracePath, d->tickMillis, &d->machine)) {
+		printf("Could not start tracing.\n");
+		return 0;
+	}
+	watchReportSignal();
+	if (!d->virtualTime && !initSupervisor(d->tickMillis)) {
+		printf("Could not set up child supervision.\n");
+		return 0;
+	}
+	// jobs that may be taken over by a restore have to survive us
+	if (checkpointPath != NULL) detachJobs(true);
+	if (d->backend == &processJobs && !initLauncher(launchMode, PROCESS_PATH, poolSize)) {
+		printf("Could not start the %s launcher.\n", launchModeName(launchMode));
+		return 0;
+	}
+	// a submission wakes the dispatcher up straight away, not at the next tick
+	if (controlPath != NULL &&
+	    (!openControl(controlPath, d->machine.numResources) || !watchWakeup(controlFd()))) {
+		printf("Could not listen for jobs on %s.\n", controlPath);
+		return 0;
+	}
+	// only real time has deadlines worth dropping messages for
+	if (!initLogger(stdout, level, LOG_RING_SIZE, d->virtualTime)) {
+		printf("Could not start the logger.\n");
+		return 0;
+	}
+	LOG(LOG_INFO, "Queues initialized successfully!\n");
+	if (restorePath != NULL) {
+		if (!restoreCheckpoint()) {
+			closeLogger();
+			printf("Could not restore checkpoint %s.\n", restorePath);
+			return 0;
+		}
+	} else {
+		loadArrivals();
+		if (haveList) {
+			LOG(LOG_INFO, "Streaming jobs from dispatch list %s!\n", LOG_STR(listArg));
+			// print out the first jobs of the dispatch list
+			if (logEnabled(LOG_INFO)) printQueue(dispatchName, d->dispatchQ);
+		}
+	}
+	if (controlPath != NULL) LOG(LOG_INFO, "Taking jobs on %s!\n", LOG_STR(controlPath));
 
-	initQueues(); 
-	printf("Queues initialized successfully!\n");
-	createDispatchList(fd);
-	printf("Read and stored all jobs in dispatch list!\n");
-	fclose(fd);
-	// print out initial dispatch list
-	if (VERBOSE) printQueue(dispatchName, dispatchQ);
+	struct timeval startTime, endTime;
+	gettimeofday(&startTime, NULL);
+	if (d->collectStats) initStats(&d->stats);
 
 	// START DISPATCHER
 	while(1) {
-		printf("\n-----------------------------------------\n");
-		printf("DISPATCHER TIME: %d SECONDS\n", clock);		
-		printf("-----------------------------------------\n");
-
-		if (SUPERVERBOSE) printf("DISPATCHER RESOURCE REPORT:\n");
-		if (SUPERVERBOSE) printf("Available Memory: %d\n", availableMem);
-		if (SUPERVERBOSE) printf("Printers: %d\n", printers);
-		if (SUPERVERBOSE) printf("Scanner: %d\n", scanner);
-		if (SUPERVERBOSE) printf("Modem: %d\n", modem);
-		if (SUPERVERBOSE) printf("CD Drives: %d\n", cddrives);
-
-		// move all jobs with this time from dispatch to the submission queues
-		// this happens on EVERY tick 
-		if (!isEmpty(dispatchQ)) {
-		    //assign all the jobs that are currently in the dispatch Queue 
-			while (dispatchQ->process->arrival_time <= clock) {
-			  //assign the jobs to the correct submission queue
-				jobPriority = dispatchQ->process->priority; 
-				if (jobPriority == 0) { // realtimeq priority = 0
-					if (VERBOSE) printf("A new realtime job has arrived.\n");
-					job = dequeueFront(&dispatchQ);
-					enqueueJob(realtimeQ, job);
-					if (SUPERVERBOSE) printQueue(rtName, realtimeQ);
-				} else if (jobPriority==1 || jobPriority==2 || jobPriority==3) {
-					if (VERBOSE) printf("A new user job has arrived.\n");
-					job = dequeueFront(&dispatchQ);
-					enqueueJob(userQ, job);
-					if (SUPERVERBOSE) printQueue(userName, userQ);
-				}
-				if (isEmpty(dispatchQ)) break;	
-			}
+		if (d->collectStats) startTick(&d->stats);
+		// move the jobs of the dispatch list that arrive by now into the
+		// dispatcher, then let it admit, distribute and dispatch
+		loadArrivals();
+		if (!dispatchPass(d)) {
+			closeLogger();
+			fprintf(stderr, "Dispatcher failed to start new process.");
+			return 0;
 		}
-		
-	    // distribute user jobs into their priority queues bases on resources
-	    // happens on EVERY TICK
-   	    if(isEmpty(userQ)==false){
-   	    	int userQlength = getLength(userQ);	
-		    int currJob = 0;
-		 
- 			// Go through entire queue only once
-		    while(currJob < userQlength){
-				
-		        //checking to make sure all the resources are avalable for the job
-		        if(resourcesAvailable(userQ)){
-		        	assignResources(userQ);
-		        	printf("Successfuly allocated resources to a new user job.\n");
-				    //gets the priority and the job off the userQ
-				    int userPriority;
-					userPriority = userQ->process->priority;
-					job = dequeueFront(&userQ);
-					if (SUPERVERBOSE) printf("User Priority: %d\n", userPriority);
-					//puts the job in the correct priority userQ
-					if(userPriority==1){
-						enqueueJob(p1Q, job);
-					}
-					if(userPriority==2){
-						enqueueJob(p2Q, job);
-					}
-					if(userPriority ==3){
-						enqueueJob(p3Q, job);
-					}
-
-		        // if resources arent avalable then job goes to the end of the queue  
-		        } else {
-		        	// safety check on if job requires too many resources
-				    if(userQ->process->mem_req > MAX_USER_MEMORY ||
-				       userQ->process->printers > PRINTERS ||
-				       userQ->process->scanners > SCANNERS ||
-				       userQ->process->modems > MODEMS ||
-				       userQ->process->cds > CDDRIVES) {
-				        // simply remove job
-				        job = dequeueFront(&userQ);
-					    free(job);
-					    userQlength--;
-				    }else {
-				    	// cycle job to back of queue
-				    	printf("A user job is waiting on resources...\n");
-				        job = dequeueFront(&userQ);
-					    enqueueJob(userQ, job);
-				    }
-		        }
-			   
-			    currJob++; 
-			    if (SUPERVERBOSE) printQueue(p1Name, p1Q);
-			    if (SUPERVERBOSE) printQueue(p2Name, p2Q);
-			    if (SUPERVERBOSE) printQueue(p3Name, p3Q);
-	        } // end while 
-	    } // end userQ distributions
-		
-		/* Now check all the queues for a job to run. */
-	    // Check the realtimeQ for a job first!
-		if(isEmpty(realtimeQ)==false){
-			
-			if(realtimeQ->process->pid < 0) {
-				// job hasnt started yet so fork and exec
-				realtimeQ->process->pid = fork();
-
-		 		if (realtimeQ->process->pid < 0) {
-		 			fprintf(stderr, "Dispatcher failed to fork new process.");
-					return 0;
-		 		}
-		 		else if(realtimeQ->process->pid == 0) {
-		 			printJobDetails(realtimeQ);
-		        	execl("./process", "process", "",NULL);
-		 		} else {
-		 			sleep(1);
-		 		}
-		 	}
-			else {
-				sleep(1); // RT processes never pause so just let it run
-		 	}	
-
-		    if (SUPERVERBOSE) printQueue(rtName, realtimeQ);
-		    realtimeQ->process->time_left--; //decrement time
-		    //check to see if it is zero 
-		    if (VERBOSE) printf("Time left in real time process: %d\n", realtimeQ->process->time_left);
-		    
-		    if(realtimeQ->process->time_left == 0){
-		    	kill(realtimeQ->process->pid, SIGINT); // kill the process
-			  	waitpid(realtimeQ->process->pid, &processStatus, WUNTRACED);
-		      	freeMemSpace(realtimeQ);
-		      	job = dequeueFront(&realtimeQ);
-		      	free(job);
-		    }
-		  
-
-
-		/* Now check lower priority Queues.
-		 The code for the lower priority queues will be very symmetrical */
-        } else if(isEmpty(p1Q)==false) {
-
-			if(p1Q->process->pid < 0) {
-				// job hasnt started yet so fork and exec
-				p1Q->process->pid = fork();
-
-		 		if (p1Q->process->pid < 0) {
-		 			fprintf(stderr, "Dispatcher failed to fork new process.");
-					return 0;
-		 		}
-		 		else if(p1Q->process->pid == 0) {
-		 			printJobDetails(p1Q);
-		        	execl("./process", "process", "",NULL);
-		 		} else {
-		 			sleep(1);
-		 		}
-		 	}
-			else {
-				// it was previously paused, so resume it
-		 		if (SUPERVERBOSE) printf("Attempting to resume process...\n");
-				kill(p1Q->process->pid, SIGCONT);
-				sleep(1); // let it run for 1 s
-		 	}	
-		 	
-		    if (SUPERVERBOSE) printQueue(p1Name, p1Q);
-			//decrement time
-		    p1Q->process->time_left--;
-			//check to see if it is zero 
-			if (VERBOSE) printf("Time left in p1Q process: %d\n", p1Q->process->time_left);
-
-		    if(p1Q->process->time_left == 0){
-		    	kill(p1Q->process->pid, SIGINT); // kill the process
-			  	waitpid(p1Q->process->pid, &processStatus, WUNTRACED);
-		        freeMemSpace(p1Q); // free its memory
-				
-		        // free all resources
-				printers += p1Q->process->printers;
-				scanner += p1Q->process->scanners;
-				modem += p1Q->process->modems;
-				cddrives += p1Q->process->cds;
-				// remove the PCB from the queue
-				job = dequeueFront(&p1Q);
-				free(job);
-       		}else { // pause it and decrease its priority
-       			kill(p1Q->process->pid, SIGTSTP);
-				waitpid(p1Q->process->pid, &processStatus, WUNTRACED);	
-			    job = dequeueFront(&p1Q);
-				enqueueJob(p2Q, job);	
-			}
-
-
-
-		//check second user priority queue
-		}else if(isEmpty(p2Q)==false){
-
-			if(p2Q->process->pid < 0) {
-				// job hasnt started yet so fork and exec
-				p2Q->process->pid = fork();
-
-		 		if (p2Q->process->pid < 0) {
-		 			fprintf(stderr, "Dispatcher failed to fork new process.");
-					return 0;
-		 		}
-		 		else if(p2Q->process->pid == 0) {
-		 			printJobDetails(p2Q);
-		        	execl("./process", "process", "",NULL);
-		 		} else {
-		 			sleep(1);
-		 		}
-		 	}
-			else {
-				// it was previously paused, so resume it
-		 		if (SUPERVERBOSE) printf("Attempting to resume process...\n");
-				kill(p2Q->process->pid, SIGCONT);
-				sleep(1); // let it run for 1 s
-		 	}	
-		 	
-		    if (SUPERVERBOSE) printQueue(p2Name, p2Q);
-			//decrement time
-		    p2Q->process->time_left--;
-			//check to see if it is zero 
-			if (VERBOSE) printf("Time left in p2Q process: %d\n", p2Q->process->time_left);
-
-		    if(p2Q->process->time_left == 0){
-		    	kill(p2Q->process->pid, SIGINT); // kill the process
-			  	waitpid(p2Q->process->pid, &processStatus, WUNTRACED);
-		        freeMemSpace(p2Q); // free its memory
-				
-		        // free all resources
-				printers += p2Q->process->printers;
-				scanner += p2Q->process->scanners;
-				modem += p2Q->process->modems;
-				cddrives += p2Q->process->cds;
-				// remove the PCB from the queue
-				job = dequeueFront(&p2Q);
-				free(job);
-       		}else { // pause it and decrease its priority
-       			kill(p2Q->process->pid, SIGTSTP);
-				waitpid(p2Q->process->pid, &processStatus, WUNTRACED);	
-			    job = dequeueFront(&p2Q);
-				enqueueJob(p3Q, job);	
-			}
-
-
-
-		//check third priority queue
-		}else if(isEmpty(p3Q)==false){
-
-			if(p3Q->process->pid < 0) {
-				// job hasnt started yet so fork and exec
-				p3Q->process->pid = fork();
-
-		 		if (p3Q->process->pid < 0) {
-		 			fprintf(stderr, "Dispatcher failed to fork new process.");
-					return 0;
-		 		}
-		 		else if(p3Q->process->pid == 0) {
-		 			printJobDetails(p3Q);
-		        	execl("./process", "process", "",NULL);
-		 		}
-		 		else {
-		 			sleep(1);
-		 		}
-		 	}
-			else {
-				// it was previously paused, so resume it
-		 		if (SUPERVERBOSE) printf("Attempting to resume process...\n");
-				kill(p3Q->process->pid, SIGCONT);
-				sleep(1); // let it run for 1 s
-		 	}
-		 		
-		 	
-		    if (SUPERVERBOSE) printQueue(p3Name, p3Q);
-			//decrement time
-		    p3Q->process->time_left--;
-			//check to see if it is zero 
-			if (VERBOSE) printf("Time left in p3Q process: %d\n", p3Q->process->time_left);
-
-		    if(p3Q->process->time_left == 0){
-		    	kill(p3Q->process->pid, SIGINT); // kill the process
-			  	waitpid(p3Q->process->pid, &processStatus, WUNTRACED);
-		        freeMemSpace(p3Q); // free its memory
-				
-		        // free all resources
-				printers += p3Q->process->printers;
-				scanner += p3Q->process->scanners;
-				modem += p3Q->process->modems;
-				cddrives += p3Q->process->cds;
-				// remove the PCB from the queue
-				job = dequeueFront(&p3Q);
-				free(job);
-       		} else { // pause it and cycle the queue b/c its now Round Robin
-       			kill(p3Q->process->pid, SIGTSTP);
-				waitpid(p3Q->process->pid, &processStatus, WUNTRACED);	
-			    job = dequeueFront(&p3Q);
-				enqueueJob(p3Q, job);	
-			}
-
-		} else {
-			sleep(1); // if nothing new happens, sleep anyway
-		} 
-		
-		// increment clock
-	    clock++;
-
-	    // exit the dispatcher only once all queues are empty
-		if(isEmpty(dispatchQ) && isEmpty(userQ) && isEmpty(realtimeQ) && 
-			isEmpty(p1Q) && isEmpty(p2Q) && isEmpty(p3Q)){
+
+		int passTime = d->clock;
+		if (!advanceClock()) {
+			LOG(LOG_QUIET, "No more events but jobs are still waiting. Stopping dispatcher...\n");
+			break;
+		}
+		// jobs were submitted before the tick, no time has passed to charge
+		if (!d->virtualTime && d->clock == passTime) continue;
+		chargeCpus(d);
+		// replace any pool workers used this tick while nothing is waiting on us
+		if (d->backend == &processJobs) topUpLauncher();
+		if (d->collectStats) sampleStats(d);
+		if (backMemory) sampleArena(&d->arena);
+		// kill -USR1 <hostd> prints the metrics so far
+		if (reportRequested()) {
+			flushLogger();
+			printJobMetrics(stdout, &d->jobMetrics, d->clock);
+		}
+
+	    // exit the dispatcher only once all queues are empty, a server
+	    // only once it has also been told to shut down
+		if (dispatcherIdle(d) && (controlPath == NULL || shuttingDown)) {
 		  break;
 		}
+
+		// kill -USR2 <hostd> checkpoints right away
+		bool requested = checkpointRequested();
+		if (requested && checkpointPath == NULL) {
+			LOG(LOG_QUIET, "Checkpoint requested but no --checkpoint file was given.\n");
+		} else if (requested || (checkpointEvery > 0 && d->clock >= nextCheckpoint)) {
+			writeCheckpoint();
+		}
 	}
 
-	printf("All jobs ran to completion. Terminating dispatcher...\n");
+	gettimeofday(&endTime, NULL);
+	if (d->collectStats) finishStats(&d->stats);
+	LOG(LOG_INFO, "All jobs ran to completion. Terminating dispatcher...\n");
+	closeLogger(); // everything below goes straight to stdout
+	TaskStats taskStats;
+	if (d->backend == &taskJobs) closeTaskJobs(&taskStats);
+	if (!d->virtualTime) {
+		if (controlPath != NULL) closeControl();
+		if (d->backend == &processJobs) closeLauncher();
+		reapChildren(d->backend == &processJobs ? handleChildEvent : NULL, d);
+		closeSupervisor();
+	}
+	if (d->virtualTime) {
+		long elapsed = (endTime.tv_sec - startTime.tv_sec) * 1000000L +
+			(endTime.tv_usec - startTime.tv_usec);
+		printf("Replayed %.*f simulated seconds in %.3f ms.\n", d->ticksPerSecond > 1 ? 3 : 0,
+			(double)d->clock / d->ticksPerSecond, elapsed / 1000.0);
+	}
+	if (haveList) {
+		printf("Read %d jobs from the dispatch list (%ld malformed lines skipped).\n",
+			d->numJobs - d->jobsSubmitted, dispatchList.malformed);
+	}
+	if (controlPath != NULL) printf("Took %d jobs from %s.\n", d->jobsSubmitted, controlPath);
+	if (logEnabled(LOG_INFO)) printMemReport("USER", &d->memMap, userMemory(&d->machine));
+	if (logEnabled(LOG_INFO)) printCpuReport();
+	if (d->backend == &taskJobs) printTaskReport(stdout, &taskStats);
+	if (backMemory) printArenaReport(stdout, &d->arena);
+	printJobMetrics(stdout, &d->jobMetrics, d->clock);
+	if (d->compacting) printCompactReport(stdout, &d->compactStats, d->tickMillis);
+	if (tracePath != NULL) {
+		if (writeTrace(d->numCpus)) printf("Schedule trace written to %s.\n", tracePath);
+		else printf("Could not write the schedule trace to %s.\n", tracePath);
+	}
+	// stats go to stderr so they survive sending the schedule to /dev/null
+	if (d->collectStats) printStats(stderr, &d->stats, d->jobsCompleted, d->clock / d->ticksPerSecond);
 	// free all allocated mem before exiting
-	freeQueues();
+	freeDispatcher(d);
+	if (haveList) closeDispatchList(&dispatchList);
+	if (d->backend == &processJobs) closeProcessJobs();
 	return 0;
 }
 
-
-/* Builds the list of jobs by parsing the input file.
-Jobs are already sorted by ascending start time 
-file contains 8 pieces of job info: Arrival time, priority, cpu time,
-memory, printers, scanners, modems, CDs*/
-void createDispatchList(FILE *fd) {
-	char linebuf[100];
-	char *processInfo;
-	// read the file line by line
-	while (fgets(linebuf, 100, fd) != NULL) {
-		// create a struct for this job and insert it into the dispatch list
-		PCB *newJob = malloc(sizeof(PCB));
-		assert(newJob != NULL);
-
-		newJob->pid = -1; //process is not 'live' yet
-		// break the line up by the , delims and store job info 
-		processInfo = strtok(linebuf, ",");
-		newJob->arrival_time = atoi(processInfo); 
-		processInfo = strtok(NULL, ",");
-		newJob->priority = atoi(processInfo); 
-		processInfo = strtok(NULL, ",");
-		newJob->cpu_time = atoi(processInfo); 
-		newJob->time_left = atoi(processInfo); 
-		processInfo = strtok(NULL, ",");
-		newJob->mem_req = atoi(processInfo); 
-		processInfo = strtok(NULL, ",");
-		newJob->printers = atoi(processInfo); 
-		processInfo = strtok(NULL, ",");
-		newJob->scanners = atoi(processInfo); 
-		processInfo = strtok(NULL, ",");
-		newJob->modems= atoi(processInfo); 
-		processInfo = strtok(NULL, ",");
-		newJob->cds = atoi(processInfo); 
-		numJobs ++;
-
-		// add job to the dispatch list
-		enqueueJob(dispatchQ, newJob);
-		if (numJobs == MAX_PROCESSES) break; // safety check on job num
+/* Advances the clock. In real time this waits for the tick timer while
+   handling child events, and answers the control socket once it either
+   ticks or has a request. In virtual time it jumps straight to the next
+   pending event. Returns false if virtual time has nothing left to wait for */
+bool advanceClock() {
+	Dispatcher *d = &dispatcher;
+	if (!d->virtualTime) {
+		d->clock += waitForTick(handleChildEvent, d);
+		if (d->backend == &taskJobs) reapTasks(d);
+		if (controlPath != NULL) serveControl(&controlHandlers);
+		return true;
 	}
-}
 
-/* Creates a new process */
-int createProcess(Queue *q) {
-
-	q->process->pid = fork();
-	if (q->process->pid < 0) {
-		return 0;
-	}
-	else if(q->process->pid == 0) {
-		printf("\nA new process was started with parameters:\n");
-		printf("PID: %d\n", (int)getpid());
-		printf("Priority: %d\n", q->process->priority);
-		printf("CPU time remaining: %d\n", q->process->time_left);
-		printf("Memory location: 0x%d\n", q->process->mem_start);
-		printf("Block size: %dMb\n", q->process->mem_req);
-		printf("Resources requested (printer, scanner, modem, cd): (%d,%d,%d,%d)\n\n", 
-		q->process->printers,q->process->scanners,q->process->modems, q->process->cds);
-		
-		execl("./process", "process", "",NULL);
-	}	
-	return 1;
+	int next = nextEventTime(d);
+	if (next < 0) return false;
+	d->clock = next;
+	return true;
 }
 
-/* checks to see if there are enough resources to run a process */
-bool resourcesAvailable(Queue *q) {
-	
-	return( checkUserOrReal(q) &&
-	   	   q->process->printers <= printers &&
-		   q->process->scanners <= scanner &&
-		   q->process->modems <= modem &&
-		   q->process->cds <= cddrives);
+/* Prints how busy each cpu was and the overall throughput */
+void printCpuReport() {
+	Dispatcher *d = &dispatcher;
+	int i, totalBusy = 0;
+	int prec = d->ticksPerSecond > 1 ? 3 : 0; // sub-second ticks get decimals
+	double seconds = (double)d->clock / d->ticksPerSecond;
+	printf("\nCPU REPORT =======================================\n");
+	printf("CPU  BUSY(s)  UTILIZATION\n");
+	for (i = 0; i < d->numCpus; i++) {
+		totalBusy += d->cpus[i].busyTime;
+		printf("%-4d %-8.*f %.1f%%\n", i, prec, (double)d->cpus[i].busyTime / d->ticksPerSecond,
+			d->clock > 0 ? 100.0 * d->cpus[i].busyTime / d->clock : 0.0);
+	}
+	printf("Overall utilization: %.1f%%\n",
+		d->clock > 0 ? 100.0 * totalBusy / ((double)d->clock * d->numCpus) : 0.0);
+	printf("Throughput: %d jobs in %.*f seconds (%.3f jobs/s)\n", d->jobsCompleted, prec, seconds,
+		d->clock > 0 ? d->jobsCompleted / seconds : 0.0);
+	printf("==================================================\n\n");
 }
 
-/* assign resources and memory to a process */
-void assignResources(Queue *q) {
-    // assign by subtracting from the global amounts
-    // perform memory allocation here
-    userOrReal(q);
-    printers -= q->process->printers;
-	scanner -= q->process->scanners;
-	modem -= q->process->modems;
-	cddrives -= q->process->cds;
-
-	if (SUPERVERBOSE) printf("Memory block used: %d - %d\n", q->process->mem_start,(q->process->mem_start+q->process->mem_req));
-	if (SUPERVERBOSE) printf("Available printers: %d\n", printers);
-	if (SUPERVERBOSE) printf("Available scanners: %d\n", scanner);
-	if (SUPERVERBOSE) printf("Available modems: %d\n", modem);
-	if (SUPERVERBOSE) printf("Available cd drives: %d\n\n", cddrives);
+/* Pulls jobs from the dispatch list until every job that has arrived
+is queued plus the next one still to come. Jobs are sorted by ascending
+start time so nothing further down the file is needed yet */
+void loadArrivals() {
+	Dispatcher *d = &dispatcher;
+	if (!haveList) return;
+	while (isEmpty(d->dispatchQ) || lastJob(d->dispatchQ)->arrival_time <= d->clock) {
+		PCB *newJob = readNextJob(&dispatchList);
+		if (newJob == NULL) break; // end of the list
+		addJob(d, newJob);
+	}
 }
 
-/* initialize memory for queues */
-void initQueues() {
-	dispatchQ = initQueue();
-  	realtimeQ = initQueue();
-  	userQ = initQueue();
- 	 p3Q = initQueue();
- 	 p2Q = initQueue();
- 	 p1Q = initQueue();
-}
+/* Writes every queue, the cpus, the memory map, the free devices, the
+   clock and the metrics so far to the checkpoint file. It runs between
+   ticks, when every job is in exactly one place */
+void writeCheckpoint() {
+	Dispatcher *d = &dispatcher;
+	double t = statsNow();
+	if (checkpointEvery > 0) nextCheckpoint = (d->clock / checkpointEvery + 1) * checkpointEvery;
+
+	DispatcherState st;
+	memset(&st, 0, sizeof(st));
+	st.machine = d->machine;
+	st.feedback = d->feedback;
+	snprintf(st.policy, sizeof(st.policy), "%s", d->policy->name);
+	st.admission = d->admission;
+	st.compaction = d->compaction;
+	st.fitPolicy = d->memMap.policy;
+	st.numCpus = d->numCpus;
+	st.virtualTime = d->virtualTime;
+	memcpy(st.listPath, listPath, sizeof(st.listPath));
+	st.listOffset = haveList ? dispatchListOffset(&dispatchList) : 0;
+	st.listLine = dispatchList.line;
+	st.jobsRead = dispatchList.jobsRead;
+	st.malformed = dispatchList.malformed;
+	st.clock = d->clock;
+	st.numJobs = d->numJobs;
+	st.jobsSubmitted = d->jobsSubmitted;
+	st.jobsCompleted = d->jobsCompleted;
+	st.nextVirtualPid = d->nextVirtualPid;
+	memcpy(st.freeUnits, d->freeUnits, sizeof(st.freeUnits));
+	st.arrivalEventTime = d->arrivalEventTime;
+	st.policyEventTime = d->policyEventTime;
+	st.compactEventTime = d->compactEventTime;
+	st.compactedAt = d->compactedAt;
+	st.compactedLargest = d->compactedLargest;
+	st.nextCheckpoint = nextCheckpoint;
+
+	FILE *f = beginCheckpoint(checkpointPath, sizeof(st));
+	if (f == NULL) {
+		LOG(LOG_QUIET, "Could not write checkpoint %s.\n", LOG_STR(checkpointPath));
+		return;
+	}
+	SAVE(f, st);
+	saveDispatcher(d, f);
 
-/* free queue memory after dispatcher quits*/
-void freeQueues() {
-	deleteQueue(dispatchQ);
-  	deleteQueue(realtimeQ);
- 	deleteQueue(userQ);
- 	deleteQueue(p1Q);
-	deleteQueue(p2Q);
- 	deleteQueue(p3Q);
+	long bytes;
+	if (!endCheckpoint(f, checkpointPath, &bytes)) {
+		LOG(LOG_QUIET, "Could not write checkpoint %s.\n", LOG_STR(checkpointPath));
+		return;
+	}
+	LOG(LOG_INFO, "Checkpoint at %t seconds written to %s (%d bytes in %d us).\n", d->clock,
+		LOG_STR(checkpointPath), (int)bytes, (int)(statsNow() - t));
 }
 
-/* Prints out jobs details */
-void printJobDetails( Queue *q) {
-	printf("\nA new process was started with parameters:\n");
-	printf("PID: %d\n", (int)getpid());
-	printf("Priority: %d\n", q->process->priority);
-	printf("CPU time remaining: %d\n", q->process->time_left);
-	printf("Memory location: 0x%d\n", q->process->mem_start);
-	printf("Block size: %dMb\n", q->process->mem_req);
-	printf("Resources requested (printer, scanner, modem, cd): (%d,%d,%d,%d)\n\n", 
-	q->process->printers,q->process->scanners,q->process->modems, q->process->cds);
+/* Opens a checkpoint and takes over the machine, cpus, scheduling
+   policy and other settings of the run that wrote it, before anything
+   is set up from them. The rest is read by restoreCheckpoint */
+bool readCheckpointSettings(const char *path) {
+	Dispatcher *d = &dispatcher;
+	restoreFile = openCheckpoint(path, sizeof(DispatcherState));
+	if (restoreFile == NULL) return false;
+	if (!LOAD(restoreFile, restored) || findSchedPolicy(restored.policy) == NULL) {
+		fclose(restoreFile);
+		return false;
+	}
+	restored.listPath[sizeof(restored.listPath) - 1] = '\0';
+	d->machine = restored.machine;
+	d->feedback = restored.feedback;
+	d->policy = findSchedPolicy(restored.policy);
+	d->admission = restored.admission;
+	d->compaction = restored.compaction;
+	d->fitPolicy = restored.fitPolicy;
+	d->numCpus = restored.numCpus;
+	d->virtualTime = restored.virtualTime;
+	return true;
 }
 
-bool findMemSpaceReal(Queue *head){
-  //real time memory allocation
-	int i =0;
-   bool avalable= false;
-  int mem = head->process->mem_req;
-  int slot;
-  int count;
-    for(slot=0;slot <  MAX_MEMORY; slot++ ){
-            if(MemArray[slot]==0){
-                   for(count =0; count < mem; count++){
-		        if((MemArray[slot+count]==1)||(slot+count >= MAX_MEMORY)){
-	 	               break;
-		         }
-			if(count == (mem-1)){
-	                       head->process->mem_start = slot;
-			       avalable = true;
-			       break;
-			}
-		   }
-            }
-	    if(avalable == true){
-	      break;
-	    }
-    }
-    for(i=0; i < mem; i++){
-      MemArray[slot+i]=1;
-    }
-    return avalable;
+/* Reads the queues, cpus, memory map and metrics of a checkpoint into
+   the freshly set up dispatcher, carries on the dispatch list where it
+   was left and takes over the processes of jobs that had started */
+bool restoreCheckpoint() {
+	Dispatcher *d = &dispatcher;
+	double t = statsNow();
+	FILE *f = restoreFile;
+	bool ok = loadDispatcher(d, f);
+	fclose(f);
+	restoreFile = NULL;
+	if (!ok || (haveList && !seekDispatchList(&dispatchList, restored.listOffset))) return false;
+
+	dispatchList.line = restored.listLine;
+	dispatchList.jobsRead = restored.jobsRead;
+	dispatchList.malformed = restored.malformed;
+	d->clock = restored.clock;
+	d->numJobs = restored.numJobs;
+	d->jobsSubmitted = restored.jobsSubmitted;
+	d->jobsCompleted = restored.jobsCompleted;
+	d->nextVirtualPid = restored.nextVirtualPid;
+	memcpy(d->freeUnits, restored.freeUnits, sizeof(d->freeUnits));
+	d->arrivalEventTime = restored.arrivalEventTime;
+	d->policyEventTime = restored.policyEventTime;
+	d->compactEventTime = restored.compactEventTime;
+	d->compactedAt = restored.compactedAt;
+	d->compactedLargest = restored.compactedLargest;
+	if (checkpointEvery > 0) nextCheckpoint = (d->clock / checkpointEvery + 1) * checkpointEvery;
+
+	// nothing has been read from the list yet, every job is a restored one
+	PCB **jobs;
+	int count = tableJobs(&d->jobs, &jobs), adopted = 0;
+	if (d->backend == &processJobs) adopted = adoptJobs(d, jobs, count);
+	else if (d->backend == &taskJobs) adopted = restartTasks(d, jobs, count);
+	free(jobs);
+	LOG(LOG_INFO, "Restored checkpoint of %t seconds: %d jobs in flight, %d processes taken over, in %d us.\n",
+		d->clock, count, adopted, (int)(statsNow() - t));
+	return true;
 }
-  
-bool checkMemSpaceReal(Queue *head){
- //real time memory allocation
-
-   bool avalable= false;
-  int mem = head->process->mem_req;
-  int slot;
-  int count;
-    for(slot=0;slot <  MAX_MEMORY; slot++ ){
-            if(MemArray[slot]==0){
-                   for(count =0; count < mem; count++){
-		        if((MemArray[slot+count]==1)||(slot+count >= MAX_MEMORY)){
-	 	               break;
-		         }
-			if(count == (mem-1)){
-	                       head->process->mem_start = slot;
-			       avalable = true;
-			       break;
-			}
-		   }
-            }
-	    if(avalable == true){
-	      break;
-	    }
-    }
-    
-    return avalable;
-}
-
 
+/* Takes a batch of jobs from the control socket. Arrival times count
+   from now, so the jobs join the arrival path in order with the list.
+   A batch holding a job that could never be placed is refused whole.
+   Returns the id of the first job, or -1 */
+int submitJobs(const JobRecord *jobs, int count, int *refused, const char **why) {
+	Dispatcher *d = &dispatcher;
+	int i;
+	if (shuttingDown) {
+		*why = "the dispatcher is shutting down";
+		return -1;
+	}
+	for (i = 0; i < count; i++) {
+		const JobRecord *rec = &jobs[i];
+		int memLimit = (rec->priority == 0) ? d->machine.memory : userMemory(&d->machine);
+		if (rec->priority > 3) *why = "priority must be 0 to 3";
+		else if (rec->mem_req > memLimit || !unitsFit(rec->resources, d->machine.units)) {
+			*why = "needs more than the machine has";
+		} else continue;
+		*refused = i;
+		return -1;
+	}
 
-
-bool findMemSpaceUser(Queue *head){
-  //user memory allocation
-  //look in the array and try to find a space
-  //head->process->mem_req
-  //head->process->mem-start
-  // if space is found mark it as used
-  int i = 0;
-  bool avalable= false;
-  int mem = head->process->mem_req;
-  int slot;
-  int count;
-    for(slot=0;slot <  MAX_USER_MEMORY; slot++ ){
-            if(MemArray[slot]==0){
-                   for(count =0; count < mem; count++){
-		        if((MemArray[slot+count]==1)||(slot+count >= MAX_USER_MEMORY)){
-	 	               break;
-		         }
-			if(count == (mem-1)){
-	                       head->process->mem_start = slot;
-			       avalable = true;
-			       break;
-			}
-		   }
-            }
-	    if(avalable == true){
-	      break;
-	    }
-    }
-    for(i=0; i < mem; i++){
-      MemArray[slot+i]=1;
-    }
-    return avalable;
-}
-
-bool checkMemSpaceUser(Queue *head){
-  //user memory allocation
-  //look in the array and try to find a space
-  //head->process->mem_req
-  //head->process->mem-start
-  // if space is found mark it as used
-
-  bool avalable= false;
-  int mem = head->process->mem_req;
-  int slot;
-  int count;
-    for(slot=0;slot <  MAX_USER_MEMORY; slot++ ){
-            if(MemArray[slot]==0){
-                   for(count =0; count < mem; count++){
-		        if((MemArray[slot+count]==1)||(slot+count >= MAX_USER_MEMORY)){
-	 	               break;
-		         }
-			if(count == (mem-1)){
-	                       head->process->mem_start = slot;
-			       avalable = true;
-			       break;
-			}
-		   }
-            }
-	    if(avalable == true){
-	      break;
-	    }
-    }
-   
-    return avalable;
+	int first = d->numJobs + 1;
+	for (i = 0; i < count; i++) submitJob(d, newJobFromRecord(&d->jobs, &jobs[i]));
+	LOG(LOG_INFO, "%d jobs were submitted.\n", count);
+	return first;
 }
 
-void freeMemSpace(Queue *head){
-  //find the space that was allocated to that process and free it.
- //head->process->mem_req
-  int i = head->process->mem_start;
-  int j;
-  for(j=0 ; j < head->process->mem_req; j++){
-       MemArray[i+j] = 0;
-  }
-  //head->process->mem-start
-
+/* Writes the queues, cpus and free resources for a status request */
+int controlStatus(char *reply, int cap) {
+	Dispatcher *d = &dispatcher;
+	int busy = 0, i, r, n;
+	for (i = 0; i < d->numCpus; i++) busy += d->cpus[i].job != NULL;
+	n = snprintf(reply, cap,
+		"time %.3f\n" "jobs %d\n" "completed %d\n" "arriving %d\n" "realtime %d\n"
+		"deferred %d\n" "waiting %d\n" "p1 %d\n" "p2 %d\n" "p3 %d\n" "cpus %d %d\n"
+		"memory %d %d %d\n" "devices %d\n",
+		(double)d->clock / d->ticksPerSecond, d->numJobs, d->jobsCompleted,
+		getLength(d->dispatchQ) + getLength(d->submitQ) + getLength(d->userQ),
+		edfLength(&d->realtimeQ), getLength(d->deferredQ), waitingJobs(&d->waitList),
+		d->policy->waiting(d->sched, 1), d->policy->waiting(d->sched, 2),
+		d->policy->waiting(d->sched, 3), busy, d->numCpus,
+		d->machine.memory - d->memMap.used, largestFreeBlock(&d->memMap, userMemory(&d->machine)),
+		d->machine.memory, d->machine.numResources);
+	for (r = 0; r < d->machine.numResources && n < cap; r++) {
+		n += snprintf(reply + n, cap - n, "%s %d %d\n", d->machine.names[r], d->freeUnits[r],
+			d->machine.units[r]);
+	}
+	if (n < cap && shuttingDown) n += snprintf(reply + n, cap - n, "shutting-down\n");
+	return n < cap ? n : cap;
 }
 
-
-bool userOrReal( Queue *head){
-  bool good;
-  int priority;
-  priority = head->process->priority;
-  if(priority == 0){
-   good=  findMemSpaceReal(head);
-  }else{
-  good =  findMemSpaceUser(head);
-  }
-  return good; 
+/* Stops taking jobs. The dispatcher exits once the ones it has are done */
+void shutdownServer() {
+	if (!shuttingDown) LOG(LOG_INFO, "Shutdown requested, finishing the jobs already submitted.\n");
+	shuttingDown = true;
 }
 
-
-bool checkUserOrReal( Queue *head){
-  bool good;
-  int priority;
-  priority = head->process->priority;
-  if(priority == 0){
-   good=  checkMemSpaceReal(head);
-  }else{
-  good =  checkMemSpaceUser(head);
-  }
-  return good; 
+/* Prints the command line options */
+void printUsage(char *name) {
+	printf("Usage: %s [options] <dispatch list>\n", name);
+	printf("       %s [options] --listen <socket> [dispatch list]\n", name);
+	printf("  -f, --fit <first|best|next>  memory placement policy (default first)\n");
+	printf("  -t, --virtual-time           simulate without forking or sleeping\n");
+	printf("  -c, --cpus <n>               number of simulated cpus (default 1)\n");
+	printf("  -p, --pin                    pin each job to the host core of its cpu\n");
+	printf("  -l, --launcher <fork|spawn|pool>  how job processes are started (default fork)\n");
+	printf("  -P, --pool-size <n>          parked workers kept by the pool launcher (default 4)\n");
+	printf("  -j, --tasks <n>              run jobs as tasks on n threads instead of processes\n");
+	printf("  -B, --memfd                  back job memory with a memfd that each job maps its block of,\n"
+	       "                               not with compaction or --restore\n");
+	printf("  -s, --stats                  print dispatcher cpu, queue and allocator stats to stderr\n");
+	printf("  -L, --log-level <quiet|info|debug>  how much the dispatcher logs (default info)\n");
+	printf("  -T, --trace <file>           write the schedule as Chrome trace-event JSON\n");
+	printf("  -q, --quanta <p1,p2,p3>      cpu time per visit to each user level, eg. 1s,500ms,250ms (default 1s)\n");
+	printf("  -b, --boost <time>           move every user job back to p1Q this often (default never)\n");
+	printf("  -a, --age <time>             move a job up a level after waiting this long in p2Q or p3Q (default never)\n");
+	printf("  -S, --sched <mlfq|fcfs|sjf|srtf|lottery>  how user jobs share the cpus (default mlfq)\n");
+	printf("  -A, --admission <off|reject|defer>  what to do with realtime jobs that would miss their deadline (default off)\n");
+	printf("  -M, --machine <file>         read memory size and devices from a machine file\n");
+	printf("  -m, --memory <mb>            total memory (default 1024)\n");
+	printf("  -R, --reserved <mb>          memory at the top kept for realtime jobs (default 64)\n");
+	printf("  -r, --resources <name=n,...>  kinds of device and units of each, in dispatch list column order\n"
+	       "                               (default printer=2,scanner=1,modem=1,cd=2)\n");
+	printf("  -C, --compact <fraction>     compact user memory once fragmentation reaches this and holes keep a job out\n");
+	printf("  -w, --compact-after <time>   compact once a job kept out only by holes has waited this long\n");
+	printf("  -k, --checkpoint <file>      write a snapshot of the dispatcher here on SIGUSR2\n");
+	printf("  -K, --checkpoint-every <time>  and this often\n");
+	printf("  -U, --restore <file>         carry on from a snapshot, taking over its jobs' processes;\n"
+	       "                               its settings replace the scheduling options and the list is optional\n");
+	printf("  -u, --listen <socket>        take jobs from hostd-submit on this unix socket as well, and keep\n"
+	       "                               running until a client asks for a shutdown\n");
 }
@@ -1,15 +1,36 @@
+#ifndef HOSTD_H
+#define HOSTD_H
+
+#define _GNU_SOURCE // sched_setaffinity
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <getopt.h>
 #include <signal.h>
 #include <sys/wait.h>
+#include <sys/time.h>
+#include <sched.h>
 #include <sys/types.h>
 
+#define MAX_RESOURCES 8 // kinds of device a machine can have
+
+/* Where a job's process is in its life, as far as the dispatcher knows */
+typedef enum {
+	JOB_NEW,            // no process started yet
+	JOB_RUNNING,
+	JOB_STOPPING,       // SIGTSTP sent, stop not confirmed yet
+	JOB_RESUME_PENDING, // resumed before the stop was confirmed
+	JOB_STOPPED,
+	JOB_EXITED
+} JobState;
+
 /* Universal struct that represents a job/process */
 typedef struct Process {
+	int id;            // position in the dispatch list, starting at 1
+	int slot;          // where it is in the job table, given out again on a restore
 	pid_t pid;
 	int arrival_time;
 	int priority;
@@ -17,14 +38,39 @@ typedef struct Process {
 	int time_left;
 	int mem_req;
     int mem_start;
-	int printers;
-	int scanners;
-	int modems;
-	int cds;
+	int resources[MAX_RESOURCES]; // units of each kind of device, in machine order
+	JobState state;
+	int level_used;    // cpu time used since it entered its current feedback level
+	int deadline;      // time it must finish by, -1 for none
+	// timestamps and waits in dispatcher ticks, used for job metrics
+	int first_run;     // first time on a cpu, -1 until then
+	int completion;    // time it finished, -1 until then
+	int queued_at;     // when it entered the queue it is waiting in
+	int user_wait;     // time spent in userQ waiting for resources
+	int level_wait[4]; // time spent in the realtime, p1, p2 and p3 queues
 } PCB;
 
+/* A simulated processor and the job it is running */
+typedef struct cpuSlot {
+   PCB *job;      // NULL when idle
+   int level;     // 0 = realtime, 1-3 = feedback queue the job came from
+   int lastTick;  // clock value the job was last charged at
+   int sliceEnd;  // clock value at which the job gives up the cpu
+   int runStart;  // clock value the job was put on the cpu
+   int busyTime;  // ticks spent running jobs
+} Cpu;
+
+/* Queue handle. Jobs are chained through the job table's next array
+   by slot, so a job is in at most one queue at a time and queueing it
+   allocates nothing. Tracking both ends makes enqueue, dequeue and
+   length O(1). process always points at the job at the front (NULL
+   when empty) */
 typedef struct processQueue {
+   struct jobTable *jobs; // the table its slots are in
    PCB *process;
-   struct processQueue* next;
+   int head;   // slots, JOB_NO_SLOT when empty
+   int tail;
+   int length;
 } Queue;
 
+#endif
@@ -0,0 +1,128 @@
+#include "jobtable.h"
+
+/* An empty table. Listings show the four devices of the standard
+   machine until the dispatcher sets its own */
+void initJobTable(JobTable *t) {
+  memset(t, 0, sizeof(*t));
+  t->freeSlot = JOB_NO_SLOT;
+  t->numResources = 4;
+  t->initials = "P,S,M,C";
+}
+
+static int* growArray(int *a, int capacity) {
+  a = realloc(a, capacity * sizeof(int));
+  assert(a != NULL);
+  return a;
+}
+
+/* Adds a chunk of PCBs and grows every array to cover it */
+static void growTable(JobTable *t) {
+  t->chunks = realloc(t->chunks, (t->numChunks + 1) * sizeof(PCB *));
+  assert(t->chunks != NULL);
+  t->chunks[t->numChunks] = malloc(JOB_CHUNK * sizeof(PCB));
+  assert(t->chunks[t->numChunks] != NULL);
+  t->numChunks++;
+
+  int first = t->capacity;
+  t->capacity += JOB_CHUNK;
+  t->id = growArray(t->id, t->capacity);
+  t->priority = growArray(t->priority, t->capacity);
+  t->memReq = growArray(t->memReq, t->capacity);
+  t->timeLeft = growArray(t->timeLeft, t->capacity);
+  t->next = growArray(t->next, t->capacity);
+  int r, slot;
+  for (r = 0; r < MAX_RESOURCES; r++) t->units[r] = growArray(t->units[r], t->capacity);
+
+  // the new slots go on the free chain lowest first
+  for (slot = first; slot < t->capacity - 1; slot++) t->next[slot] = slot + 1;
+  t->next[t->capacity - 1] = t->freeSlot;
+  t->freeSlot = first;
+}
+
+/* Hands out an unused PCB, in no queue and with only its slot set */
+PCB* newJob(JobTable *t) {
+  if (t->freeSlot == JOB_NO_SLOT) growTable(t);
+  int slot = t->freeSlot;
+  t->freeSlot = t->next[slot];
+  t->next[slot] = JOB_UNLINKED;
+  PCB *job = jobAt(t, slot);
+  job->slot = slot;
+  return job;
+}
+
+/* Gives a job's slot back. The most recently freed slot is the next
+   one handed out, so it is likely still in cache */
+void freeJob(JobTable *t, PCB *job) {
+  assert(t->next[job->slot] == JOB_UNLINKED); // still queued somewhere
+  t->next[job->slot] = t->freeSlot;
+  t->freeSlot = job->slot;
+}
+
+/* Copies the fields kept in the arrays out of the PCB. Called once its
+   fields are filled in */
+void syncJob(JobTable *t, PCB *job) {
+  int slot = job->slot, r;
+  t->id[slot] = job->id;
+  t->priority[slot] = job->priority;
+  t->memReq[slot] = job->mem_req;
+  t->timeLeft[slot] = job->time_left;
+  for (r = 0; r < MAX_RESOURCES; r++) t->units[r][slot] = job->resources[r];
+}
+
+/* Collects every job in the table, lowest slot first, into a malloc'd
+   array. Jobs loaded into a fresh table come out in the order they were
+   loaded, since free slots are handed out lowest first.
+   Returns how many there are */
+int tableJobs(JobTable *t, PCB ***jobs) {
+  bool *unused = calloc(t->capacity + 1, sizeof(bool));
+  assert(unused != NULL);
+  int slot, count = 0;
+  for (slot = t->freeSlot; slot != JOB_NO_SLOT; slot = t->next[slot]) unused[slot] = true;
+  *jobs = malloc((t->capacity + 1) * sizeof(PCB *));
+  assert(*jobs != NULL);
+  for (slot = 0; slot < t->capacity; slot++) {
+    if (!unused[slot]) (*jobs)[count++] = jobAt(t, slot);
+  }
+  free(unused);
+  return count;
+}
+
+void pushSlot(SlotArray *a, int slot) {
+  if (a->size == a->capacity) {
+    a->capacity = a->capacity ? a->capacity * 2 : 64;
+    a->slots = realloc(a->slots, a->capacity * sizeof(int));
+    assert(a->slots != NULL);
+  }
+  a->slots[a->size++] = slot;
+}
+
+/* Where slot is in the array, -1 if it isn't */
+int findSlot(const SlotArray *a, int slot) {
+  int i;
+  for (i = 0; i < a->size; i++) {
+    if (a->slots[i] == slot) return i;
+  }
+  return -1;
+}
+
+/* Frees the array and every job in it */
+void freeSlots(JobTable *t, SlotArray *a) {
+  int i;
+  for (i = 0; i < a->size; i++) freeJob(t, jobAt(t, a->slots[i]));
+  free(a->slots);
+  memset(a, 0, sizeof(*a));
+}
+
+/* Frees every chunk and array. Every PCB is gone after this */
+void releaseJobTable(JobTable *t) {
+  int i;
+  for (i = 0; i < t->numChunks; i++) free(t->chunks[i]);
+  free(t->chunks);
+  free(t->id);
+  free(t->priority);
+  free(t->memReq);
+  free(t->timeLeft);
+  free(t->next);
+  for (i = 0; i < MAX_RESOURCES; i++) free(t->units[i]);
+  initJobTable(t);
+}
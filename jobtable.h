@@ -0,0 +1,61 @@
+#ifndef JOBTABLE_H
+#define JOBTABLE_H
+
+#include "hostd.h"
+
+#define JOB_CHUNK 1024      // PCBs carved out per malloc
+#define JOB_NO_SLOT (-1)    // end of a queue's chain
+#define JOB_UNLINKED (-2)   // next of a job that is in no queue
+
+/* Every PCB lives in a job table and is known by its slot there. Each
+   dispatcher has its own table, and everything that holds its jobs
+   (queues, heaps, the dispatch list) keeps a pointer to it.
+   PCBs come in chunks that never move, so a PCB pointer stays good for
+   as long as the job does. The fields that scans over many waiting jobs
+   compare are copied out into one array each, indexed by slot, so
+   those scans read consecutive ints instead of chasing a pointer per
+   job. They are written when the job is made or loaded and, for
+   time_left, through setTimeLeft. next links the slots of a queue */
+typedef struct jobTable {
+  PCB **chunks;
+  int numChunks;
+  int capacity;    // slots in all chunks
+  int freeSlot;    // first unused slot, chained through next
+  int *id;
+  int *priority;
+  int *memReq;
+  int *timeLeft;
+  int *units[MAX_RESOURCES];
+  int *next;
+  int numResources;       // device columns in a listing of the jobs
+  const char *initials;   // their headings, eg. "P,S,M,C"
+} JobTable;
+
+/* Growable array of slots, for keeping waiting jobs in a heap or pool
+   whose comparisons only need the table's arrays */
+typedef struct slotArray {
+  int *slots;
+  int size;
+  int capacity;
+} SlotArray;
+
+void initJobTable(JobTable *t);
+PCB* newJob(JobTable *t);
+void freeJob(JobTable *t, PCB *job);
+void syncJob(JobTable *t, PCB *job);
+int tableJobs(JobTable *t, PCB ***jobs);
+void releaseJobTable(JobTable *t);
+void pushSlot(SlotArray *a, int slot);
+int findSlot(const SlotArray *a, int slot);
+void freeSlots(JobTable *t, SlotArray *a);
+
+static inline PCB* jobAt(const JobTable *t, int slot) {
+  return &t->chunks[slot / JOB_CHUNK][slot % JOB_CHUNK];
+}
+
+static inline void setTimeLeft(JobTable *t, PCB *job, int timeLeft) {
+  job->time_left = timeLeft;
+  t->timeLeft[job->slot] = timeLeft;
+}
+
+#endif
@@ -0,0 +1,138 @@
+#include "hostd.h"
+#include "launcher.h"
+#include <time.h>
+#include <poll.h>
+
+/* hostd-launchbench: measures how long each launcher takes to start a
+   job process. Two numbers are reported per mode:
+     call  - time the dispatcher is blocked inside launchProcess
+     ready - time until the process prints its first line
+   Children write to a pipe that replaces our stdout so the first line
+   marks the moment the job is really running */
+
+#define PROCESS_PATH "./process"
+
+static double nowMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/* Waits for one full line from the children's output pipe */
+static bool readLine(int fd) {
+  char c;
+  struct pollfd p = {fd, POLLIN, 0};
+  while (poll(&p, 1, 5000) > 0) {
+    if (read(fd, &c, 1) != 1) return false;
+    if (c == '\n') return true;
+  }
+  return false;
+}
+
+static void printStats(FILE *out, const char *label, double *samples, int n) {
+  double sum = 0;
+  int i;
+  for (i = 0; i < n; i++) sum += samples[i];
+  qsort(samples, n, sizeof(double), compareDoubles);
+  fprintf(out, "  %-6s mean %8.1f us  p50 %8.1f us  p99 %8.1f us\n", label,
+      sum / n, samples[n / 2], samples[(int)(n * 0.99)]);
+}
+
+static void printBenchUsage(char *name) {
+  printf("Usage: %s [options]\n", name);
+  printf("  -n, --jobs <n>      launches per mode (default 200)\n");
+  printf("  -m, --heap-mb <mb>  touch this much dispatcher memory first (default 0)\n");
+  printf("  -P, --pool-size <n> parked workers for the pool launcher (default 8)\n");
+}
+
+int main(int argc, char **argv) {
+  int jobs = 200, heapMb = 0, poolSize = 8;
+
+  static struct option longOptions[] = {
+    {"jobs", required_argument, NULL, 'n'},
+    {"heap-mb", required_argument, NULL, 'm'},
+    {"pool-size", required_argument, NULL, 'P'},
+    {NULL, 0, NULL, 0}
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "n:m:P:", longOptions, NULL)) != -1) {
+    switch (opt) {
+      case 'n': jobs = atoi(optarg); break;
+      case 'm': heapMb = atoi(optarg); break;
+      case 'P': poolSize = atoi(optarg); break;
+      default:
+        printBenchUsage(argv[0]);
+        return 1;
+    }
+  }
+  if (jobs < 1) jobs = 1;
+
+  // a big dispatcher makes fork copy more page tables
+  char *heap = NULL;
+  if (heapMb > 0) {
+    heap = malloc((size_t)heapMb << 20);
+    assert(heap != NULL);
+    memset(heap, 1, (size_t)heapMb << 20);
+  }
+
+  // report on the real stdout, children write into the pipe
+  FILE *report = fdopen(dup(STDOUT_FILENO), "w");
+  int out[2];
+  if (pipe(out) < 0) return 1;
+  dup2(out[1], STDOUT_FILENO);
+  close(out[1]);
+
+  fprintf(report, "Job start latency over %d launches (dispatcher heap %d MB)\n", jobs, heapMb);
+  double *call = malloc(jobs * sizeof(double));
+  double *ready = malloc(jobs * sizeof(double));
+  assert(call != NULL && ready != NULL);
+
+  LaunchMode modes[] = {LAUNCH_FORK, LAUNCH_SPAWN, LAUNCH_POOL};
+  int m;
+  for (m = 0; m < 3; m++) {
+    if (!initLauncher(modes[m], PROCESS_PATH, poolSize)) {
+      fprintf(report, "%s: could not start launcher\n", launchModeName(modes[m]));
+      continue;
+    }
+
+    int i, done = 0;
+    for (i = 0; i < jobs; i++) {
+      double t0 = nowMicros();
+      pid_t pid = launchProcess(-1, NULL);
+      double t1 = nowMicros();
+      if (pid < 0) break;
+      bool started = readLine(out[0]);
+      double t2 = nowMicros();
+
+      kill(pid, SIGKILL);
+      waitpid(pid, NULL, 0);
+      if (!started) break;
+      call[done] = t1 - t0;
+      ready[done] = t2 - t0;
+      done++;
+      // refill outside the measured window, like hostd does between ticks
+      topUpLauncher();
+    }
+    closeLauncher();
+    while (waitpid(-1, NULL, 0) > 0) {
+    }
+
+    fprintf(report, "%s (%d ok)\n", launchModeName(modes[m]), done);
+    if (done > 0) {
+      printStats(report, "call", call, done);
+      printStats(report, "ready", ready, done);
+    }
+    fflush(report);
+  }
+
+  free(call);
+  free(ready);
+  free(heap);
+  fclose(report);
+  return 0;
+}
@@ -0,0 +1,207 @@
+#define _GNU_SOURCE // sched_setaffinity
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+#include <signal.h>
+#include <sched.h>
+#include <spawn.h>
+#include "launcher.h"
+
+/* Starts job processes for the dispatcher. Pool mode keeps poolSize
+   workers that have already been exec'd and are blocked reading a pipe.
+   Binding a job is one write(), and the pool is refilled off the
+   dispatch path by topUpLauncher */
+
+extern char **environ;
+
+typedef struct worker {
+  pid_t pid;
+  int wakeFd; // write end of the pipe the worker is parked on
+} Worker;
+
+static LaunchMode launchMode = LAUNCH_FORK;
+static const char *launchProgram;
+static Worker *pool;
+static int poolSize = 0, pooled = 0;
+static int hostCpus = 1;
+static bool detached = false; // jobs ignore SIGHUP, see detachJobs
+
+/* Restricts a process to one host core */
+static void pinProcess(pid_t pid, int hostCore) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(hostCore % hostCpus, &set);
+  if (sched_setaffinity(pid, sizeof(set), &set) < 0) {
+    perror("sched_setaffinity");
+  }
+}
+
+/* Fills argv with the --memory arguments of a job, using text for the
+   numbers. Returns the next free argv index */
+static int memoryArgs(char **argv, int i, const JobMemory *mem, char *text) {
+  if (mem == NULL) return i;
+  argv[i++] = "--memory";
+  argv[i++] = text;
+  snprintf(text, 64, "%d:%ld:%ld", mem->fd, mem->offset, mem->length);
+  return i;
+}
+
+/* posix_spawn the program, either parked on parkFd or given mem.
+   The child starts with no signals blocked whatever the dispatcher blocks */
+static pid_t spawnProcess(int parkFd, const JobMemory *mem) {
+  posix_spawnattr_t attr;
+  sigset_t noSignals;
+  sigemptyset(&noSignals);
+  posix_spawnattr_init(&attr);
+  posix_spawnattr_setsigmask(&attr, &noSignals);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+  char fdArg[16], memArg[64];
+  char *argv[] = {"process", "--park", fdArg, NULL, NULL};
+  if (parkFd < 0) argv[memoryArgs(argv, 1, mem, memArg)] = NULL;
+  else snprintf(fdArg, sizeof(fdArg), "%d", parkFd);
+
+  // an ignored signal stays ignored across exec, a caught one does not
+  struct sigaction ignore, old;
+  memset(&ignore, 0, sizeof(ignore));
+  ignore.sa_handler = SIG_IGN;
+  if (detached) sigaction(SIGHUP, &ignore, &old);
+  pid_t pid;
+  int err = posix_spawn(&pid, launchProgram, NULL, &attr, argv, environ);
+  posix_spawnattr_destroy(&attr);
+  if (detached) sigaction(SIGHUP, &old, NULL);
+  if (err != 0) {
+    errno = err;
+    return -1;
+  }
+  return pid;
+}
+
+/* Starts one parked worker and adds it to the pool */
+static bool addWorker() {
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) < 0) return false;
+  // only the read end is inherited by the worker
+  fcntl(fds[0], F_SETFD, 0);
+
+  pid_t pid = spawnProcess(fds[0], NULL);
+  close(fds[0]);
+  if (pid < 0) {
+    close(fds[1]);
+    return false;
+  }
+  pool[pooled].pid = pid;
+  pool[pooled].wakeFd = fds[1];
+  pooled++;
+  return true;
+}
+
+bool initLauncher(LaunchMode mode, const char *program, int size) {
+  launchMode = mode;
+  launchProgram = program;
+  hostCpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (hostCpus < 1) hostCpus = 1;
+
+  if (mode == LAUNCH_POOL) {
+    poolSize = (size > 0) ? size : 1;
+    pool = malloc(poolSize * sizeof(Worker));
+    assert(pool != NULL);
+    pooled = 0;
+    topUpLauncher();
+    if (pooled == 0) return false;
+  }
+  return true;
+}
+
+/* Starts a process for a job and returns its pid, or -1 on failure.
+   hostCore >= 0 pins the process to that core. mem, if not NULL, is
+   passed on to the process to map: on its command line, or in the
+   message that wakes a pool worker */
+pid_t launchProcess(int hostCore, const JobMemory *mem) {
+  pid_t pid;
+  char *argv[4], memArg[64];
+  int n;
+
+  switch (launchMode) {
+    case LAUNCH_FORK:
+      pid = fork();
+      if (pid == 0) {
+        sigset_t noSignals;
+        sigemptyset(&noSignals);
+        sigprocmask(SIG_SETMASK, &noSignals, NULL);
+        if (detached) signal(SIGHUP, SIG_IGN);
+        if (hostCore >= 0) pinProcess(0, hostCore);
+        argv[0] = "process";
+        argv[memoryArgs(argv, 1, mem, memArg)] = NULL;
+        execv(launchProgram, argv);
+        _exit(1); // exec failed, never fall back into the dispatcher
+      }
+      return pid;
+
+    case LAUNCH_POOL:
+      while (pooled > 0) {
+        Worker w = pool[--pooled];
+        if (hostCore >= 0) pinProcess(w.pid, hostCore);
+        // one write under PIPE_BUF, the worker gets it in one read
+        if (mem != NULL) n = snprintf(memArg, sizeof(memArg), "m%d:%ld:%ld", mem->fd, mem->offset, mem->length);
+        else n = snprintf(memArg, sizeof(memArg), "g");
+        bool woken = write(w.wakeFd, memArg, n) == n;
+        close(w.wakeFd);
+        if (woken) return w.pid;
+        // that worker died while parked, try the next one
+      }
+      // pool ran dry, fall through and spawn one directly
+
+    case LAUNCH_SPAWN:
+      pid = spawnProcess(-1, mem);
+      if (pid > 0 && hostCore >= 0) pinProcess(pid, hostCore);
+      return pid;
+  }
+  return -1;
+}
+
+/* Refills the worker pool. Meant to be called between ticks */
+void topUpLauncher() {
+  if (launchMode != LAUNCH_POOL) return;
+  while (pooled < poolSize && addWorker()) {
+  }
+}
+
+/* Parked workers see their pipe close and exit without running */
+void closeLauncher() {
+  while (pooled > 0) {
+    close(pool[--pooled].wakeFd);
+  }
+  free(pool);
+  pool = NULL;
+}
+
+/* Makes jobs started from now on outlive the dispatcher, so a restored
+   checkpoint can take them over. When the dispatcher dies its jobs are
+   left in an orphaned process group, and if any of them is stopped the
+   kernel sends the whole group SIGHUP, which would kill them all.
+   Pool workers have to be detached before they are spawned */
+void detachJobs(bool on) {
+  detached = on;
+}
+
+bool parseLaunchMode(const char *name, LaunchMode *mode) {
+  if (strcmp(name, "fork") == 0) *mode = LAUNCH_FORK;
+  else if (strcmp(name, "spawn") == 0) *mode = LAUNCH_SPAWN;
+  else if (strcmp(name, "pool") == 0) *mode = LAUNCH_POOL;
+  else return false;
+  return true;
+}
+
+const char* launchModeName(LaunchMode mode) {
+  switch (mode) {
+    case LAUNCH_FORK: return "fork";
+    case LAUNCH_SPAWN: return "spawn";
+    case LAUNCH_POOL: return "pool";
+  }
+  return "unknown";
+}
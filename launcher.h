@@ -0,0 +1,30 @@
+#ifndef LAUNCHER_H
+#define LAUNCHER_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* How new job processes are started */
+typedef enum {
+  LAUNCH_FORK,   // fork the dispatcher then exec
+  LAUNCH_SPAWN,  // posix_spawn, which uses vfork semantics in glibc
+  LAUNCH_POOL    // bind the job to an already exec'd, parked worker
+} LaunchMode;
+
+/* Memory a job process maps for itself: length bytes of the file open
+   as fd in the dispatcher (and so in the child), from offset */
+typedef struct jobMemory {
+  int fd;
+  long offset;
+  long length;
+} JobMemory;
+
+bool initLauncher(LaunchMode mode, const char *program, int poolSize);
+pid_t launchProcess(int hostCore, const JobMemory *mem);
+void topUpLauncher();
+void closeLauncher();
+void detachJobs(bool on);
+bool parseLaunchMode(const char *name, LaunchMode *mode);
+const char* launchModeName(LaunchMode mode);
+
+#endif
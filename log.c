@@ -0,0 +1,254 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include "log.h"
+
+/* Messages go through a single producer, single consumer ring of fixed
+   size records. The dispatcher only copies a format pointer and its
+   arguments into the next slot. A background thread formats the records
+   and writes them out in large chunks. If the ring is full the message
+   is dropped and counted instead of making the dispatcher wait, unless
+   the logger was started lossless (virtual time has no deadlines to miss,
+   so there it is better to wait than to lose output) */
+
+#define OUT_CHUNK (64 * 1024)  // formatted bytes gathered per write
+#define IDLE_NANOS 1000000L    // consumer nap when the ring is empty
+
+LogLevel logLevel = LOG_INFO;
+
+static LogRecord *ring = NULL;
+static size_t ringMask;
+static _Atomic size_t head = 0;   // next slot the dispatcher fills
+static _Atomic size_t tail = 0;   // next slot the logger formats
+static _Atomic size_t written = 0;// everything before this is out of stdio
+static _Atomic bool stopping = false;
+static unsigned long dropped = 0; // only touched by the dispatcher
+static size_t knownTail = 0;      // dispatcher's last look at tail
+static FILE *logOut = NULL;
+static int tickMillis = 1000;     // length of a dispatcher tick, for %t
+static pthread_t logThread;
+static bool threadRunning = false;
+static bool lossless = false;
+static char outBuf[OUT_CHUNK];
+static size_t outLen = 0;
+
+static void flushOut() {
+  if (outLen > 0) fwrite(outBuf, 1, outLen, logOut);
+  outLen = 0;
+  fflush(logOut);
+}
+
+static void emit(const char *text, size_t len);
+
+/* Plain %d without flags or width, by far the most common conversion */
+static void emitInt(int value) {
+  char digits[12];
+  int n = sizeof(digits);
+  unsigned int v = (value < 0) ? -(unsigned int)value : (unsigned int)value;
+  do {
+    digits[--n] = '0' + v % 10;
+    v /= 10;
+  } while (v > 0);
+  if (value < 0) digits[--n] = '-';
+  emit(digits + n, sizeof(digits) - n);
+}
+
+/* A dispatcher time in ticks, in seconds. Whole seconds print exactly
+   like %d so output with one second ticks is unchanged */
+static void emitTime(intptr_t ticks) {
+  long long ms = (long long)ticks * tickMillis;
+  if (ms % 1000 == 0) {
+    emitInt((int)(ms / 1000));
+    return;
+  }
+  char text[32];
+  long long whole = (ms < 0) ? -ms : ms;
+  int len = snprintf(text, sizeof(text), "%s%lld.%03lld", ms < 0 ? "-" : "",
+      whole / 1000, whole % 1000);
+  emit(text, len);
+}
+
+static void emit(const char *text, size_t len) {
+  if (outLen + len > sizeof(outBuf)) {
+    fwrite(outBuf, 1, outLen, logOut);
+    outLen = 0;
+    if (len > sizeof(outBuf)) {
+      fwrite(text, 1, len, logOut);
+      return;
+    }
+  }
+  memcpy(outBuf + outLen, text, len);
+  outLen += len;
+}
+
+/* Formats one record. Each conversion is handed to snprintf on its own
+   so every argument is passed with the type its conversion expects */
+static void formatRecord(const LogRecord *r) {
+  const char *p = r->fmt;
+  int arg = 0;
+  char spec[16], text[256];
+  while (*p) {
+    const char *literal = p;
+    while (*p && *p != '%') p++;
+    if (p > literal) emit(literal, p - literal);
+    if (*p == '\0') break;
+
+    if (p[1] == '%') {
+      emit("%", 1);
+      p += 2;
+      continue;
+    }
+    intptr_t value = (arg < r->nargs) ? r->args[arg] : 0;
+    if (p[1] == 'd' || p[1] == 's' || p[1] == 't') {
+      if (p[1] == 'd') emitInt((int)value);
+      else if (p[1] == 't') emitTime(value);
+      else {
+        const char *str = value ? (const char *)value : "(null)";
+        emit(str, strlen(str));
+      }
+      arg++;
+      p += 2;
+      continue;
+    }
+    // copy the conversion spec up to and including its letter
+    size_t n = 0;
+    spec[n++] = *p++;
+    while (*p && strchr("-+ #0123456789.", *p) && n < sizeof(spec) - 2) spec[n++] = *p++;
+    char conv = *p ? *p++ : 'd';
+    spec[n++] = conv;
+    spec[n] = '\0';
+
+    arg++;
+    int len;
+    if (conv == 's') len = snprintf(text, sizeof(text), spec, value ? (const char *)value : "(null)");
+    else len = snprintf(text, sizeof(text), spec, (int)value);
+    if (len > (int)sizeof(text) - 1) len = sizeof(text) - 1;
+    if (len > 0) emit(text, len);
+  }
+}
+
+static void* consume(void *unused) {
+  while (1) {
+    size_t t = atomic_load_explicit(&tail, memory_order_relaxed);
+    size_t h = atomic_load_explicit(&head, memory_order_acquire);
+    if (t == h) {
+      flushOut();
+      atomic_store_explicit(&written, t, memory_order_release);
+      if (atomic_load_explicit(&stopping, memory_order_acquire) &&
+          atomic_load_explicit(&head, memory_order_acquire) == t) {
+        break;
+      }
+      struct timespec nap = {0, IDLE_NANOS};
+      nanosleep(&nap, NULL);
+      continue;
+    }
+    // hand slots back in small batches as they are formatted
+    while (t != h) {
+      formatRecord(&ring[t & ringMask]);
+      t++;
+      if ((t & 63) == 0) atomic_store_explicit(&tail, t, memory_order_release);
+    }
+    atomic_store_explicit(&tail, t, memory_order_release);
+  }
+  return NULL;
+}
+
+/* Starts the logger thread. capacity is rounded up to a power of two.
+   With waitWhenFull a full ring makes the dispatcher wait instead of
+   dropping the message */
+bool initLogger(FILE *out, LogLevel level, int capacity, bool waitWhenFull) {
+  size_t slots = 1;
+  while (slots < (size_t)capacity) slots <<= 1;
+  ring = malloc(slots * sizeof(LogRecord));
+  assert(ring != NULL);
+  ringMask = slots - 1;
+  logOut = out;
+  logLevel = level;
+  atomic_store(&head, 0);
+  atomic_store(&tail, 0);
+  atomic_store(&written, 0);
+  knownTail = 0;
+  atomic_store(&stopping, false);
+  dropped = 0;
+  lossless = waitWhenFull;
+  if (pthread_create(&logThread, NULL, consume, NULL) != 0) return false;
+  threadRunning = true;
+  return true;
+}
+
+/* Called by the LOG macro. Never blocks while the logger thread runs,
+   before initLogger and after closeLogger it writes synchronously */
+void logWrite(const char *fmt, const intptr_t *args, int nargs) {
+  if (nargs > LOG_MAX_ARGS) nargs = LOG_MAX_ARGS;
+  if (!threadRunning) {
+    LogRecord r = {fmt, nargs, {0}};
+    memcpy(r.args, args, nargs * sizeof(intptr_t));
+    if (logOut == NULL) logOut = stdout;
+    formatRecord(&r);
+    flushOut();
+    return;
+  }
+  // tail is only reread when the ring looks full, so the dispatcher
+  // does not pull the logger's cache line over on every message
+  size_t h = atomic_load_explicit(&head, memory_order_relaxed);
+  while (h - knownTail > ringMask) {
+    knownTail = atomic_load_explicit(&tail, memory_order_acquire);
+    if (h - knownTail <= ringMask) break;
+    if (!lossless) {
+      dropped++;
+      return;
+    }
+    sched_yield();
+  }
+
+  LogRecord *r = &ring[h & ringMask];
+  r->fmt = fmt;
+  r->nargs = nargs;
+  memcpy(r->args, args, nargs * sizeof(intptr_t));
+  atomic_store_explicit(&head, h + 1, memory_order_release);
+}
+
+/* Sets how many milliseconds a tick passed to %t stands for */
+void setLogTick(int millis) {
+  tickMillis = millis;
+}
+
+bool logEnabled(LogLevel level) {
+  return level <= logLevel;
+}
+
+/* Waits until everything logged so far has been written out. Used
+   before printing straight to stdout so the output stays in order */
+void flushLogger() {
+  if (!threadRunning) return;
+  size_t h = atomic_load_explicit(&head, memory_order_relaxed);
+  while (atomic_load_explicit(&written, memory_order_acquire) < h) {
+    struct timespec nap = {0, IDLE_NANOS / 10};
+    nanosleep(&nap, NULL);
+  }
+}
+
+/* Drains the ring, stops the thread and reports any dropped messages */
+void closeLogger() {
+  if (!threadRunning) return;
+  atomic_store_explicit(&stopping, true, memory_order_release);
+  pthread_join(logThread, NULL);
+  threadRunning = false;
+  free(ring);
+  ring = NULL;
+  if (dropped > 0) {
+    fprintf(stderr, "Logger dropped %lu messages because its buffer was full.\n", dropped);
+  }
+}
+
+bool parseLogLevel(const char *name, LogLevel *level) {
+  if (strcmp(name, "quiet") == 0) *level = LOG_QUIET;
+  else if (strcmp(name, "info") == 0) *level = LOG_INFO;
+  else if (strcmp(name, "debug") == 0) *level = LOG_DEBUG;
+  else return false;
+  return true;
+}
@@ -0,0 +1,50 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* How much the dispatcher says about what it is doing */
+typedef enum {
+  LOG_QUIET,  // only the final reports
+  LOG_INFO,   // arrivals, starts and time left every tick
+  LOG_DEBUG   // queue contents and resource counts as well
+} LogLevel;
+
+#define LOG_MAX_ARGS 8
+
+/* One message as the dispatcher hands it over. Nothing is formatted on
+   the dispatcher's side, the logger thread does that later */
+typedef struct logRecord {
+  const char *fmt;   // must be a string literal
+  uint8_t nargs;
+  intptr_t args[LOG_MAX_ARGS];
+} LogRecord;
+
+extern LogLevel logLevel;
+
+/* Logs fmt with up to LOG_MAX_ARGS arguments if level is enabled.
+   Only %d, %c and %s conversions (with flags and widths) are supported,
+   and %s arguments must be wrapped in LOG_STR and outlive the logger.
+   A plain %t prints a dispatcher time given in ticks as seconds */
+#define LOG(level, fmt, ...) \
+  do { \
+    if ((level) <= logLevel) { \
+      intptr_t logArgs_[] = {0, ##__VA_ARGS__}; \
+      logWrite((fmt), logArgs_ + 1, sizeof(logArgs_) / sizeof(intptr_t) - 1); \
+    } \
+  } while (0)
+#define LOG_STR(s) ((intptr_t)(s))
+
+/* There is one logger per process, shared by every dispatcher in it,
+   which is why only one thread may log */
+bool initLogger(FILE *out, LogLevel level, int capacity, bool waitWhenFull);
+void logWrite(const char *fmt, const intptr_t *args, int nargs);
+void setLogTick(int millis);
+bool logEnabled(LogLevel level);
+void flushLogger();
+void closeLogger();
+bool parseLogLevel(const char *name, LogLevel *level);
+
+#endif
@@ -0,0 +1,125 @@
+#include <ctype.h>
+#include "machine.h"
+
+/* Adds a kind of device, or changes how many units of it there are */
+static bool setResource(Machine *m, const char *name, int units) {
+  size_t len = strlen(name), i;
+  if (len == 0 || len >= RESOURCE_NAME_LEN || units < 0) return false;
+  for (i = 0; i < len; i++) {
+    if (!isalnum((unsigned char)name[i]) && name[i] != '_' && name[i] != '-') return false;
+  }
+  int r;
+  for (r = 0; r < m->numResources && strcmp(m->names[r], name) != 0; r++);
+  if (r == MAX_RESOURCES) return false;
+  if (r == m->numResources) {
+    strcpy(m->names[r], name);
+    m->numResources++;
+  }
+  m->units[r] = units;
+  return true;
+}
+
+/* Reads a whole non-negative number, nothing else may follow it */
+static bool parseCount(const char *text, int *out) {
+  char *end;
+  long value = strtol(text, &end, 10);
+  if (end == text || *end != '\0' || value < 0 || value > 1 << 30) return false;
+  *out = (int)value;
+  return true;
+}
+
+/* The machine the dispatcher was written for: 1024 mb with the top 64
+   kept for realtime jobs, 2 printers, a scanner, a modem and 2 cd drives */
+void defaultMachine(Machine *m) {
+  memset(m, 0, sizeof(*m));
+  m->memory = 1024;
+  m->reserved = 64;
+  setResource(m, "printer", 2);
+  setResource(m, "scanner", 1);
+  setResource(m, "modem", 1);
+  setResource(m, "cd", 2);
+  finishMachine(m);
+}
+
+/* Replaces the devices with a comma separated list such as
+   "printer=2,scanner=1,gpu=4". The order is the order of the device
+   columns in the dispatch list */
+bool parseResources(const char *spec, Machine *m) {
+  char *copy = strdup(spec), *save, *word;
+  bool ok = copy != NULL;
+  m->numResources = 0;
+  for (word = ok ? strtok_r(copy, ",", &save) : NULL; word != NULL && ok;
+       word = strtok_r(NULL, ",", &save)) {
+    char *eq = strchr(word, '=');
+    int units;
+    ok = eq != NULL;
+    if (ok) *eq = '\0';
+    ok = ok && parseCount(eq + 1, &units) && setResource(m, word, units);
+  }
+  free(copy);
+  return ok;
+}
+
+/* Reads a machine file. Each line is one of
+     memory <mb>
+     reserved <mb>
+     resource <name> <units>
+   with # starting a comment. Settings left out keep their current
+   value, but any resource line replaces the whole list of devices */
+bool loadMachine(const char *path, Machine *m) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) return false;
+  char line[256];
+  long lineNo = 0;
+  bool ok = true, sawResource = false;
+  while (ok && fgets(line, sizeof(line), f) != NULL) {
+    lineNo++;
+    char *hash = strchr(line, '#');
+    if (hash != NULL) *hash = '\0';
+    char *save, *key = strtok_r(line, " \t\r\n", &save);
+    if (key == NULL) continue;
+    char *a = strtok_r(NULL, " \t\r\n", &save);
+    char *b = strtok_r(NULL, " \t\r\n", &save);
+    char *extra = strtok_r(NULL, " \t\r\n", &save);
+
+    if (strcmp(key, "memory") == 0) {
+      ok = a != NULL && b == NULL && parseCount(a, &m->memory);
+    } else if (strcmp(key, "reserved") == 0) {
+      ok = a != NULL && b == NULL && parseCount(a, &m->reserved);
+    } else if (strcmp(key, "resource") == 0) {
+      int units;
+      if (!sawResource) m->numResources = 0;
+      sawResource = true;
+      ok = a != NULL && b != NULL && extra == NULL && parseCount(b, &units) &&
+        setResource(m, a, units);
+    } else {
+      ok = false;
+    }
+    if (!ok) fprintf(stderr, "%s:%ld: bad machine setting\n", path, lineNo);
+  }
+  fclose(f);
+  return ok;
+}
+
+/* Checks the machine makes sense and builds its log labels.
+   Returns false if there is no memory for user jobs */
+bool finishMachine(Machine *m) {
+  if (m->memory <= 0 || m->reserved < 0 || m->reserved >= m->memory) return false;
+  m->nameList[0] = m->initials[0] = '\0';
+  int r;
+  for (r = 0; r < m->numResources; r++) {
+    if (r > 0) {
+      strcat(m->nameList, ", ");
+      strcat(m->initials, ",");
+    }
+    strcat(m->nameList, m->names[r]);
+    char initial[2] = {toupper((unsigned char)m->names[r][0]), '\0'};
+    strcat(m->initials, initial);
+  }
+  return true;
+}
+
+/* Memory user jobs may be placed in, everything below the reserved area */
+int userMemory(const Machine *m) {
+  return m->memory - m->reserved;
+}
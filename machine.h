@@ -0,0 +1,28 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include "hostd.h"
+
+#define RESOURCE_NAME_LEN 16
+
+/* The simulated machine: its memory, the part of it at the top that
+   only realtime jobs may use, and how many units there are of each
+   kind of device. A job's resources[i] asks for units of names[i] */
+typedef struct machine {
+  int memory;        // mb
+  int reserved;      // mb kept back for realtime jobs
+  int numResources;
+  char names[MAX_RESOURCES][RESOURCE_NAME_LEN];
+  int units[MAX_RESOURCES];
+  // labels for the logs, built by finishMachine
+  char nameList[MAX_RESOURCES * (RESOURCE_NAME_LEN + 2)]; // eg. "printer, scanner"
+  char initials[MAX_RESOURCES * 2];                       // eg. "P,S"
+} Machine;
+
+void defaultMachine(Machine *m);
+bool loadMachine(const char *path, Machine *m);
+bool parseResources(const char *spec, Machine *m);
+bool finishMachine(Machine *m);
+int userMemory(const Machine *m);
+
+#endif
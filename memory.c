@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "memory.h"
+
+#define WORD_BITS 64
+#define ALL_USED (~0ULL)
+
+/* Refreshes the two summary bits that describe bitmap word w */
+static void updateSummary(MemMap *m, int w) {
+  uint64_t bit = 1ULL << (w % WORD_BITS);
+  int s = w / WORD_BITS;
+
+  if (m->bits[w] != ALL_USED) m->hasFree[s] |= bit;
+  else m->hasFree[s] &= ~bit;
+
+  if (m->bits[w] != 0) m->hasUsed[s] |= bit;
+  else m->hasUsed[s] &= ~bit;
+}
+
+/* Marks units [start, start+size) as used or free a word at a time */
+static void setRange(MemMap *m, int start, int size, bool used) {
+  int end = start + size;
+  while (start < end) {
+    int w = start / WORD_BITS;
+    int lo = start % WORD_BITS;
+    int hi = (end - w * WORD_BITS < WORD_BITS) ? end - w * WORD_BITS : WORD_BITS;
+    uint64_t mask = (hi == WORD_BITS) ? ALL_USED << lo
+                                      : ((1ULL << hi) - 1) & (ALL_USED << lo);
+    if (used) m->bits[w] |= mask;
+    else m->bits[w] &= ~mask;
+    updateSummary(m, w);
+    start = w * WORD_BITS + hi;
+  }
+}
+
+/* Returns the first word index >= from whose summary bit is set, or m->words */
+static int nextMarkedWord(MemMap *m, uint64_t *summary, int from) {
+  if (from >= m->words) return m->words;
+  int s = from / WORD_BITS;
+  uint64_t x = summary[s] & (ALL_USED << (from % WORD_BITS));
+  while (x == 0) {
+    s++;
+    if (s >= m->summaryWords) return m->words;
+    x = summary[s];
+  }
+  int w = s * WORD_BITS + __builtin_ctzll(x);
+  return (w < m->words) ? w : m->words;
+}
+
+/* First free unit in [from, limit), or limit if there is none */
+static int nextFreeUnit(MemMap *m, int from, int limit) {
+  if (from >= limit) return limit;
+  int w = from / WORD_BITS;
+  uint64_t x = ~m->bits[w] & (ALL_USED << (from % WORD_BITS));
+  if (x == 0) {
+    w = nextMarkedWord(m, m->hasFree, w + 1);
+    if (w >= m->words) return limit;
+    x = ~m->bits[w];
+  }
+  int unit = w * WORD_BITS + __builtin_ctzll(x);
+  return (unit < limit) ? unit : limit;
+}
+
+/* First used unit in [from, limit), or limit if there is none */
+static int nextUsedUnit(MemMap *m, int from, int limit) {
+  if (from >= limit) return limit;
+  int w = from / WORD_BITS;
+  uint64_t x = m->bits[w] & (ALL_USED << (from % WORD_BITS));
+  if (x == 0) {
+    w = nextMarkedWord(m, m->hasUsed, w + 1);
+    if (w >= m->words) return limit;
+    x = m->bits[w];
+  }
+  int unit = w * WORD_BITS + __builtin_ctzll(x);
+  return (unit < limit) ? unit : limit;
+}
+
+/* Finds the next free block starting at or after from and below limit.
+   Returns its start and stores its length in len, or -1 if there is none */
+static int nextFreeBlock(MemMap *m, int from, int limit, int *len) {
+  int start = nextFreeUnit(m, from, limit);
+  if (start >= limit) return -1;
+  *len = nextUsedUnit(m, start, limit) - start;
+  return start;
+}
+
+/* Walks every free block once to rebuild the largest block cache */
+static void refreshLargest(MemMap *m) {
+  int largestAll = 0, largestUser = 0;
+  int pos = 0, len;
+  int start;
+  while ((start = nextFreeBlock(m, pos, m->units, &len)) >= 0) {
+    if (len > largestAll) largestAll = len;
+    if (start < m->userUnits) {
+      int userLen = (start + len < m->userUnits) ? len : m->userUnits - start;
+      if (userLen > largestUser) largestUser = userLen;
+    }
+    pos = start + len;
+  }
+  m->largestAll = largestAll;
+  m->largestUser = largestUser;
+  m->largestValid = true;
+}
+
+/* Set up an empty memory of the given size */
+void initMemMap(MemMap *m, int units, int userUnits, FitPolicy policy) {
+  assert(units > 0 && userUnits <= units);
+  m->units = units;
+  m->userUnits = userUnits;
+  m->words = (units + WORD_BITS - 1) / WORD_BITS;
+  m->summaryWords = (m->words + WORD_BITS - 1) / WORD_BITS;
+  m->bits = calloc(m->words, sizeof(uint64_t));
+  m->hasFree = calloc(m->summaryWords, sizeof(uint64_t));
+  m->hasUsed = calloc(m->summaryWords, sizeof(uint64_t));
+  assert(m->bits != NULL && m->hasFree != NULL && m->hasUsed != NULL);
+  m->used = 0;
+  m->nextFit = 0;
+  m->policy = policy;
+  m->generation = 0;
+  m->largestValid = false;
+
+  int w;
+  for (w = 0; w < m->words; w++) {
+    updateSummary(m, w);
+  }
+  // padding past the end of memory is permanently marked as used
+  if (units % WORD_BITS != 0) {
+    setRange(m, units, WORD_BITS - units % WORD_BITS, true);
+  }
+}
+
+void destroyMemMap(MemMap *m) {
+  free(m->bits);
+  free(m->hasFree);
+  free(m->hasUsed);
+  m->bits = m->hasFree = m->hasUsed = NULL;
+}
+
+/* Returns the size of the largest free block below limit */
+int largestFreeBlock(MemMap *m, int limit) {
+  if (limit == m->units || limit == m->userUnits) {
+    if (!m->largestValid) refreshLargest(m);
+    return (limit == m->units) ? m->largestAll : m->largestUser;
+  }
+  // uncommon limit, walk it directly
+  int largest = 0, pos = 0, len, start;
+  while ((start = nextFreeBlock(m, pos, limit, &len)) >= 0) {
+    if (len > largest) largest = len;
+    pos = start + len;
+  }
+  return largest;
+}
+
+/* Searches [0, limit) for a free block of size units using the map policy.
+   Returns the start of the block or -1 if nothing fits. Nothing is claimed */
+int findMemBlock(MemMap *m, int limit, int size) {
+  if (size <= 0 || size > limit) return -1;
+  // the cached largest block answers most failed searches in O(1)
+  if (size > largestFreeBlock(m, limit)) return -1;
+
+  int pos = 0, len, start;
+  switch (m->policy) {
+    case FIRST_FIT:
+      while ((start = nextFreeBlock(m, pos, limit, &len)) >= 0) {
+        if (len >= size) return start;
+        pos = start + len;
+      }
+      break;
+
+    case BEST_FIT: {
+      int best = -1, bestLen = 0;
+      while ((start = nextFreeBlock(m, pos, limit, &len)) >= 0) {
+        if (len >= size && (best < 0 || len < bestLen)) {
+          best = start;
+          bestLen = len;
+          if (len == size) break; // can't do better than an exact fit
+        }
+        pos = start + len;
+      }
+      return best;
+    }
+
+    case NEXT_FIT: {
+      int resume = (m->nextFit < limit) ? m->nextFit : 0;
+      pos = resume;
+      while ((start = nextFreeBlock(m, pos, limit, &len)) >= 0) {
+        if (len >= size) return start;
+        pos = start + len;
+      }
+      // wrap around and search the part before the resume point
+      pos = 0;
+      while ((start = nextFreeBlock(m, pos, resume, &len)) >= 0) {
+        if (start + len == resume) len = nextUsedUnit(m, start, limit) - start;
+        if (len >= size) return start;
+        pos = start + len;
+      }
+      break;
+    }
+  }
+  return -1;
+}
+
+/* Marks a block found by findMemBlock as used */
+void claimMemBlock(MemMap *m, int start, int size) {
+  assert(start >= 0 && size > 0 && start + size <= m->units);
+  setRange(m, start, size, true);
+  m->used += size;
+  m->nextFit = start + size;
+  m->largestValid = false;
+}
+
+/* Returns a block to the free pool */
+void releaseMemBlock(MemMap *m, int start, int size) {
+  assert(start >= 0 && size > 0 && start + size <= m->units);
+  setRange(m, start, size, false);
+  m->used -= size;
+  m->generation++;
+  m->largestValid = false;
+}
+
+/* Relocates a used block. The two ranges may overlap */
+void moveMemBlock(MemMap *m, int from, int to, int size) {
+  assert(from >= 0 && to >= 0 && size > 0 && from + size <= m->units && to + size <= m->units);
+  setRange(m, from, size, false);
+  setRange(m, to, size, true);
+  m->nextFit = to + size;
+  m->generation++;
+  m->largestValid = false;
+}
+
+/* Writes which units are in use, for a checkpoint */
+void saveMemMap(FILE *f, MemMap *m) {
+  fwrite(&m->used, sizeof(m->used), 1, f);
+  fwrite(&m->nextFit, sizeof(m->nextFit), 1, f);
+  fwrite(&m->generation, sizeof(m->generation), 1, f);
+  fwrite(m->bits, sizeof(uint64_t), m->words, f);
+}
+
+/* Reads a map written by saveMemMap into one set up with the same size.
+   The summaries are rebuilt from the bitmap */
+bool loadMemMap(FILE *f, MemMap *m) {
+  if (fread(&m->used, sizeof(m->used), 1, f) != 1 ||
+      fread(&m->nextFit, sizeof(m->nextFit), 1, f) != 1 ||
+      fread(&m->generation, sizeof(m->generation), 1, f) != 1 ||
+      fread(m->bits, sizeof(uint64_t), m->words, f) != (size_t)m->words) {
+    return false;
+  }
+  int w;
+  for (w = 0; w < m->words; w++) updateSummary(m, w);
+  m->largestValid = false;
+  return true;
+}
+
+/* Fills in free space, block count and fragmentation for [0, limit) */
+void reportMemMap(MemMap *m, int limit, MemReport *report) {
+  int w, usedUnits = 0;
+  int fullWords = limit / WORD_BITS;
+  for (w = 0; w < fullWords; w++) {
+    usedUnits += __builtin_popcountll(m->bits[w]);
+  }
+  if (limit % WORD_BITS != 0) {
+    uint64_t mask = (1ULL << (limit % WORD_BITS)) - 1;
+    usedUnits += __builtin_popcountll(m->bits[fullWords] & mask);
+  }
+
+  report->freeUnits = limit - usedUnits;
+  report->freeBlocks = 0;
+  report->largestBlock = 0;
+  int pos = 0, len, start;
+  while ((start = nextFreeBlock(m, pos, limit, &len)) >= 0) {
+    report->freeBlocks++;
+    if (len > report->largestBlock) report->largestBlock = len;
+    pos = start + len;
+  }
+  report->fragmentation = (report->freeUnits == 0) ? 0.0 :
+      1.0 - (double)report->largestBlock / report->freeUnits;
+}
+
+/* Prints a short memory layout summary */
+void printMemReport(char *name, MemMap *m, int limit) {
+  MemReport report;
+  reportMemMap(m, limit, &report);
+  printf("\n%s MEMORY REPORT (%s fit) ==================\n", name, fitPolicyName(m->policy));
+  printf("Free: %d of %d  Free blocks: %d  Largest block: %d\n",
+      report.freeUnits, limit, report.freeBlocks, report.largestBlock);
+  printf("External fragmentation: %.1f%%\n", report.fragmentation * 100.0);
+  printf("==================================================\n\n");
+}
+
+bool parseFitPolicy(const char *name, FitPolicy *policy) {
+  if (strcmp(name, "first") == 0) *policy = FIRST_FIT;
+  else if (strcmp(name, "best") == 0) *policy = BEST_FIT;
+  else if (strcmp(name, "next") == 0) *policy = NEXT_FIT;
+  else return false;
+  return true;
+}
+
+const char* fitPolicyName(FitPolicy policy) {
+  switch (policy) {
+    case FIRST_FIT: return "first";
+    case BEST_FIT: return "best";
+    case NEXT_FIT: return "next";
+  }
+  return "unknown";
+}
@@ -0,0 +1,57 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Placement policy used when searching for a free block */
+typedef enum {
+  FIRST_FIT,
+  BEST_FIT,
+  NEXT_FIT
+} FitPolicy;
+
+/* Simulated memory stored as a packed bitmap (1 bit per unit, set = used).
+   Two summary bitmaps hold one bit per bitmap word so searches can skip
+   words that are completely used or completely free */
+typedef struct memMap {
+  uint64_t *bits;
+  uint64_t *hasFree;   // bit w set = word w has at least one free unit
+  uint64_t *hasUsed;   // bit w set = word w has at least one used unit
+  int units;           // total size of memory
+  int userUnits;       // user jobs may only be placed in [0, userUnits)
+  int words;
+  int summaryWords;
+  int used;
+  int nextFit;         // where the next next-fit search resumes
+  FitPolicy policy;
+  unsigned long generation; // bumped every time memory is released
+  bool largestValid;   // largest free block cache, dropped on any change
+  int largestAll;
+  int largestUser;
+} MemMap;
+
+/* Snapshot of how memory is laid out */
+typedef struct memReport {
+  int freeUnits;
+  int freeBlocks;
+  int largestBlock;
+  double fragmentation; // 1 - largest / free, 0 means no external fragmentation
+} MemReport;
+
+void initMemMap(MemMap *m, int units, int userUnits, FitPolicy policy);
+void destroyMemMap(MemMap *m);
+int findMemBlock(MemMap *m, int limit, int size);
+void claimMemBlock(MemMap *m, int start, int size);
+void releaseMemBlock(MemMap *m, int start, int size);
+void moveMemBlock(MemMap *m, int from, int to, int size);
+int largestFreeBlock(MemMap *m, int limit);
+void reportMemMap(MemMap *m, int limit, MemReport *report);
+void printMemReport(char *name, MemMap *m, int limit);
+void saveMemMap(FILE *f, MemMap *m);
+bool loadMemMap(FILE *f, MemMap *m);
+bool parseFitPolicy(const char *name, FitPolicy *policy);
+const char* fitPolicyName(FitPolicy policy);
+
+#endif
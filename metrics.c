@@ -0,0 +1,139 @@
+#include "metrics.h"
+#include "checkpoint.h"
+
+static const char *classNames[METRIC_CLASSES] = {"realtime", "p1", "p2", "p3"};
+static const char *metricNames[NUM_METRICS] = {
+  "turnaround", "response", "wait", "resources", "demoted"
+};
+
+void initJobMetrics(JobMetrics *m, int tickMillis) {
+  int c, k;
+  m->tickMillis = tickMillis;
+  for (c = 0; c < METRIC_CLASSES; c++) {
+    for (k = 0; k < NUM_METRICS; k++) {
+      initHistogram(&m->hist[c][k]);
+    }
+    m->jobs[c] = 0;
+    m->deadlineJobs[c] = m->missed[c] = m->rejected[c] = m->deferred[c] = 0;
+    initHistogram(&m->lateness[c]);
+  }
+}
+
+/* Adds a finished job. Its completion time must already be set */
+void recordJobMetrics(JobMetrics *m, PCB *job) {
+  int c = job->priority;
+  if (c < 0 || c >= METRIC_CLASSES) return;
+
+  int queued = job->user_wait, demoted = 0, level;
+  for (level = 0; level < 4; level++) {
+    queued += job->level_wait[level];
+    if (level > job->priority) demoted += job->level_wait[level];
+  }
+
+  Histogram *h = m->hist[c];
+  recordValue(&h[METRIC_TURNAROUND], job->completion - job->arrival_time);
+  // a job that exits before it is ever dispatched has no response time
+  if (job->first_run >= 0) {
+    recordValue(&h[METRIC_RESPONSE], job->first_run - job->arrival_time);
+  }
+  recordValue(&h[METRIC_WAIT], queued);
+  recordValue(&h[METRIC_RESOURCES], job->user_wait);
+  recordValue(&h[METRIC_DEMOTED], demoted);
+  m->jobs[c]++;
+  if (job->deadline >= 0) {
+    m->deadlineJobs[c]++;
+    if (job->completion > job->deadline) {
+      m->missed[c]++;
+      recordValue(&m->lateness[c], job->completion - job->deadline);
+    }
+  }
+}
+
+/* Counts a job that admission control dropped. It never ran, so it
+   only shows up in the deadline report */
+void recordRejected(JobMetrics *m, PCB *job) {
+  int c = job->priority;
+  if (c < 0 || c >= METRIC_CLASSES) return;
+  m->deadlineJobs[c]++;
+  m->rejected[c]++;
+}
+
+/* Counts a job the first time admission control holds it back */
+void recordDeferred(JobMetrics *m, PCB *job) {
+  int c = job->priority;
+  if (c < 0 || c >= METRIC_CLASSES) return;
+  m->deferred[c]++;
+}
+
+/* Prints how many deadlines each class met, missed or was refused
+   outright, and how late the misses were. Nothing if no job had one */
+static void printDeadlines(FILE *out, JobMetrics *m) {
+  double secs = m->tickMillis / 1000.0;
+  int prec = (m->tickMillis % 1000 == 0) ? 0 : 3;
+  int c;
+  for (c = 0; c < METRIC_CLASSES && m->deadlineJobs[c] == 0; c++);
+  if (c == METRIC_CLASSES) return;
+  fprintf(out, "DEADLINES ============================================\n");
+  fprintf(out, "CLASS       JOBS    MET MISSED REJECTED DEFERRED LATE P95 LATE MAX\n");
+  for (c = 0; c < METRIC_CLASSES; c++) {
+    if (m->deadlineJobs[c] == 0) continue;
+    Histogram *h = &m->lateness[c];
+    long met = m->deadlineJobs[c] - m->missed[c] - m->rejected[c];
+    fprintf(out, "%-9s %6ld %6ld %6ld %8ld %8ld %8.*f %8.*f\n",
+        classNames[c], m->deadlineJobs[c], met, m->missed[c], m->rejected[c], m->deferred[c],
+        prec, valueAtPercentile(h, 95) * secs, prec, h->max * secs);
+  }
+  fprintf(out, "======================================================\n\n");
+}
+
+/* Prints p50/p95/p99, mean and max of every metric for each class
+   that has finished at least one job. Sub-second ticks get three decimals */
+void printJobMetrics(FILE *out, JobMetrics *m, int now) {
+  double secs = m->tickMillis / 1000.0;
+  int prec = (m->tickMillis % 1000 == 0) ? 0 : 3;
+  fprintf(out, "\nJOB METRICS AT %.*f SECONDS ============================\n", prec, now * secs);
+  fprintf(out, "CLASS     METRIC        JOBS    P50    P95    P99    MEAN    MAX\n");
+  int c, k;
+  for (c = 0; c < METRIC_CLASSES; c++) {
+    if (m->jobs[c] == 0) continue;
+    for (k = 0; k < NUM_METRICS; k++) {
+      Histogram *h = &m->hist[c][k];
+      // realtime jobs are never demoted and never wait for devices
+      if (c == 0 && (k == METRIC_RESOURCES || k == METRIC_DEMOTED)) continue;
+      fprintf(out, "%-9s %-11s %6lu %6.*f %6.*f %6.*f %7.*f %6.*f\n",
+          classNames[c], metricNames[k], (unsigned long)h->total,
+          prec, valueAtPercentile(h, 50) * secs, prec, valueAtPercentile(h, 95) * secs,
+          prec, valueAtPercentile(h, 99) * secs, prec ? prec : 1, histogramMean(h) * secs,
+          prec, h->max * secs);
+    }
+  }
+  fprintf(out, "======================================================\n\n");
+  printDeadlines(out, m);
+  fflush(out);
+}
+
+/* Writes the counts and every histogram of the jobs finished so far */
+void saveJobMetrics(FILE *f, JobMetrics *m) {
+  int c, k;
+  SAVE(f, m->jobs);
+  SAVE(f, m->deadlineJobs);
+  SAVE(f, m->missed);
+  SAVE(f, m->rejected);
+  SAVE(f, m->deferred);
+  for (c = 0; c < METRIC_CLASSES; c++) {
+    for (k = 0; k < NUM_METRICS; k++) saveHistogram(f, &m->hist[c][k]);
+    saveHistogram(f, &m->lateness[c]);
+  }
+}
+
+/* Reads metrics written by saveJobMetrics, keeping the tick length */
+bool loadJobMetrics(FILE *f, JobMetrics *m) {
+  int c, k;
+  bool ok = LOAD(f, m->jobs) && LOAD(f, m->deadlineJobs) && LOAD(f, m->missed) &&
+    LOAD(f, m->rejected) && LOAD(f, m->deferred);
+  for (c = 0; c < METRIC_CLASSES && ok; c++) {
+    for (k = 0; k < NUM_METRICS && ok; k++) ok = loadHistogram(f, &m->hist[c][k]);
+    ok = ok && loadHistogram(f, &m->lateness[c]);
+  }
+  return ok;
+}
@@ -0,0 +1,42 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include "hostd.h"
+#include "histogram.h"
+
+/* What is measured for each finished job */
+typedef enum {
+  METRIC_TURNAROUND,  // completion - arrival
+  METRIC_RESPONSE,    // first run - arrival
+  METRIC_WAIT,        // total time queued but not running
+  METRIC_RESOURCES,   // time in userQ waiting for memory and devices
+  METRIC_DEMOTED,     // time queued below the priority it arrived with
+  NUM_METRICS
+} MetricKind;
+
+#define METRIC_CLASSES 4 // realtime, p1, p2 and p3 by arrival priority
+
+/* Latency histograms of every finished job, split by priority class.
+   Values are recorded in dispatcher ticks and printed in seconds */
+typedef struct jobMetrics {
+  Histogram hist[METRIC_CLASSES][NUM_METRICS];
+  long jobs[METRIC_CLASSES];
+  // jobs that came with a deadline and how they fared
+  long deadlineJobs[METRIC_CLASSES];
+  long missed[METRIC_CLASSES];
+  long rejected[METRIC_CLASSES];  // turned away by admission control
+  long deferred[METRIC_CLASSES];  // held back by admission control at least once
+  Histogram lateness[METRIC_CLASSES]; // completion - deadline of the missed ones
+  int tickMillis;
+} JobMetrics;
+
+void initJobMetrics(JobMetrics *m, int tickMillis);
+void recordJobMetrics(JobMetrics *m, PCB *job);
+void recordRejected(JobMetrics *m, PCB *job);
+void recordDeferred(JobMetrics *m, PCB *job);
+void printJobMetrics(FILE *out, JobMetrics *m, int now);
+void saveJobMetrics(FILE *f, JobMetrics *m);
+bool loadJobMetrics(FILE *f, JobMetrics *m);
+
+#endif
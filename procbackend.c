@@ -0,0 +1,194 @@
+#include "procbackend.h"
+#include "launcher.h"
+#include "log.h"
+
+/* Jobs are stopped with SIGTSTP and only count as stopped once the
+   supervisor reports it, so the dispatcher never waits on a child.
+   Until then a job sits in the stopping list, and a resume that comes
+   first is held back until the stop is seen */
+
+static const char *program;    // what every job runs, checked on adoption
+static bool pinJobs = false;   // pin each child to the host core matching its cpu
+static int hostCpus = 1;
+static PCB **stopping; // jobs sent SIGTSTP whose stop has not been seen yet
+static int numStopping = 0, stoppingCap = 0;
+
+void initProcessJobs(const char *path, bool pin) {
+	program = path;
+	pinJobs = pin;
+	hostCpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (hostCpus < 1) hostCpus = 1;
+}
+
+void closeProcessJobs() {
+	free(stopping);
+	stopping = NULL;
+	numStopping = stoppingCap = 0;
+}
+
+/* Restricts a process to the host core backing simulated cpu cpuIndex */
+static void pinJob(pid_t pid, int cpuIndex) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpuIndex % hostCpus, &set);
+	if (sched_setaffinity(pid, sizeof(set), &set) < 0) {
+		perror("sched_setaffinity");
+	}
+}
+
+/* Notes that a stop was asked for and is waiting to be confirmed */
+static void awaitStop(PCB *job) {
+	job->state = JOB_STOPPING;
+	if (numStopping == stoppingCap) {
+		stoppingCap = stoppingCap ? stoppingCap * 2 : 16;
+		stopping = realloc(stopping, stoppingCap * sizeof(PCB *));
+		assert(stopping != NULL);
+	}
+	stopping[numStopping++] = job;
+}
+
+/* Drops a job from the stopping list, if it is there */
+static void forgetStop(PCB *job) {
+	int i;
+	for (i = 0; i < numStopping; i++) {
+		if (stopping[i] == job) {
+			stopping[i] = stopping[--numStopping];
+			return;
+		}
+	}
+}
+
+static bool processStart(Dispatcher *d, PCB *job, int cpuIndex) {
+	// with an arena the job maps the pages of its own block
+	JobMemory mem = {d->arena.fd, (long)job->mem_start * ARENA_UNIT, (long)job->mem_req * ARENA_UNIT};
+	bool backed = d->arena.fd >= 0 && job->mem_start >= 0 && job->mem_req > 0;
+	job->pid = launchProcess(pinJobs ? cpuIndex % hostCpus : -1, backed ? &mem : NULL);
+	if (job->pid < 0) {
+		return false;
+	}
+	job->state = JOB_RUNNING;
+	return true;
+}
+
+/* Asks the job to stop. The stop is confirmed later by a child event */
+static void processSuspend(Dispatcher *d, PCB *job, int cpuIndex) {
+	if (job->state == JOB_RESUME_PENDING) {
+		// the earlier SIGTSTP is still on its way, just don't resume after it
+		job->state = JOB_STOPPING;
+		return;
+	}
+	// a process adopted from a dead dispatcher is in an orphaned process
+	// group, where the kernel throws away the SIGTSTP it stops itself with
+	kill(job->pid, isAdopted(job->pid) ? SIGSTOP : SIGTSTP);
+	awaitStop(job);
+}
+
+/* A job whose stop has not been seen yet is resumed once it is,
+   otherwise SIGCONT could race its own SIGTSTP */
+static void processResume(Dispatcher *d, PCB *job, int cpuIndex) {
+	// the job may come back on a different cpu than it last ran on
+	if (pinJobs) pinJob(job->pid, cpuIndex);
+	if (job->state == JOB_STOPPING) {
+		job->state = JOB_RESUME_PENDING;
+		return;
+	}
+	kill(job->pid, SIGCONT);
+	job->state = JOB_RUNNING;
+}
+
+/* Kills the job. Its exit is reaped by the child event handler. The
+   dispatcher completes the job right after this, so a stop still on
+   its way must not find it in the stopping list: its exit then goes to
+   jobReaped like that of any other killed job */
+static void processTerminate(Dispatcher *d, PCB *job) {
+	if (job->state == JOB_STOPPING || job->state == JOB_RESUME_PENDING) forgetStop(job);
+	if (job->state != JOB_EXITED) {
+		kill(job->pid, SIGINT);
+		// a stopped process only acts on the SIGINT once it is continued
+		if (job->state != JOB_RUNNING) kill(job->pid, SIGCONT);
+	}
+}
+
+const JobBackend processJobs = {
+	"process", processStart, processSuspend, processResume, processTerminate
+};
+
+/* Reacts to a child stopping, continuing or exiting. Called from the
+   supervisor as soon as the kernel reports it, with the dispatcher
+   whose jobs the children are as context */
+void handleChildEvent(void *context, pid_t pid, ChildEventType type, int status) {
+	Dispatcher *d = context;
+	int i;
+	if (type == CHILD_CONTINUED) {
+		LOG(LOG_DEBUG, "Process %d continued.\n", (int)pid);
+		return;
+	}
+
+	// a job we asked to stop is either stopping now or died first
+	for (i = 0; i < numStopping; i++) {
+		if (stopping[i]->pid == pid) break;
+	}
+	if (i < numStopping) {
+		PCB *job = stopping[i];
+		stopping[i] = stopping[--numStopping];
+
+		if (type == CHILD_STOPPED) {
+			if (job->state == JOB_RESUME_PENDING) {
+				kill(job->pid, SIGCONT);
+				job->state = JOB_RUNNING;
+			} else {
+				job->state = JOB_STOPPED;
+			}
+			return;
+		}
+		jobGone(d, job);
+		return;
+	}
+
+	// anything else running is a job that finished on its own, the
+	// rest are jobs we terminated ourselves
+	if (type == CHILD_EXITED && !jobExited(d, pid)) jobReaped(d, pid);
+}
+
+/* Takes over the processes of restored jobs that had started. When the
+   old dispatcher died the kernel continued any stopped ones, so jobs
+   that should be waiting are stopped again and jobs that should be
+   running are made sure of. A job whose process is gone finished while
+   nobody was watching and is completed now.
+   Returns how many processes were taken over */
+int adoptJobs(Dispatcher *d, PCB **jobs, int count) {
+	PCB **gone = malloc((count + 1) * sizeof(PCB *));
+	assert(gone != NULL);
+	int numGone = 0, adopted = 0, i, c;
+	for (i = 0; i < count; i++) {
+		PCB *job = jobs[i];
+		if (job->pid < 0 || job->state == JOB_NEW || job->state == JOB_EXITED) continue;
+		if (!adoptChild(job->pid, program)) {
+			gone[numGone++] = job;
+			continue;
+		}
+		adopted++;
+		if (job->state == JOB_RUNNING || job->state == JOB_RESUME_PENDING) {
+			if (processStopped(job->pid)) kill(job->pid, SIGCONT);
+			job->state = JOB_RUNNING;
+		} else {
+			// stopped for real this time, the stop is seen on a later tick
+			kill(job->pid, SIGSTOP);
+			awaitStop(job);
+		}
+	}
+
+	// handled as if the exit had just been reported
+	for (i = 0; i < numGone; i++) {
+		PCB *job = gone[i];
+		LOG(LOG_INFO, "Process %d of job %d is gone, it finished while the dispatcher was down.\n",
+			(int)job->pid, job->id);
+		bool running = false;
+		for (c = 0; c < d->numCpus; c++) running = running || d->cpus[c].job == job;
+		if (running) job->state = JOB_RUNNING;
+		else awaitStop(job);
+		handleChildEvent(d, job->pid, CHILD_EXITED, 0);
+	}
+	free(gone);
+	return adopted;
+}
@@ -0,0 +1,18 @@
+#ifndef PROCBACKEND_H
+#define PROCBACKEND_H
+
+#include "dispatcher.h"
+#include "supervisor.h"
+
+/* Runs every job as a process from the launcher, stopping and
+   continuing it with signals. There is one set of children per
+   process, so it serves a single dispatcher, which is handed in with
+   each call rather than kept */
+extern const JobBackend processJobs;
+
+void initProcessJobs(const char *program, bool pin);
+void handleChildEvent(void *context, pid_t pid, ChildEventType type, int status);
+int adoptJobs(Dispatcher *d, PCB **jobs, int count);
+void closeProcessJobs();
+
+#endif
@@ -1,9 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <signal.h>
 #include <time.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <sys/mman.h>
 
 #define PROCESS_LIFE 20
 
@@ -32,7 +34,50 @@ void set_signal_handlers() {
     signal(SIGINT, stop_handler);
 }
 
+char *memory = NULL; // the job's block of the dispatcher's memory arena
+long memory_size = 0;
+long touched = 0;     // bytes of it used so far
+
+/* Maps "<fd>:<offset>:<length>" of a file the dispatcher left open */
+void map_memory(const char *spec) {
+	int fd;
+	long offset;
+	if (sscanf(spec, "%d:%ld:%ld", &fd, &offset, &memory_size) != 3 || memory_size <= 0) return;
+	memory = mmap(NULL, memory_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+	if (memory == MAP_FAILED) {
+		perror("mmap");
+		memory = NULL;
+	}
+	close(fd);
+}
+
+/* Writes to the next share of the job's memory, so that by the end of
+   its life every page of it has been touched */
+void use_memory() {
+	long page = sysconf(_SC_PAGESIZE);
+	long until = touched + (memory_size + PROCESS_LIFE - 1) / PROCESS_LIFE;
+	if (memory == NULL) return;
+	if (until > memory_size) until = memory_size;
+	for (; touched < until; touched += page) memory[touched] = 1;
+}
+
+/* Pool workers are started as "process --park <fd>" and block until the
+   dispatcher writes to fd, "g" to go or "m<fd>:<offset>:<length>" to go
+   with memory. If the pipe is closed instead the worker was never
+   needed and just exits. Others may be given "--memory <spec>" */
+void wait_until_bound(int argc, char **argv) {
+	char go[64];
+	if (argc >= 3 && strcmp(argv[1], "--memory") == 0) map_memory(argv[2]);
+	if (argc < 3 || strcmp(argv[1], "--park") != 0) return;
+	ssize_t n = read(atoi(argv[2]), go, sizeof(go) - 1);
+	if (n < 1) exit(0);
+	go[n] = '\0';
+	if (go[0] == 'm') map_memory(go + 1);
+}
+
 int main(int argc, char **argv) {
+	wait_until_bound(argc, argv);
+	setvbuf(stdout, NULL, _IOLBF, 0); // keep lines in order with the dispatcher
 	srand(time(NULL));
 	int life = PROCESS_LIFE;
 	//int r = rand() % 10000; // between 0 and 10000
@@ -41,6 +86,7 @@ int main(int argc, char **argv) {
 	while (life > 0) {
 		set_signal_handlers();
     	printf("Process %d is doing some processing...\n", getpid());
+    	use_memory();
     	sleep(1); 
     	life --;
 	}
@@ -1,95 +1,164 @@
 #include "hostd.h"
+#include "log.h"
+#include "jobtable.h"
 
+#define NEXT(slot) head->jobs->next[slot] // in the table of the queue at hand
 
 /* Create a new queue */
-Queue* initQueue() {
+Queue* initQueue(JobTable *jobs) {
   Queue* newQueue = malloc(sizeof(Queue));
   assert(newQueue != NULL); //ensure malloc worked
 
+  newQueue->jobs = jobs;
   newQueue->process = NULL;
-  newQueue->next = NULL;
+  newQueue->head = JOB_NO_SLOT;
+  newQueue->tail = JOB_NO_SLOT;
+  newQueue->length = 0;
 
   return newQueue;
-} 
+}
 
-/* Walks through the queue freeing each queue element
-as well as the process pointed to by that element */
+/* Walks through the queue freeing every job in it */
 void deleteQueue(Queue *head) {
-    while(head != NULL) {
-        // store the next item before freeing current one
-        Queue *temp = head->next;
-        free(head->process);
-        free(head);
-        head = temp; //move to next element
+    if (head == NULL) return;
+    int slot = head->head;
+    while (slot != JOB_NO_SLOT) {
+        // store the next item before releasing current one
+        int next = NEXT(slot);
+        NEXT(slot) = JOB_UNLINKED;
+        freeJob(head->jobs, jobAt(head->jobs, slot));
+        slot = next; //move to next element
     }
+    free(head);
 }
 
 /* Adds an element to the back of the queue */
 void enqueueJob(Queue *head, PCB *newJob) {
+  int slot = newJob->slot;
+  assert(NEXT(slot) == JOB_UNLINKED); // a job is only ever in one queue
+  NEXT(slot) = JOB_NO_SLOT;
+
   // if this is the first element
-  if (head->process == NULL) {
+  if (head->tail == JOB_NO_SLOT) {
+      head->head = slot;
       head->process = newJob;
   }
   else {
-      Queue *newQueueEntry = initQueue(); // make new queue entry first
-      newQueueEntry->process = newJob; // set the job
-      // walk through queue and insert the job at the end.
-      while (head->next != NULL) {
-          head = head->next;
-      }
-
-      head->next = newQueueEntry;
+      NEXT(head->tail) = slot;
+  }
+  head->tail = slot;
+  head->length++;
+}
+
+/* Adds an element to the front of the queue */
+void pushFront(Queue *head, PCB *job) {
+  assert(NEXT(job->slot) == JOB_UNLINKED);
+  NEXT(job->slot) = head->head;
+  head->head = job->slot;
+  head->process = job;
+  if (head->tail == JOB_NO_SLOT) head->tail = job->slot;
+  head->length++;
+}
+
+/* Adds a job behind every job arriving no later than it, so a queue
+   kept this way stays in arrival order. Jobs mostly come in order, and
+   those go on the back without a walk */
+void insertByArrival(Queue *head, PCB *job) {
+  if (head->tail == JOB_NO_SLOT || jobAt(head->jobs, head->tail)->arrival_time <= job->arrival_time) {
+    enqueueJob(head, job);
+    return;
+  }
+  if (job->arrival_time < head->process->arrival_time) {
+    pushFront(head, job);
+    return;
   }
+  int prev = head->head;
+  while (jobAt(head->jobs, NEXT(prev))->arrival_time <= job->arrival_time) prev = NEXT(prev);
+  assert(NEXT(job->slot) == JOB_UNLINKED);
+  NEXT(job->slot) = NEXT(prev);
+  NEXT(prev) = job->slot;
+  head->length++;
 }
 
-/* Removes and returns the first job in the queue. 
-  From there it can either be used or freed by the caller
-  NOTE: If only 1 queue element left, it should not be freed.*/
+/* Removes and returns the first job in the queue.
+  From there it can either be used or freed by the caller.
+  Returns NULL if the queue is empty */
 PCB* dequeueFront(Queue **headPointer) {
     Queue *head = *headPointer;
     assert(head != NULL);
-    // Create a pointer to the process so its reference can be returned.
     PCB *job = head->process;
+    if (job == NULL) return NULL;
 
-    // if there is a process stored here return it
-    // otherwise we don't want to delete the only element in the list
-    if (head->next != NULL) {
-        *headPointer = head->next;
-        free(head);
-       
+    head->head = NEXT(job->slot);
+    if (head->head == JOB_NO_SLOT) {
+      // this was the last element in the queue
+      head->tail = JOB_NO_SLOT;
+      head->process = NULL;
     }
     else {
-      // this is the last element in the queue so just make the job null
-        head->process = NULL;
+      head->process = jobAt(head->jobs, head->head);
     }
+    head->length--;
+    NEXT(job->slot) = JOB_UNLINKED;
 
     return job;
 }
 
-/* Prints out the given queue with select data*/
+/* The job at the back of the queue, NULL if it is empty */
+PCB* lastJob(Queue *head) {
+  return (head->tail == JOB_NO_SLOT) ? NULL : jobAt(head->jobs, head->tail);
+}
+
+/* The job queued behind job, NULL if it is the last one */
+PCB* nextInQueue(Queue *head, PCB *job) {
+  int next = NEXT(job->slot);
+  return (next == JOB_NO_SLOT) ? NULL : jobAt(head->jobs, next);
+}
+
+static void printHeader(const JobTable *t, char *qName) {
+    LOG(LOG_QUIET, "\n%s CONTENTS =========================\n"
+        "PID ARV_TIME TIME_LEFT  MEM   RESOURCES(%s)\n", LOG_STR(qName), LOG_STR(t->initials));
+}
+
+static void printJob(const JobTable *t, PCB *job) {
+    LOG(LOG_QUIET, "%d     %t         %t      %d      (",
+        (int)job->pid, job->arrival_time, job->time_left, job->mem_req);
+    int i;
+    for (i = 0; i < t->numResources; i++) {
+        LOG(LOG_QUIET, i == 0 ? "%d" : ",%d", job->resources[i]);
+    }
+    LOG(LOG_QUIET, ")\n");
+}
+
+/* Logs the given queue with select data. Callers check the log level
+   first since this walks the whole queue */
 void printQueue(char *qName, Queue *head) {
+   printHeader(head->jobs, qName);
+   int slot;
+   for (slot = head->head; slot != JOB_NO_SLOT; slot = NEXT(slot)) {
+      printJob(head->jobs, jobAt(head->jobs, slot));
+   }
+   LOG(LOG_QUIET, "==================================================\n\n");
+}
 
-    printf("\n%s CONTENTS =========================\n", qName);
-    printf("PID ARV_TIME TIME_LEFT  MEM   RESOURCES(P,S,M,C)\n");
-    
-   while (head->process != NULL) {
-      pid_t pid = head->process->pid;
-      int arrTime = head->process->arrival_time;
-      int timeRem = head->process->time_left;
-      int mem = head->process->mem_req;
-      int p = head->process->printers;
-      int s = head->process->scanners;
-      int m = head->process->modems;
-      int c = head->process->cds;
-
-      printf("%d     %d         %d      %d      (%d,%d,%d,%d)\n",
-          pid, arrTime, timeRem, mem, p,s,m,c);
-      if (head->next == NULL)
-          break;
-      else
-          head = head->next;
-   } 
-   printf("==================================================\n\n");
+/* Same as printQueue for jobs kept in an array */
+void printJobs(const JobTable *t, char *qName, PCB **jobs, int count) {
+   printHeader(t, qName);
+   int i;
+   for (i = 0; i < count; i++) {
+      printJob(t, jobs[i]);
+   }
+   LOG(LOG_QUIET, "==================================================\n\n");
+}
+
+/* Same as printQueue for jobs kept by slot */
+void printSlots(const JobTable *t, char *qName, const int *slots, int count) {
+   printHeader(t, qName);
+   int i;
+   for (i = 0; i < count; i++) {
+      printJob(t, jobAt(t, slots[i]));
+   }
+   LOG(LOG_QUIET, "==================================================\n\n");
 }
 
 bool isEmpty(Queue *head) {
@@ -102,15 +171,26 @@ bool isEmpty(Queue *head) {
 /* Returns length of queue */
 int getLength(Queue *head){
   if(head==NULL) return 0;
-  int length = 1;
+  return head->length;
+}
 
-  while (head->process != NULL) {
-    if (head->next == NULL)
-	     return length;
-    else {
-        head = head->next;
-	     length++;
-    }
-  } 
-  return length;
+/* Unlinks a specific job from anywhere in the queue without freeing it.
+   This walks the queue so it is only meant for rare events.
+   Returns false if the job is not in the queue */
+bool removeJob(Queue *head, PCB *job) {
+  int prev = JOB_NO_SLOT;
+  int slot = head->head;
+  while (slot != JOB_NO_SLOT && slot != job->slot) {
+    prev = slot;
+    slot = NEXT(slot);
+  }
+  if (slot == JOB_NO_SLOT) return false;
+
+  if (prev == JOB_NO_SLOT) head->head = NEXT(slot);
+  else NEXT(prev) = NEXT(slot);
+  if (head->tail == slot) head->tail = prev;
+  head->process = (head->head != JOB_NO_SLOT) ? jobAt(head->jobs, head->head) : NULL;
+  head->length--;
+  NEXT(slot) = JOB_UNLINKED;
+  return true;
 }
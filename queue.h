@@ -1,9 +1,17 @@
 // Add all queue function prototypes here
+#include "jobtable.h"
 
-Queue* initQueue();
+Queue* initQueue(JobTable *jobs);
 void deleteQueue(Queue *head);
 void enqueueJob(Queue *head, PCB *newJob);
+void pushFront(Queue *head, PCB *job);
+void insertByArrival(Queue *head, PCB *job);
 PCB* dequeueFront(Queue **headPointer);
+PCB* lastJob(Queue *head);
+PCB* nextInQueue(Queue *head, PCB *job);
 void printQueue(char *qName, Queue *head);
+void printJobs(const JobTable *t, char *qName, PCB **jobs, int count);
+void printSlots(const JobTable *t, char *qName, const int *slots, int count);
 bool isEmpty(Queue *head); 
 int getLength(Queue *head);
+bool removeJob(Queue *head, PCB *job);
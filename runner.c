@@ -0,0 +1,100 @@
+#include "hostd.h"
+#include <spawn.h>
+#include <fcntl.h>
+#include "runner.h"
+
+extern char **environ;
+
+/* Reads fd from where it is to the end into a malloc'd string */
+char* readAll(int fd) {
+  size_t cap = 4096, len = 0;
+  char *text = malloc(cap);
+  assert(text != NULL);
+  ssize_t n;
+  while ((n = read(fd, text + len, cap - len - 1)) > 0) {
+    len += n;
+    if (len + 1 == cap) {
+      cap *= 2;
+      text = realloc(text, cap);
+      assert(text != NULL);
+    }
+  }
+  text[len] = '\0';
+  return text;
+}
+
+/* Runs argv and returns what it wrote to stderr in a malloc'd string,
+   and its stdout too unless that goes to outFd (outFd < 0 to keep it).
+   Returns NULL if the program could not be started. With exitedOk it is
+   told whether the program succeeded, without it a program that failed
+   also gives NULL. Uses posix_spawn, so threads may run programs at once */
+char* runProgram(char **argv, int outFd, bool *exitedOk) {
+  int err[2];
+  if (pipe2(err, O_CLOEXEC) < 0) return NULL;
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, outFd >= 0 ? outFd : err[1], STDOUT_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, err[1], STDERR_FILENO);
+  pid_t pid;
+  int failed = posix_spawn(&pid, argv[0], &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  close(err[1]);
+  if (failed != 0) {
+    close(err[0]);
+    return NULL;
+  }
+
+  char *text = readAll(err[0]);
+  close(err[0]);
+  int status;
+  waitpid(pid, &status, 0);
+  bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  if (exitedOk != NULL) {
+    *exitedOk = ok;
+  } else if (!ok) {
+    free(text);
+    return NULL;
+  }
+  return text;
+}
+
+/* Splits words (in place) on spaces and appends them to argv, leaving
+   room within maxArgs for one more argument and the NULL. Words that
+   do not fit are dropped, see countWords. Returns the new argc */
+int appendWords(char **argv, int argc, int maxArgs, char *words) {
+  char *save, *w;
+  for (w = strtok_r(words, " ", &save); w != NULL && argc < maxArgs - 2;
+       w = strtok_r(NULL, " ", &save)) {
+    argv[argc++] = w;
+  }
+  argv[argc] = NULL;
+  return argc;
+}
+
+/* How many words appendWords would find in words */
+int countWords(const char *words) {
+  int n = 0;
+  while (*words) {
+    while (*words == ' ') words++;
+    if (*words == '\0') break;
+    n++;
+    while (*words && *words != ' ') words++;
+  }
+  return n;
+}
+
+/* Finds the "<cls> <metric>" row of the job metrics table */
+bool parseMetric(const char *text, const char *cls, const char *metric, MetricRow *row) {
+  char prefix[32];
+  snprintf(prefix, sizeof(prefix), "\n%s ", cls);
+  const char *p;
+  for (p = strstr(text, prefix); p != NULL; p = strstr(p + 1, prefix)) {
+    char name[32];
+    if (sscanf(p + strlen(prefix), "%31s %lf %lf %lf %lf %lf %lf", name, &row->jobs,
+               &row->p50, &row->p95, &row->p99, &row->mean, &row->max) == 7 &&
+        strcmp(name, metric) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
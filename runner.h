@@ -0,0 +1,20 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include <stdbool.h>
+
+/* What hostd-bench and hostd-sweep share for running hostd and reading
+   what it printed */
+
+/* The columns of one row of hostd's job metrics table */
+typedef struct metricRow {
+  double jobs, p50, p95, p99, mean, max;
+} MetricRow;
+
+char* readAll(int fd);
+char* runProgram(char **argv, int outFd, bool *exitedOk);
+int appendWords(char **argv, int argc, int maxArgs, char *words);
+int countWords(const char *words);
+bool parseMetric(const char *text, const char *cls, const char *metric, MetricRow *row);
+
+#endif
@@ -0,0 +1,552 @@
+#include "sched.h"
+#include "queue.h"
+#include "log.h"
+#include "trace.h"
+#include "checkpoint.h"
+#include "jobtable.h"
+
+/* The user job scheduling policies hostd can run. Each keeps its own
+   waiting jobs. The dispatcher takes a job out with pickNext, runs it
+   for slice ticks and hands it back through expire if it has not
+   finished, so a job on a cpu belongs to no policy structure */
+
+/* Adds the time since the job was queued to its wait at that level */
+void chargeWait(PCB *job, int level, int now) {
+  job->level_wait[level] += now - job->queued_at;
+  traceEvent(TRACE_QUEUE_WAIT, job->queued_at, now, -1, level, job);
+}
+
+/* Puts a job at the back of a queue and starts its wait there */
+static void queueJob(Queue *q, PCB *job, int now) {
+  job->queued_at = now;
+  enqueueJob(q, job);
+}
+
+/* Growable array of jobs, used by the policies that don't keep a FIFO */
+typedef struct jobArray {
+  PCB **jobs;
+  int size;
+  int capacity;
+} JobArray;
+
+static void pushJob(JobArray *a, PCB *job) {
+  if (a->size == a->capacity) {
+    a->capacity = a->capacity ? a->capacity * 2 : 64;
+    a->jobs = realloc(a->jobs, a->capacity * sizeof(PCB *));
+    assert(a->jobs != NULL);
+  }
+  a->jobs[a->size++] = job;
+}
+
+static int findJob(JobArray *a, PCB *job) {
+  int i;
+  for (i = 0; i < a->size; i++) {
+    if (a->jobs[i] == job) return i;
+  }
+  return -1;
+}
+
+/* Appends the jobs written by saveJobs, keeping their order */
+static bool loadJobs(FILE *f, JobTable *t, JobArray *a) {
+  int count, i;
+  if (!LOAD(f, count) || count < 0) return false;
+  for (i = 0; i < count; i++) {
+    PCB *job = loadJob(f, t);
+    if (job == NULL) return false;
+    pushJob(a, job);
+  }
+  return true;
+}
+
+static void freeJobs(JobTable *t, JobArray *a) {
+  int i;
+  for (i = 0; i < a->size; i++) freeJob(t, a->jobs[i]);
+  free(a->jobs);
+  memset(a, 0, sizeof(*a));
+}
+
+/* Everything one dispatcher's policy keeps. Each policy only uses its
+   own part, the rest stays zero */
+struct sched {
+  JobTable *jobs;              // the dispatcher's, where its waiting jobs are
+  // mlfq
+  Queue *levels[SCHED_LEVELS]; // 1-3 used
+  int quantumTicks[SCHED_LEVELS];
+  int boostTicks, ageTicks;    // 0 turns boosting or aging off
+  int nextBoost;               // time of the next priority boost
+  // fcfs, sjf and srtf
+  Queue *readyQ;
+  SlotArray shortest;
+  int classCount[SCHED_LEVELS]; // waiting jobs by priority, for stats
+  int srtfQuantum;              // ticks between srtf re-evaluations
+  // lottery
+  JobArray pools[SCHED_LEVELS]; // waiting jobs by priority
+  int lotteryQuantum;
+  uint64_t lotteryState;
+};
+
+static Sched* newSched(JobTable *jobs) {
+  Sched *s = calloc(1, sizeof(Sched));
+  assert(s != NULL);
+  s->jobs = jobs;
+  return s;
+}
+
+/* ---- mlfq: the p1Q/p2Q/p3Q feedback queues ---- */
+
+static char *levelNames[SCHED_LEVELS] = {
+  NULL, "PRIORITY 1 QUEUE", "PRIORITY 2 QUEUE", "PRIORITY 3 QUEUE"
+};
+
+static Sched* mlfqInit(const FeedbackConfig *f, int tickMillis, JobTable *jobs) {
+  Sched *s = newSched(jobs);
+  int l;
+  for (l = 1; l < SCHED_LEVELS; l++) {
+    s->levels[l] = initQueue(jobs);
+    s->quantumTicks[l] = f->quantum[l - 1] / tickMillis;
+  }
+  s->boostTicks = f->boostEvery / tickMillis;
+  s->ageTicks = f->ageAfter / tickMillis;
+  s->nextBoost = s->boostTicks;
+  return s;
+}
+
+static void mlfqArrive(Sched *s, PCB *job, int now) {
+  queueJob(s->levels[job->priority], job, now);
+}
+
+static PCB* mlfqPickNext(Sched *s, int *level) {
+  int l;
+  for (l = 1; l < SCHED_LEVELS; l++) {
+    if (!isEmpty(s->levels[l])) {
+      *level = l;
+      return dequeueFront(&s->levels[l]);
+    }
+  }
+  return NULL;
+}
+
+/* A job gets what is left of the quantum of its level */
+static int mlfqSlice(Sched *s, PCB *job, int level) {
+  return s->quantumTicks[level] - job->level_used;
+}
+
+/* Moves the job down a level once it has used its whole quantum there.
+   p3Q is round robin. A job boosted mid slice may still have quantum
+   left at its new level and stays there */
+static int mlfqExpire(Sched *s, PCB *job, int level, int now) {
+  int next = level;
+  if (job->level_used >= s->quantumTicks[level]) {
+    job->level_used = 0;
+    if (next < SCHED_LEVELS - 1) next++;
+  }
+  queueJob(s->levels[next], job, now);
+  return next;
+}
+
+/* Back to the end of its own queue, keeping the quantum it has left */
+static void mlfqPreempted(Sched *s, PCB *job, int level, int now) {
+  queueJob(s->levels[level], job, now);
+}
+
+static bool mlfqRemove(Sched *s, PCB *job, int *level) {
+  int l;
+  for (l = 1; l < SCHED_LEVELS; l++) {
+    if (removeJob(s->levels[l], job)) {
+      *level = l;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Moves a waiting job to the back of another level with a fresh quantum */
+static void changeLevel(Sched *s, PCB *job, int from, int to, int now) {
+  chargeWait(job, from, now);
+  traceEvent(to < from ? TRACE_PROMOTE : TRACE_DEMOTE, now, now, -1, to, job);
+  job->level_used = 0;
+  queueJob(s->levels[to], job, now);
+}
+
+/* Priority boost: every user job below p1Q goes back to the end of
+   p1Q with a fresh quantum, so long jobs cannot starve behind a stream
+   of new arrivals. Jobs on a cpu move up when their slice ends.
+   Aging: a job that has waited ageTicks in p2Q or p3Q moves up a level.
+   Each level is in queueing order, so only the front needs checking.
+   p2Q goes first so a job just moved up from p3Q starts a fresh wait */
+static void mlfqTick(Sched *s, int now, Cpu *cpus, int numCpus) {
+  int l, i;
+  if (s->boostTicks > 0 && now >= s->nextBoost) {
+    for (l = 2; l < SCHED_LEVELS; l++) {
+      while (!isEmpty(s->levels[l])) changeLevel(s, dequeueFront(&s->levels[l]), l, 1, now);
+    }
+    for (i = 0; i < numCpus; i++) {
+      if (cpus[i].job != NULL && cpus[i].level > 1) {
+        traceEvent(TRACE_PROMOTE, now, now, i, 1, cpus[i].job);
+        cpus[i].job->level_used = 0;
+        cpus[i].level = 1;
+      }
+    }
+    LOG(LOG_DEBUG, "Boosted all user jobs to %s.\n", LOG_STR(levelNames[1]));
+    s->nextBoost = (now / s->boostTicks + 1) * s->boostTicks;
+  }
+  if (s->ageTicks > 0) {
+    for (l = 2; l < SCHED_LEVELS; l++) {
+      while (!isEmpty(s->levels[l]) && now - s->levels[l]->process->queued_at >= s->ageTicks) {
+        changeLevel(s, dequeueFront(&s->levels[l]), l, l - 1, now);
+      }
+    }
+  }
+}
+
+/* A boost is woken up for while any user job holds resources, so no
+   boost that would have changed anything is skipped. Aging wakes up for
+   the queue front that is due first */
+static int mlfqNextWakeup(Sched *s, int now, Cpu *cpus, int numCpus) {
+  int due = -1, l, i;
+  if (s->boostTicks > 0) {
+    bool userJobs = false;
+    for (l = 1; l < SCHED_LEVELS && !userJobs; l++) userJobs = !isEmpty(s->levels[l]);
+    for (i = 0; i < numCpus && !userJobs; i++) {
+      userJobs = cpus[i].job != NULL && cpus[i].level > 0;
+    }
+    if (userJobs) due = s->nextBoost;
+  }
+  if (s->ageTicks > 0) {
+    for (l = 2; l < SCHED_LEVELS; l++) {
+      int t = isEmpty(s->levels[l]) ? -1 : s->levels[l]->process->queued_at + s->ageTicks;
+      if (t >= 0 && (due < 0 || t < due)) due = t;
+    }
+  }
+  return due;
+}
+
+static int mlfqWaiting(Sched *s, int level) {
+  return getLength(s->levels[level]);
+}
+
+static void mlfqPrint(Sched *s) {
+  int l;
+  for (l = 1; l < SCHED_LEVELS; l++) printQueue(levelNames[l], s->levels[l]);
+}
+
+static void mlfqDestroy(Sched *s) {
+  int l;
+  for (l = 1; l < SCHED_LEVELS; l++) {
+    deleteQueue(s->levels[l]);
+  }
+  free(s);
+}
+
+static void mlfqSave(Sched *s, FILE *f) {
+  int l;
+  SAVE(f, s->nextBoost);
+  for (l = 1; l < SCHED_LEVELS; l++) saveQueue(f, s->levels[l]);
+}
+
+static bool mlfqLoad(Sched *s, FILE *f) {
+  int l;
+  if (!LOAD(f, s->nextBoost)) return false;
+  for (l = 1; l < SCHED_LEVELS; l++) {
+    if (!loadQueue(f, s->levels[l])) return false;
+  }
+  return true;
+}
+
+/* ---- fcfs: one queue in the order jobs got their resources ---- */
+
+static Sched* fcfsInit(const FeedbackConfig *f, int tickMillis, JobTable *jobs) {
+  Sched *s = newSched(jobs);
+  s->readyQ = initQueue(jobs);
+  return s;
+}
+
+static void fcfsArrive(Sched *s, PCB *job, int now) {
+  queueJob(s->readyQ, job, now);
+  s->classCount[job->priority]++;
+}
+
+static PCB* fcfsPickNext(Sched *s, int *level) {
+  if (isEmpty(s->readyQ)) return NULL;
+  PCB *job = dequeueFront(&s->readyQ);
+  s->classCount[job->priority]--;
+  *level = job->priority;
+  return job;
+}
+
+/* Jobs run to completion */
+static int runToCompletion(Sched *s, PCB *job, int level) {
+  return job->time_left;
+}
+
+/* A job that lost its cpu keeps its place at the head of the line */
+static void fcfsPreempted(Sched *s, PCB *job, int level, int now) {
+  job->queued_at = now;
+  pushFront(s->readyQ, job);
+  s->classCount[job->priority]++;
+}
+
+static int fcfsExpire(Sched *s, PCB *job, int level, int now) {
+  fcfsPreempted(s, job, level, now);
+  return level;
+}
+
+static bool fcfsRemove(Sched *s, PCB *job, int *level) {
+  if (!removeJob(s->readyQ, job)) return false;
+  s->classCount[job->priority]--;
+  *level = job->priority;
+  return true;
+}
+
+static int classWaiting(Sched *s, int level) {
+  return s->classCount[level];
+}
+
+static void fcfsPrint(Sched *s) {
+  printQueue("READY QUEUE (FCFS)", s->readyQ);
+}
+
+static void fcfsDestroy(Sched *s) {
+  deleteQueue(s->readyQ);
+  free(s);
+}
+
+static void fcfsSave(Sched *s, FILE *f) {
+  saveQueue(f, s->readyQ);
+}
+
+static bool fcfsLoad(Sched *s, FILE *f) {
+  if (!loadQueue(f, s->readyQ)) return false;
+  PCB *job;
+  for (job = s->readyQ->process; job != NULL; job = nextInQueue(s->readyQ, job)) s->classCount[job->priority]++;
+  return true;
+}
+
+/* ---- sjf and srtf: a min-heap on time_left ---- */
+
+/* The heap holds slots and compares the job table's copies of
+   time_left and id, so sifting never touches a PCB */
+static bool shorter(const JobTable *t, int a, int b) {
+  const int *left = t->timeLeft, *id = t->id;
+  return left[a] < left[b] || (left[a] == left[b] && id[a] < id[b]);
+}
+
+static void siftUp(Sched *s, int i) {
+  int *h = s->shortest.slots, slot = h[i];
+  while (i > 0 && shorter(s->jobs, slot, h[(i - 1) / 2])) {
+    h[i] = h[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  h[i] = slot;
+}
+
+static void siftDown(Sched *s, int i) {
+  int *h = s->shortest.slots, slot = h[i];
+  while (1) {
+    int child = 2 * i + 1;
+    if (child >= s->shortest.size) break;
+    if (child + 1 < s->shortest.size && shorter(s->jobs, h[child + 1], h[child])) child++;
+    if (!shorter(s->jobs, h[child], slot)) break;
+    h[i] = h[child];
+    i = child;
+  }
+  h[i] = slot;
+}
+
+static Sched* shortestInit(const FeedbackConfig *f, int tickMillis, JobTable *jobs) {
+  Sched *s = newSched(jobs);
+  s->srtfQuantum = f->quantum[0] / tickMillis;
+  return s;
+}
+
+static void shortestArrive(Sched *s, PCB *job, int now) {
+  job->queued_at = now;
+  pushSlot(&s->shortest, job->slot);
+  siftUp(s, s->shortest.size - 1);
+  s->classCount[job->priority]++;
+}
+
+static PCB* shortestPickNext(Sched *s, int *level) {
+  if (s->shortest.size == 0) return NULL;
+  PCB *job = jobAt(s->jobs, s->shortest.slots[0]);
+  s->shortest.slots[0] = s->shortest.slots[--s->shortest.size];
+  if (s->shortest.size > 0) siftDown(s, 0);
+  s->classCount[job->priority]--;
+  *level = job->priority;
+  return job;
+}
+
+/* srtf gives up the cpu every quantum (the p1Q one) so a shorter job
+   that arrived meanwhile gets it next */
+static int srtfSlice(Sched *s, PCB *job, int level) {
+  return s->srtfQuantum;
+}
+
+static int shortestExpire(Sched *s, PCB *job, int level, int now) {
+  shortestArrive(s, job, now);
+  return level;
+}
+
+static void shortestPreempted(Sched *s, PCB *job, int level, int now) {
+  shortestArrive(s, job, now);
+}
+
+static bool shortestRemove(Sched *s, PCB *job, int *level) {
+  int i = findSlot(&s->shortest, job->slot);
+  if (i < 0) return false;
+  s->shortest.slots[i] = s->shortest.slots[--s->shortest.size];
+  if (i < s->shortest.size) {
+    siftUp(s, i);
+    siftDown(s, i);
+  }
+  s->classCount[job->priority]--;
+  *level = job->priority;
+  return true;
+}
+
+static void shortestPrint(Sched *s) {
+  printSlots(s->jobs, "READY HEAP (SHORTEST FIRST, HEAP ORDER)", s->shortest.slots, s->shortest.size);
+}
+
+static void shortestDestroy(Sched *s) {
+  freeSlots(s->jobs, &s->shortest);
+  free(s);
+}
+
+static void shortestSave(Sched *s, FILE *f) {
+  saveSlots(f, s->jobs, s->shortest.slots, s->shortest.size);
+}
+
+/* The jobs come back in heap order, so no sifting is needed */
+static bool shortestLoad(Sched *s, FILE *f) {
+  if (!loadSlots(f, s->jobs, &s->shortest.slots, &s->shortest.size)) return false;
+  s->shortest.capacity = s->shortest.size;
+  int i;
+  for (i = 0; i < s->shortest.size; i++) s->classCount[s->jobs->priority[s->shortest.slots[i]]]++;
+  return true;
+}
+
+/* ---- lottery: each quantum goes to a random ticket ---- */
+
+static const int tickets[SCHED_LEVELS] = {0, 4, 2, 1}; // per job of each priority
+
+/* xorshift64*, seeded the same every run so replays are repeatable */
+static uint64_t draw(Sched *s) {
+  s->lotteryState ^= s->lotteryState >> 12;
+  s->lotteryState ^= s->lotteryState << 25;
+  s->lotteryState ^= s->lotteryState >> 27;
+  return s->lotteryState * 2685821657736338717ULL;
+}
+
+static Sched* lotteryInit(const FeedbackConfig *f, int tickMillis, JobTable *jobs) {
+  Sched *s = newSched(jobs);
+  s->lotteryQuantum = f->quantum[0] / tickMillis;
+  s->lotteryState = 88172645463325252ULL;
+  return s;
+}
+
+static void lotteryArrive(Sched *s, PCB *job, int now) {
+  job->queued_at = now;
+  pushJob(&s->pools[job->priority], job);
+}
+
+/* Draws a ticket out of every waiting job's tickets. Jobs of the same
+   priority hold the same number, so the priority is drawn first and
+   then a job within it, which keeps the draw O(1) */
+static PCB* lotteryPickNext(Sched *s, int *level) {
+  long total = 0;
+  int l;
+  for (l = 1; l < SCHED_LEVELS; l++) total += (long)s->pools[l].size * tickets[l];
+  if (total == 0) return NULL;
+
+  long ticket = draw(s) % total;
+  for (l = 1; l < SCHED_LEVELS; l++) {
+    long held = (long)s->pools[l].size * tickets[l];
+    if (ticket < held) break;
+    ticket -= held;
+  }
+  JobArray *pool = &s->pools[l];
+  int i = ticket / tickets[l];
+  PCB *job = pool->jobs[i];
+  pool->jobs[i] = pool->jobs[--pool->size];
+  *level = l;
+  return job;
+}
+
+static int lotterySlice(Sched *s, PCB *job, int level) {
+  return s->lotteryQuantum;
+}
+
+static int lotteryExpire(Sched *s, PCB *job, int level, int now) {
+  lotteryArrive(s, job, now);
+  return level;
+}
+
+static void lotteryPreempted(Sched *s, PCB *job, int level, int now) {
+  lotteryArrive(s, job, now);
+}
+
+static bool lotteryRemove(Sched *s, PCB *job, int *level) {
+  JobArray *pool = &s->pools[job->priority];
+  int i = findJob(pool, job);
+  if (i < 0) return false;
+  pool->jobs[i] = pool->jobs[--pool->size];
+  *level = job->priority;
+  return true;
+}
+
+static int lotteryWaiting(Sched *s, int level) {
+  return s->pools[level].size;
+}
+
+static void lotteryPrint(Sched *s) {
+  int l;
+  for (l = 1; l < SCHED_LEVELS; l++) printJobs(s->jobs, levelNames[l], s->pools[l].jobs, s->pools[l].size);
+}
+
+static void lotteryDestroy(Sched *s) {
+  int l;
+  for (l = 1; l < SCHED_LEVELS; l++) freeJobs(s->jobs, &s->pools[l]);
+  free(s);
+}
+
+/* The draw state goes along so a restored run draws the same tickets */
+static void lotterySave(Sched *s, FILE *f) {
+  int l;
+  SAVE(f, s->lotteryState);
+  for (l = 1; l < SCHED_LEVELS; l++) saveJobs(f, s->pools[l].jobs, s->pools[l].size);
+}
+
+static bool lotteryLoad(Sched *s, FILE *f) {
+  int l;
+  if (!LOAD(f, s->lotteryState)) return false;
+  for (l = 1; l < SCHED_LEVELS; l++) {
+    if (!loadJobs(f, s->jobs, &s->pools[l])) return false;
+  }
+  return true;
+}
+
+static const SchedPolicy policies[] = {
+  {"mlfq", mlfqInit, mlfqArrive, mlfqPickNext, mlfqSlice, mlfqExpire, mlfqPreempted,
+    mlfqRemove, mlfqTick, mlfqNextWakeup, mlfqWaiting, mlfqPrint, mlfqDestroy, mlfqSave, mlfqLoad},
+  {"fcfs", fcfsInit, fcfsArrive, fcfsPickNext, runToCompletion, fcfsExpire, fcfsPreempted,
+    fcfsRemove, NULL, NULL, classWaiting, fcfsPrint, fcfsDestroy, fcfsSave, fcfsLoad},
+  {"sjf", shortestInit, shortestArrive, shortestPickNext, runToCompletion, shortestExpire,
+    shortestPreempted, shortestRemove, NULL, NULL, classWaiting, shortestPrint, shortestDestroy,
+    shortestSave, shortestLoad},
+  {"srtf", shortestInit, shortestArrive, shortestPickNext, srtfSlice, shortestExpire,
+    shortestPreempted, shortestRemove, NULL, NULL, classWaiting, shortestPrint, shortestDestroy,
+    shortestSave, shortestLoad},
+  {"lottery", lotteryInit, lotteryArrive, lotteryPickNext, lotterySlice, lotteryExpire,
+    lotteryPreempted, lotteryRemove, NULL, NULL, lotteryWaiting, lotteryPrint, lotteryDestroy,
+    lotterySave, lotteryLoad},
+};
+
+/* Returns the policy called name, or NULL if there is none */
+const SchedPolicy* findSchedPolicy(const char *name) {
+  int i;
+  for (i = 0; i < (int)(sizeof(policies) / sizeof(policies[0])); i++) {
+    if (strcmp(policies[i].name, name) == 0) return &policies[i];
+  }
+  return NULL;
+}
@@ -0,0 +1,42 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "hostd.h"
+#include "feedback.h"
+#include "jobtable.h"
+
+#define SCHED_LEVELS 4 // level 0 is realtime, 1-3 are where user jobs wait
+
+/* How user jobs share the cpus once they have their resources. Realtime
+   jobs are not part of it, they always go first and run to completion.
+   A job's level is where it waits (1-3). Waits, traces and realtime
+   preemption go by it, policies without levels use the job's priority.
+   Times are in dispatcher ticks. tick and nextWakeup may be NULL.
+   save and load keep the waiting jobs in their exact order, so a
+   restored dispatcher picks the same jobs next.
+   A policy's waiting jobs and state are a Sched made by init, one per
+   dispatcher, so any number of dispatchers can run the same policy */
+typedef struct sched Sched;
+
+typedef struct schedPolicy {
+  const char *name;
+  Sched* (*init)(const FeedbackConfig *f, int tickMillis, JobTable *jobs);
+  void (*arrive)(Sched *s, PCB *job, int now);               // job just got its resources
+  PCB* (*pickNext)(Sched *s, int *level);                    // takes the next job to run, NULL if none
+  int (*slice)(Sched *s, PCB *job, int level);               // ticks it may run before expire is called
+  int (*expire)(Sched *s, PCB *job, int level, int now);     // slice over, returns the level it now waits at
+  void (*preempted)(Sched *s, PCB *job, int level, int now); // its cpu was taken for realtime work
+  bool (*remove)(Sched *s, PCB *job, int *level);            // job exited while waiting
+  void (*tick)(Sched *s, int now, Cpu *cpus, int numCpus);   // once per dispatcher tick, before dispatching
+  int (*nextWakeup)(Sched *s, int now, Cpu *cpus, int numCpus); // when virtual time must wake up, -1 for never
+  int (*waiting)(Sched *s, int level);                       // jobs waiting at a level
+  void (*print)(Sched *s);                                   // logs the waiting jobs
+  void (*destroy)(Sched *s);                                 // frees the policy and every waiting job
+  void (*save)(Sched *s, FILE *f);                           // writes its waiting jobs and state to a checkpoint
+  bool (*load)(Sched *s, FILE *f);                           // reads them back right after init
+} SchedPolicy;
+
+const SchedPolicy* findSchedPolicy(const char *name);
+void chargeWait(PCB *job, int level, int now);
+
+#endif
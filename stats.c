@@ -0,0 +1,72 @@
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+static const char *queueKeys[STATS_QUEUES] = {"dispatch", "user", "rt", "p1", "p2", "p3"};
+
+static double microsOf(clockid_t clk) {
+  struct timespec ts;
+  clock_gettime(clk, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* Monotonic wall clock in microseconds */
+double statsNow() {
+  return microsOf(CLOCK_MONOTONIC);
+}
+
+void initStats(DispatchStats *s) {
+  memset(s, 0, sizeof(*s));
+  s->wallStart = statsNow();
+}
+
+void startTick(DispatchStats *s) {
+  s->tickStart = microsOf(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+/* Charges the cpu used since startTick and samples the queue lengths */
+void endTick(DispatchStats *s, const int lengths[STATS_QUEUES]) {
+  double used = microsOf(CLOCK_PROCESS_CPUTIME_ID) - s->tickStart;
+  s->ticks++;
+  s->tickCpuTotal += used;
+  if (used > s->tickCpuMax) s->tickCpuMax = used;
+
+  int i;
+  for (i = 0; i < STATS_QUEUES; i++) {
+    s->queueSum[i] += lengths[i];
+    if (lengths[i] > s->queueMax[i]) s->queueMax[i] = lengths[i];
+  }
+}
+
+/* Adds one allocator call that started at since (from statsNow) */
+void addAllocTime(DispatchStats *s, double since) {
+  s->allocCalls++;
+  s->allocTime += statsNow() - since;
+}
+
+void finishStats(DispatchStats *s) {
+  s->wallTime = statsNow() - s->wallStart;
+}
+
+/* Prints everything as one line of key=value pairs so it is easy to both
+   read and parse. Queue lengths are given as mean/max */
+void printStats(FILE *out, DispatchStats *s, int jobsCompleted, int simTime) {
+  long ticks = s->ticks ? s->ticks : 1;
+  double wallSecs = s->wallTime / 1e6;
+
+  fprintf(out, "stats ticks=%ld sim_s=%d wall_s=%.3f jobs=%d jobs_per_s=%.1f",
+      s->ticks, simTime, wallSecs, jobsCompleted,
+      wallSecs > 0 ? jobsCompleted / wallSecs : 0.0);
+  fprintf(out, " tick_cpu_us=%.2f tick_cpu_max_us=%.1f",
+      s->tickCpuTotal / ticks, s->tickCpuMax);
+  fprintf(out, " alloc_calls=%ld alloc_us=%.1f alloc_ns_per_call=%.1f",
+      s->allocCalls, s->allocTime,
+      s->allocCalls ? s->allocTime * 1000.0 / s->allocCalls : 0.0);
+  int i;
+  for (i = 0; i < STATS_QUEUES; i++) {
+    fprintf(out, " q_%s=%.1f/%d", queueKeys[i],
+        (double)s->queueSum[i] / ticks, s->queueMax[i]);
+  }
+  fprintf(out, "\n");
+  fflush(out);
+}
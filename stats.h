@@ -0,0 +1,33 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#define STATS_QUEUES 6 // dispatch, user, realtime, p1, p2, p3
+
+/* Counters the dispatcher keeps about itself when run with --stats.
+   Everything is cheap enough to collect each tick but is skipped
+   entirely when stats are off */
+typedef struct dispatchStats {
+  long ticks;               // dispatcher loop iterations
+  double tickCpuTotal;      // dispatcher cpu spent per iteration, in us
+  double tickCpuMax;
+  double tickStart;         // cpu time at the start of the current tick
+  long queueSum[STATS_QUEUES];
+  int queueMax[STATS_QUEUES];
+  long allocCalls;          // searches, claims, releases and fit checks
+  double allocTime;         // wall time inside the allocator, in us
+  double wallStart;
+  double wallTime;          // whole run, in us
+} DispatchStats;
+
+void initStats(DispatchStats *s);
+void startTick(DispatchStats *s);
+void endTick(DispatchStats *s, const int lengths[STATS_QUEUES]);
+double statsNow();
+void addAllocTime(DispatchStats *s, double since);
+void finishStats(DispatchStats *s);
+void printStats(FILE *out, DispatchStats *s, int jobsCompleted, int simTime);
+
+#endif
@@ -0,0 +1,154 @@
+#include "dispatcher.h"
+#include "dispatchlist.h"
+#include "log.h"
+#include "jobtable.h"
+#include <time.h>
+
+/* hostd-stepbench: times the scheduling core on its own. One dispatcher
+   per policy is built in this process, all replaying the same dispatch
+   list in virtual time with simulated jobs, and they take turns one
+   step at a time. Only stepDispatcher is timed, so the numbers are the
+   cost of the scheduling decisions with no processes, signals, logging
+   or list parsing in them */
+
+typedef struct runner {
+  Dispatcher d;
+  DispatchReader list;
+  int now;      // time of the next step
+  bool done;
+  bool stuck;   // jobs were left waiting with nothing to wake up for
+  long steps;
+  double nanos; // inside stepDispatcher
+  double maxNanos;
+} Runner;
+
+static double nowNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static bool startRunner(Runner *r, const char *path, const char *policy, int cpus, FitPolicy fit) {
+  memset(r, 0, sizeof(*r));
+  defaultDispatcher(&r->d);
+  r->d.policy = findSchedPolicy(policy);
+  r->d.numCpus = cpus;
+  r->d.fitPolicy = fit;
+  if (r->d.policy == NULL || !finishMachine(&r->d.machine)) return false;
+  if (!openDispatchList(&r->list, path)) return false;
+  r->list.resources = r->d.machine.numResources;
+  initDispatcher(&r->d);
+  r->list.jobs = &r->d.jobs;
+  return true;
+}
+
+/* Adds the list's jobs up to the first that arrives after now, the way
+   hostd streams them */
+static void feedRunner(Runner *r) {
+  Queue *q = r->d.dispatchQ;
+  while (isEmpty(q) || lastJob(q)->arrival_time <= r->now) {
+    PCB *job = readNextJob(&r->list);
+    if (job == NULL) break;
+    addJob(&r->d, job);
+  }
+}
+
+static void stepRunner(Runner *r) {
+  feedRunner(r);
+  double t = nowNanos();
+  stepDispatcher(&r->d, r->now);
+  t = nowNanos() - t;
+  r->nanos += t;
+  if (t > r->maxNanos) r->maxNanos = t;
+  r->steps++;
+
+  if (dispatcherIdle(&r->d)) {
+    r->done = true;
+    return;
+  }
+  r->now = nextEventTime(&r->d);
+  if (r->now < 0) r->done = r->stuck = true;
+}
+
+static void printStepUsage(char *name) {
+  printf("Usage: %s [options] <dispatch list>\n", name);
+  printf("  -S, --sched <a,b,...>  policies to run side by side (default mlfq,fcfs,sjf,srtf,lottery)\n");
+  printf("  -c, --cpus <n>         simulated cpus per dispatcher (default 1)\n");
+  printf("  -f, --fit <first|best|next>  memory placement policy (default first)\n");
+}
+
+int main(int argc, char **argv) {
+  char policies[256] = "mlfq,fcfs,sjf,srtf,lottery";
+  int cpus = 1;
+  FitPolicy fit = FIRST_FIT;
+
+  static struct option longOptions[] = {
+    {"sched", required_argument, NULL, 'S'},
+    {"cpus", required_argument, NULL, 'c'},
+    {"fit", required_argument, NULL, 'f'},
+    {NULL, 0, NULL, 0}
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "S:c:f:", longOptions, NULL)) != -1) {
+    switch (opt) {
+      case 'S': snprintf(policies, sizeof(policies), "%s", optarg); break;
+      case 'c': cpus = atoi(optarg); break;
+      case 'f':
+        if (!parseFitPolicy(optarg, &fit)) {
+          printf("Unknown fit policy %s (use first, best or next).\n", optarg);
+          return 1;
+        }
+        break;
+      default:
+        printStepUsage(argv[0]);
+        return 1;
+    }
+  }
+  if (optind >= argc || cpus < 1) {
+    printStepUsage(argv[0]);
+    return 1;
+  }
+  logLevel = LOG_QUIET; // the logger thread is never started
+
+  // a dispatcher must not move once it is set up, so the array is
+  // sized for every policy up front
+  int maxRunners = 1;
+  char *name;
+  for (name = policies; *name != '\0'; name++) maxRunners += *name == ',';
+  Runner *runners = malloc(maxRunners * sizeof(Runner));
+  assert(runners != NULL);
+  int numRunners = 0;
+  for (name = strtok(policies, ","); name != NULL; name = strtok(NULL, ",")) {
+    if (!startRunner(&runners[numRunners], argv[optind], name, cpus, fit)) {
+      printf("Could not start a %s dispatcher on %s.\n", name, argv[optind]);
+      return 1;
+    }
+    numRunners++;
+  }
+
+  // every dispatcher gets one step in turn until all are done
+  int running = numRunners, i;
+  double wall = nowNanos();
+  while (running > 0) {
+    for (i = 0; i < numRunners; i++) {
+      if (runners[i].done) continue;
+      stepRunner(&runners[i]);
+      if (runners[i].done) running--;
+    }
+  }
+  wall = nowNanos() - wall;
+
+  printf("%d dispatchers, %d cpus each, stepped in turn in %.1f ms\n", numRunners, cpus, wall / 1e6);
+  printf("%-8s %8s %9s %10s %8s %10s %10s\n", "POLICY", "JOBS", "STEPS", "SIM(s)", "STEP(ms)",
+      "NS/STEP", "MAX(us)");
+  for (i = 0; i < numRunners; i++) {
+    Runner *r = &runners[i];
+    printf("%-8s %8d %9ld %10.*f %8.1f %10.0f %10.1f%s\n", r->d.policy->name, r->d.jobsCompleted,
+        r->steps, r->d.ticksPerSecond > 1 ? 3 : 0, (double)r->d.clock / r->d.ticksPerSecond,
+        r->nanos / 1e6, r->nanos / r->steps, r->maxNanos / 1e3, r->stuck ? "  (jobs left waiting)" : "");
+    freeDispatcher(&r->d);
+    closeDispatchList(&r->list);
+  }
+  free(runners);
+  return 0;
+}
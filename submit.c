@@ -0,0 +1,256 @@
+#include "control.h"
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* hostd-submit: sends jobs to a dispatcher started with --listen.
+   Job lines are read from the files given (or stdin) and sent in
+   batches, several batches in flight at once so the dispatcher never
+   waits on the client. It also asks for status, a shutdown, or
+   measures how fast jobs can be submitted */
+
+#define LOAD_JOB "3600, 3, 1, 16" // an hour out, so none runs during a load test; no devices
+
+static int sock = -1;
+static int window = 8; // batches sent but not answered yet
+static int inFlight = 0;
+static long submitted = 0;
+static int failed = 0;
+static char message[CONTROL_MAX_MESSAGE];
+static int messageLen = 0, messageJobs = 0;
+
+static bool connectTo(const char *path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+  sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (sock < 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    printf("Could not connect to %s: %s.\n", path, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+/* Waits for the reply to the oldest batch in flight */
+static bool readReply(bool quiet) {
+  char reply[CONTROL_MAX_MESSAGE + 1];
+  ssize_t n = recv(sock, reply, CONTROL_MAX_MESSAGE, 0);
+  if (n <= 0) {
+    printf("The dispatcher closed the connection.\n");
+    return false;
+  }
+  reply[n] = '\0';
+  inFlight--;
+  int count, first;
+  if (sscanf(reply, "ok %d %d", &count, &first) == 2) {
+    submitted += count;
+    if (!quiet && count > 0) printf("Submitted jobs %d to %d.\n", first, first + count - 1);
+  } else {
+    fprintf(stderr, "Batch refused: %s", reply);
+    failed++;
+  }
+  return true;
+}
+
+static bool sendMessage(const char *msg, int len, bool quiet) {
+  if (inFlight == window && !readReply(quiet)) return false;
+  if (send(sock, msg, len, MSG_NOSIGNAL) != len) {
+    printf("Could not send to the dispatcher: %s.\n", strerror(errno));
+    return false;
+  }
+  inFlight++;
+  return true;
+}
+
+static bool flushBatch() {
+  if (messageJobs == 0) return true;
+  bool ok = sendMessage(message, messageLen, false);
+  messageLen = messageJobs = 0;
+  return ok;
+}
+
+/* Sends every job line of a file, batch lines to a message. A line too
+   long for a message is reported and counted as refused */
+static bool submitFile(FILE *in, const char *name, int batch) {
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t len;
+  int lineNo = 0;
+  bool ok = true;
+  while (ok && (len = getline(&line, &cap, in)) > 0) {
+    lineNo++;
+    const char *p = line;
+    while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+    if (*p == '\n' || *p == '\0' || *p == '#') continue;
+    if (line[len - 1] != '\n') line[len++] = '\n'; // getline left room for the nul
+    if (len > CONTROL_MAX_MESSAGE) {
+      fprintf(stderr, "%s:%d: job refused: longer than a message (%d bytes)\n", name, lineNo,
+          CONTROL_MAX_MESSAGE);
+      failed++;
+      continue;
+    }
+    if (messageLen + len > CONTROL_MAX_MESSAGE) ok = flushBatch();
+    memcpy(message + messageLen, line, len);
+    messageLen += len;
+    if (++messageJobs == batch) ok = ok && flushBatch();
+  }
+  free(line);
+  return ok && flushBatch();
+}
+
+/* Submits jobs copies of job as fast as the dispatcher takes them */
+static bool loadTest(const char *job, long jobs, int batch) {
+  int jobLen = strlen(job), lineLen = jobLen + 1; // checked to fit a message
+  if ((long)lineLen * batch > CONTROL_MAX_MESSAGE) batch = CONTROL_MAX_MESSAGE / lineLen;
+  int i;
+  for (i = 0; i < batch; i++) {
+    // no terminator, a full batch fills the message exactly
+    memcpy(message + i * lineLen, job, jobLen);
+    message[i * lineLen + jobLen] = '\n';
+  }
+
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  long left = jobs, messages = 0;
+  while (left > 0) {
+    int n = left < batch ? left : batch;
+    if (!sendMessage(message, n * lineLen, true)) return false;
+    left -= n;
+    messages++;
+  }
+  while (inFlight > 0) {
+    if (!readReply(true)) return false;
+  }
+  gettimeofday(&end, NULL);
+
+  double secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  printf("Submitted %ld jobs in %ld messages of up to %d in %.1f ms: %.0f jobs/s, %.1f us per message.\n",
+      submitted, messages, batch, secs * 1000, submitted / secs, secs * 1e6 / messages);
+  return true;
+}
+
+/* Sends a single command and waits for its reply */
+static bool request(const char *word, char reply[CONTROL_MAX_MESSAGE + 1]) {
+  if (!sendMessage(word, strlen(word), true)) return false;
+  ssize_t n = recv(sock, reply, CONTROL_MAX_MESSAGE, 0);
+  if (n <= 0) {
+    printf("The dispatcher closed the connection.\n");
+    return false;
+  }
+  reply[n] = '\0';
+  inFlight--;
+  return true;
+}
+
+/* Sends a single command and prints the reply */
+static bool command(const char *word) {
+  char reply[CONTROL_MAX_MESSAGE + 1];
+  if (!request(word, reply)) return false;
+  fputs(strncmp(reply, "ok\n", 3) == 0 ? reply + 3 : reply, stdout);
+  return strncmp(reply, "ok", 2) == 0;
+}
+
+/* Builds the default load test job with a zero for each of the
+   dispatcher's devices, which it gives in its status */
+static bool defaultLoadJob(char *job, int cap) {
+  char reply[CONTROL_MAX_MESSAGE + 1];
+  if (!request("status", reply)) return false;
+  const char *p = strstr(reply, "\ndevices ");
+  int devices, i, n;
+  if (strncmp(reply, "ok", 2) != 0 || p == NULL || sscanf(p, " devices %d", &devices) != 1 ||
+      devices < 0 || devices > MAX_RESOURCES) {
+    printf("The dispatcher did not say how many devices it has, give the job with --job.\n");
+    return false;
+  }
+  n = snprintf(job, cap, "%s", LOAD_JOB);
+  for (i = 0; i < devices; i++) n += snprintf(job + n, cap - n, ", 0");
+  return true;
+}
+
+static void printSubmitUsage(char *name) {
+  printf("Usage: %s [options] [job file ...]\n", name);
+  printf("Sends dispatch list lines to hostd --listen, arrival times counting from now.\n");
+  printf("  -s, --socket <path>  the dispatcher's socket (default %s)\n", CONTROL_DEFAULT_PATH);
+  printf("  -b, --batch <n>      jobs per message (default 256)\n");
+  printf("  -w, --window <n>     messages sent ahead of their replies (default 8)\n");
+  printf("  -S, --status         print the dispatcher's queues and free resources\n");
+  printf("  -x, --shutdown       stop taking jobs and exit once the submitted ones are done\n");
+  printf("  -n, --load <n>       submit n copies of a job and report the throughput\n");
+  printf("  -j, --job <line>     the job a load test submits (default \"%s\" and no\n"
+      "                       units of each of the dispatcher's devices)\n", LOAD_JOB);
+}
+
+int main(int argc, char **argv) {
+  const char *path = CONTROL_DEFAULT_PATH;
+  const char *loadJob = NULL;
+  char defaultJob[sizeof(LOAD_JOB) + MAX_RESOURCES * 3];
+  const char *word = NULL;
+  int batch = 256;
+  long load = 0;
+
+  static struct option longOptions[] = {
+    {"socket", required_argument, NULL, 's'},
+    {"batch", required_argument, NULL, 'b'},
+    {"window", required_argument, NULL, 'w'},
+    {"status", no_argument, NULL, 'S'},
+    {"shutdown", no_argument, NULL, 'x'},
+    {"load", required_argument, NULL, 'n'},
+    {"job", required_argument, NULL, 'j'},
+    {NULL, 0, NULL, 0}
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "s:b:w:Sxn:j:", longOptions, NULL)) != -1) {
+    switch (opt) {
+      case 's': path = optarg; break;
+      case 'b': batch = atoi(optarg); break;
+      case 'w': window = atoi(optarg); break;
+      case 'S': word = "status"; break;
+      case 'x': word = "shutdown"; break;
+      case 'n': load = atol(optarg); break;
+      case 'j': loadJob = optarg; break;
+      default:
+        printSubmitUsage(argv[0]);
+        return 1;
+    }
+  }
+  if (batch < 1 || window < 1) {
+    printf("The batch and window need to be at least 1.\n");
+    return 1;
+  }
+  if (load > 0 && loadJob != NULL && strlen(loadJob) + 1 > CONTROL_MAX_MESSAGE) {
+    printf("The job is longer than a message (%d bytes).\n", CONTROL_MAX_MESSAGE);
+    return 1;
+  }
+  if (!connectTo(path)) return 1;
+
+  bool ok;
+  if (word != NULL) {
+    ok = command(word);
+  } else if (load > 0) {
+    ok = true;
+    if (loadJob == NULL) {
+      ok = defaultLoadJob(defaultJob, sizeof(defaultJob));
+      loadJob = defaultJob;
+    }
+    ok = ok && loadTest(loadJob, load, batch);
+  } else if (optind == argc) {
+    ok = submitFile(stdin, "stdin", batch);
+  } else {
+    ok = true;
+    int i;
+    for (i = optind; i < argc && ok; i++) {
+      FILE *in = fopen(argv[i], "r");
+      if (in == NULL) {
+        printf("Could not open file %s.\n", argv[i]);
+        ok = false;
+        break;
+      }
+      ok = submitFile(in, argv[i], batch);
+      fclose(in);
+    }
+  }
+  while (ok && inFlight > 0) ok = readReply(false);
+  close(sock);
+  return (ok && failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/syscall.h>
+#include "supervisor.h"
+
+/* Real time dispatching waits on one epoll set holding a timerfd for
+   the scheduling tick and a signalfd for SIGCHLD. Stops, continues and
+   exits of children arrive as events instead of blocking waitpid calls.
+   SIGUSR1 (a request for a metrics report) and SIGUSR2 (a request for a
+   checkpoint) come in the same way.
+
+   Processes adopted from an earlier dispatcher are not our children, so
+   there is no SIGCHLD for them. Each gets a pidfd in the epoll set,
+   which turns readable when it exits, and its stops and continues are
+   read from /proc once a tick.
+
+   One more descriptor may be watched for work that cannot wait for the
+   tick, eg. the control socket. When it turns readable waitForTick
+   returns early without a tick having passed */
+
+/* A job process started by a dispatcher that has since gone away */
+typedef struct adoptedProcess {
+  pid_t pid;
+  int pidFd;
+  bool stopped; // as last seen in /proc
+} AdoptedProcess;
+
+static int epollFd = -1;
+static int timerFd = -1;
+static int childFd = -1;
+static int wakeFd = -1; // returns from waitForTick early, -1 for none
+static sigset_t childMask;
+static volatile sig_atomic_t reportPending = 0;
+static volatile sig_atomic_t checkpointPending = 0;
+static AdoptedProcess *adopted;
+static int numAdopted = 0, adoptedCap = 0;
+
+/* Sets up the epoll set and starts the periodic tick timer */
+bool initSupervisor(int tickMillis) {
+  // SIGCHLD has to be blocked so it is only seen through the signalfd
+  sigemptyset(&childMask);
+  sigaddset(&childMask, SIGCHLD);
+  sigaddset(&childMask, SIGUSR1);
+  sigaddset(&childMask, SIGUSR2);
+  if (sigprocmask(SIG_BLOCK, &childMask, NULL) < 0) return false;
+
+  childFd = signalfd(-1, &childMask, SFD_NONBLOCK | SFD_CLOEXEC);
+  timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (childFd < 0 || timerFd < 0 || epollFd < 0) {
+    perror("supervisor");
+    return false;
+  }
+
+  struct epoll_event ev = {0};
+  ev.events = EPOLLIN;
+  ev.data.fd = childFd;
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, childFd, &ev) < 0) return false;
+  ev.data.fd = timerFd;
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &ev) < 0) return false;
+
+  struct itimerspec tick;
+  tick.it_interval.tv_sec = tickMillis / 1000;
+  tick.it_interval.tv_nsec = (tickMillis % 1000) * 1000000L;
+  tick.it_value = tick.it_interval;
+  return timerfd_settime(timerFd, 0, &tick, NULL) == 0;
+}
+
+/* Collects every pending child state change. A single SIGCHLD can
+   stand for several children so waitpid is drained until it is empty */
+static void drainChildren(ChildEventHandler onChild, void *context) {
+  struct signalfd_siginfo info;
+  while (read(childFd, &info, sizeof(info)) == sizeof(info)) {
+    // SIGCHLD only needs clearing, waitpid below does the work
+    if (info.ssi_signo == SIGUSR1) reportPending = 1;
+    if (info.ssi_signo == SIGUSR2) checkpointPending = 1;
+  }
+
+  int status;
+  pid_t pid;
+  while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0) {
+    if (WIFSTOPPED(status)) onChild(context, pid, CHILD_STOPPED, status);
+    else if (WIFCONTINUED(status)) onChild(context, pid, CHILD_CONTINUED, status);
+    else onChild(context, pid, CHILD_EXITED, status);
+  }
+}
+
+/* Reads the state letter out of /proc/<pid>/stat, 0 if it is gone.
+   The command name before it is in brackets and may hold spaces */
+static char processState(pid_t pid) {
+  char path[64], buf[512];
+  snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+  FILE *f = fopen(path, "r");
+  if (f == NULL) return 0;
+  size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+  fclose(f);
+  buf[n] = '\0';
+  char *paren = strrchr(buf, ')');
+  return (paren != NULL && paren[1] == ' ') ? paren[2] : 0;
+}
+
+static void dropAdopted(int i) {
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, adopted[i].pidFd, NULL);
+  close(adopted[i].pidFd);
+  adopted[i] = adopted[--numAdopted];
+}
+
+/* Reports adopted processes that stopped or continued since last tick */
+static void pollAdopted(ChildEventHandler onChild, void *context) {
+  int i;
+  for (i = 0; i < numAdopted; i++) {
+    char state = processState(adopted[i].pid);
+    bool stopped = state == 'T' || state == 't';
+    if (state == 0 || stopped == adopted[i].stopped) continue;
+    adopted[i].stopped = stopped;
+    onChild(context, adopted[i].pid, stopped ? CHILD_STOPPED : CHILD_CONTINUED, 0);
+  }
+}
+
+/* Reports the exit of the adopted process whose pidfd became readable.
+   Its exit status went to whoever reaped it, so none is given */
+static void adoptedExited(int pidFd, ChildEventHandler onChild, void *context) {
+  int i;
+  for (i = 0; i < numAdopted && adopted[i].pidFd != pidFd; i++);
+  if (i == numAdopted) return;
+  pid_t pid = adopted[i].pid;
+  dropAdopted(i);
+  onChild(context, pid, CHILD_EXITED, 0);
+}
+
+/* Blocks until the tick timer fires, handing child events to onChild
+   as they happen. Returns how many ticks passed (normally 1), or 0 if
+   the watched wakeup descriptor turned readable first */
+int waitForTick(ChildEventHandler onChild, void *context) {
+  struct epoll_event ready[16];
+  while (1) {
+    int n = epoll_wait(epollFd, ready, 16, -1);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror("epoll_wait");
+      return 1;
+    }
+
+    int i, ticks = 0;
+    bool woken = false;
+    for (i = 0; i < n; i++) {
+      if (ready[i].data.fd == childFd) {
+        drainChildren(onChild, context);
+      } else if (ready[i].data.fd == timerFd) {
+        uint64_t expirations;
+        if (read(timerFd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+          ticks = (int)expirations;
+        }
+      } else if (ready[i].data.fd == wakeFd) {
+        woken = true; // whoever owns it does the reading
+      } else {
+        adoptedExited(ready[i].data.fd, onChild, context);
+      }
+    }
+    if (ticks > 0) {
+      if (numAdopted > 0) pollAdopted(onChild, context);
+      return ticks;
+    }
+    if (woken) return 0;
+  }
+}
+
+/* Makes waitForTick return as soon as fd is readable, even between
+   ticks. The caller has to drain fd before waiting again */
+bool watchWakeup(int fd) {
+  struct epoll_event ev = {0};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) return false;
+  wakeFd = fd;
+  return true;
+}
+
+/* Watches a running process that some earlier dispatcher started, eg.
+   after restoring a checkpoint. Only a process that is still running
+   program is taken, so a pid reused since then is left alone.
+   Returns false if the process is gone */
+bool adoptChild(pid_t pid, const char *program) {
+  char path[64], comm[64];
+  const char *base = strrchr(program, '/');
+  base = base ? base + 1 : program;
+  snprintf(path, sizeof(path), "/proc/%d/comm", (int)pid);
+  FILE *f = fopen(path, "r");
+  if (f == NULL) return false;
+  bool same = fgets(comm, sizeof(comm), f) != NULL &&
+    strncmp(comm, base, strlen(base)) == 0 && comm[strlen(base)] == '\n';
+  fclose(f);
+  if (!same) return false;
+
+  int pidFd = syscall(SYS_pidfd_open, pid, 0);
+  if (pidFd < 0) return false;
+  struct epoll_event ev = {0};
+  ev.events = EPOLLIN;
+  ev.data.fd = pidFd;
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, pidFd, &ev) < 0) {
+    close(pidFd);
+    return false;
+  }
+  if (numAdopted == adoptedCap) {
+    adoptedCap = adoptedCap ? adoptedCap * 2 : 16;
+    adopted = realloc(adopted, adoptedCap * sizeof(AdoptedProcess));
+    assert(adopted != NULL);
+  }
+  adopted[numAdopted].pid = pid;
+  adopted[numAdopted].pidFd = pidFd;
+  adopted[numAdopted].stopped = false; // so a stop already made is reported
+  numAdopted++;
+  return true;
+}
+
+/* True if pid was adopted rather than started by this dispatcher.
+   Adopted processes only ever get fewer, so a scan is fine */
+bool isAdopted(pid_t pid) {
+  int i;
+  for (i = 0; i < numAdopted; i++) {
+    if (adopted[i].pid == pid) return true;
+  }
+  return false;
+}
+
+/* True if the process is stopped right now, as far as /proc says */
+bool processStopped(pid_t pid) {
+  char state = processState(pid);
+  return state == 'T' || state == 't';
+}
+
+static void onReportSignal(int signum) {
+  if (signum == SIGUSR2) checkpointPending = 1;
+  else reportPending = 1;
+}
+
+/* Lets SIGUSR1 request a report and SIGUSR2 a checkpoint without a
+   supervisor (virtual time). Once initSupervisor has run the signals
+   go to the signalfd instead */
+void watchReportSignal() {
+  signal(SIGUSR1, onReportSignal);
+  signal(SIGUSR2, onReportSignal);
+}
+
+/* True once for every SIGUSR1 received */
+bool reportRequested() {
+  if (!reportPending) return false;
+  reportPending = 0;
+  return true;
+}
+
+/* True once for every SIGUSR2 received */
+bool checkpointRequested() {
+  if (!checkpointPending) return false;
+  checkpointPending = 0;
+  return true;
+}
+
+/* Waits for every child that is still on its way out, telling onChild
+   (if any) of each exit so what a killed job held can be given back */
+void reapChildren(ChildEventHandler onChild, void *context) {
+  int status;
+  pid_t pid;
+  while ((pid = waitpid(-1, &status, 0)) > 0 || errno == EINTR) {
+    if (pid > 0 && onChild != NULL) onChild(context, pid, CHILD_EXITED, status);
+  }
+}
+
+void closeSupervisor() {
+  while (numAdopted > 0) dropAdopted(numAdopted - 1);
+  free(adopted);
+  adopted = NULL;
+  adoptedCap = 0;
+  if (epollFd >= 0) close(epollFd);
+  if (timerFd >= 0) close(timerFd);
+  if (childFd >= 0) close(childFd);
+  epollFd = timerFd = childFd = wakeFd = -1;
+  sigprocmask(SIG_UNBLOCK, &childMask, NULL);
+}
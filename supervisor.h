@@ -0,0 +1,29 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* Child state changes reported by the kernel through SIGCHLD */
+typedef enum {
+  CHILD_STOPPED,
+  CHILD_CONTINUED,
+  CHILD_EXITED
+} ChildEventType;
+
+/* context is whatever the caller passed along with the handler */
+typedef void (*ChildEventHandler)(void *context, pid_t pid, ChildEventType type, int status);
+
+bool initSupervisor(int tickMillis);
+int waitForTick(ChildEventHandler onChild, void *context);
+bool watchWakeup(int fd);
+void watchReportSignal();
+bool reportRequested();
+bool checkpointRequested();
+bool adoptChild(pid_t pid, const char *program);
+bool isAdopted(pid_t pid);
+bool processStopped(pid_t pid);
+void reapChildren(ChildEventHandler onChild, void *context);
+void closeSupervisor();
+
+#endif
@@ -0,0 +1,306 @@
+#include "hostd.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include "runner.h"
+
+/* hostd-sweep: replays one dispatch list through hostd --virtual-time
+   under every combination of a grid of options and writes one CSV row
+   per combination. The runs are shared out to a pool of worker threads,
+   each of which drives hostd processes of its own, so every
+   configuration gets a scheduler to itself and nothing is shared
+   between runs but the (read only) dispatch list. Rows come out in grid
+   order however the runs finish */
+
+#define HOSTD_PATH "./hostd"
+#define MAX_AXES 16
+#define MAX_VALUES 64
+#define MAX_ARGS 64
+
+/* One option and the values it takes across the sweep */
+typedef struct axis {
+  char *option;     // as given to hostd, eg. --quanta or -f
+  char *name;       // the option without its dashes, for the CSV header
+  char *values[MAX_VALUES];
+  int count;
+} Axis;
+
+#define NUM_CLASSES 4
+static const char *classNames[NUM_CLASSES] = {"realtime", "p1", "p2", "p3"};
+enum { TURNAROUND, RESPONSE, WAIT, NUM_METRICS };
+static const char *metricNames[NUM_METRICS] = {"turnaround", "response", "wait"};
+
+/* What one configuration's run produced */
+typedef struct runResult {
+  bool ok;
+  int jobs;            // completed
+  double simSeconds;
+  double wallMs;       // hostd's own replay time
+  MetricRow metrics[NUM_CLASSES][NUM_METRICS];
+  char error[128];     // first line hostd printed when it failed
+} RunResult;
+
+static Axis axes[MAX_AXES];
+static int numAxes = 0;
+static int numConfigs = 1;
+static const char *listPath;
+static char *fixedArgs = "";
+static RunResult *results;
+static atomic_int nextConfig = 0;
+
+/* Adds an axis written as option=value|value|..., eg. --quanta=1s|2s.
+   Values may hold commas and further = signs, only the first = splits */
+static bool addAxis(const char *spec) {
+  if (numAxes == MAX_AXES) return false;
+  char *copy = strdup(spec);
+  char *eq = strchr(copy, '=');
+  if (copy[0] != '-' || eq == NULL || eq[1] == '\0') {
+    free(copy);
+    return false;
+  }
+  *eq = '\0';
+  Axis *a = &axes[numAxes];
+  a->option = copy;
+  a->name = copy;
+  while (*a->name == '-') a->name++;
+  a->count = 0;
+  char *save, *v;
+  for (v = strtok_r(eq + 1, "|", &save); v != NULL; v = strtok_r(NULL, "|", &save)) {
+    if (a->count == MAX_VALUES) break;
+    a->values[a->count++] = v;
+  }
+  if (a->count == 0 || v != NULL) {
+    free(copy);
+    return false;
+  }
+  numConfigs *= a->count;
+  numAxes++;
+  return true;
+}
+
+/* Reads one axis per line, skipping blank lines and # comments */
+static bool loadGrid(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) return false;
+  char line[4096];
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), f) != NULL) {
+    char *s = line, *e = line + strlen(line);
+    while (*s == ' ' || *s == '\t') s++;
+    while (e > s && (e[-1] == '\n' || e[-1] == '\r' || e[-1] == ' ' || e[-1] == '\t')) e--;
+    *e = '\0';
+    if (*s == '\0' || *s == '#') continue;
+    ok = addAxis(s);
+    if (!ok) fprintf(stderr, "%s: bad axis %s\n", path, s);
+  }
+  fclose(f);
+  return ok;
+}
+
+/* The value of axis a in configuration config. The last axis changes
+   fastest, like nested loops written in axis order */
+static const char* axisValue(int config, int a) {
+  int i;
+  for (i = numAxes - 1; i > a; i--) config /= axes[i].count;
+  return axes[a].values[config % axes[a].count];
+}
+
+/* Replays the list under one configuration */
+static void runConfig(int config, RunResult *r) {
+  char *argv[MAX_ARGS], *fixed = strdup(fixedArgs);
+  int argc = 0, a;
+  argv[argc++] = HOSTD_PATH;
+  argv[argc++] = "-t";
+  argv[argc++] = "-L";
+  argv[argc++] = "quiet";
+  // main made sure all of the fixed words fit
+  argc = appendWords(argv, argc, MAX_ARGS - 2 * numAxes, fixed);
+  for (a = 0; a < numAxes; a++) {
+    argv[argc++] = axes[a].option;
+    argv[argc++] = (char *)axisValue(config, a);
+  }
+  argv[argc++] = (char *)listPath;
+  argv[argc] = NULL;
+
+  memset(r, 0, sizeof(*r));
+  bool exited;
+  char *text = runProgram(argv, -1, &exited);
+  free(fixed);
+  if (text == NULL) {
+    snprintf(r->error, sizeof(r->error), "could not start %s", HOSTD_PATH);
+    return;
+  }
+  const char *replay = strstr(text, "Replayed ");
+  if (!exited || replay == NULL ||
+      sscanf(replay, "Replayed %lf simulated seconds in %lf ms", &r->simSeconds, &r->wallMs) != 2) {
+    // hostd says what was wrong with its options on the first line
+    snprintf(r->error, sizeof(r->error), "%.*s", (int)strcspn(text, "\n"), text);
+    free(text);
+    return;
+  }
+  int c, m;
+  for (c = 0; c < NUM_CLASSES; c++) {
+    for (m = 0; m < NUM_METRICS; m++) parseMetric(text, classNames[c], metricNames[m], &r->metrics[c][m]);
+    r->jobs += r->metrics[c][TURNAROUND].jobs;
+  }
+  r->ok = true;
+  free(text);
+}
+
+/* Takes configurations off the shared counter until none are left */
+static void* sweepWorker(void *arg) {
+  int config;
+  while ((config = atomic_fetch_add(&nextConfig, 1)) < numConfigs) {
+    runConfig(config, &results[config]);
+  }
+  return NULL;
+}
+
+/* Writes a field, quoted if it holds a comma or a quote */
+static void writeField(FILE *out, const char *s) {
+  if (strpbrk(s, ",\"") == NULL) {
+    fputs(s, out);
+    return;
+  }
+  fputc('"', out);
+  for (; *s; s++) {
+    if (*s == '"') fputc('"', out);
+    fputc(*s, out);
+  }
+  fputc('"', out);
+}
+
+static void writeCsv(FILE *out) {
+  int a, c, i;
+  fprintf(out, "config");
+  for (a = 0; a < numAxes; a++) fprintf(out, ",%s", axes[a].name);
+  fprintf(out, ",ok,jobs,sim_s,jobs_per_sim_s,wall_ms");
+  for (c = 0; c < NUM_CLASSES; c++) {
+    const char *n = classNames[c];
+    fprintf(out, ",%s_jobs,%s_turnaround_p50,%s_turnaround_p95,%s_turnaround_p99,"
+        "%s_turnaround_mean,%s_response_mean,%s_wait_mean", n, n, n, n, n, n, n);
+  }
+  fputc('\n', out);
+
+  for (i = 0; i < numConfigs; i++) {
+    RunResult *r = &results[i];
+    fprintf(out, "%d", i);
+    for (a = 0; a < numAxes; a++) {
+      fputc(',', out);
+      writeField(out, axisValue(i, a));
+    }
+    if (!r->ok) {
+      fprintf(out, ",0\n");
+      continue;
+    }
+    fprintf(out, ",1,%d,%.3f,%.4f,%.3f", r->jobs, r->simSeconds,
+        r->simSeconds > 0 ? r->jobs / r->simSeconds : 0.0, r->wallMs);
+    for (c = 0; c < NUM_CLASSES; c++) {
+      MetricRow *t = r->metrics[c];
+      fprintf(out, ",%.0f,%g,%g,%g,%g,%g,%g", t[TURNAROUND].jobs, t[TURNAROUND].p50,
+          t[TURNAROUND].p95, t[TURNAROUND].p99, t[TURNAROUND].mean, t[RESPONSE].mean,
+          t[WAIT].mean);
+    }
+    fputc('\n', out);
+  }
+}
+
+static void printSweepUsage(char *name) {
+  printf("Usage: %s [options] <dispatch list>\n", name);
+  printf("Replays the list in virtual time under every combination of the axes and\n");
+  printf("writes throughput and latency of each as a CSV row.\n");
+  printf("  -x, --axis <option>=<v1>|<v2>|...  an hostd option and the values to try,\n"
+         "                          eg. --quanta=1s|500ms,1s,2s or -f=first|best|next\n");
+  printf("  -g, --grid <file>       more axes, one per line\n");
+  printf("  -H, --hostd-args <str>  options for every run, eg. \"-c 4\"\n");
+  printf("  -j, --threads <n>       runs at once (default one per online cpu)\n");
+  printf("  -o, --output <file>     where the CSV goes (default stdout)\n");
+}
+
+int main(int argc, char **argv) {
+  int threads = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *outPath = NULL;
+
+  static struct option longOptions[] = {
+    {"axis", required_argument, NULL, 'x'},
+    {"grid", required_argument, NULL, 'g'},
+    {"hostd-args", required_argument, NULL, 'H'},
+    {"threads", required_argument, NULL, 'j'},
+    {"output", required_argument, NULL, 'o'},
+    {NULL, 0, NULL, 0}
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "x:g:H:j:o:", longOptions, NULL)) != -1) {
+    switch (opt) {
+      case 'x':
+        if (!addAxis(optarg)) {
+          printf("Bad axis %s (eg. --quanta=1s|2s, at most %d axes of %d values).\n",
+              optarg, MAX_AXES, MAX_VALUES);
+          return 1;
+        }
+        break;
+      case 'g':
+        if (!loadGrid(optarg)) {
+          printf("Could not read grid %s.\n", optarg);
+          return 1;
+        }
+        break;
+      case 'H': fixedArgs = optarg; break;
+      case 'j': threads = atoi(optarg); break;
+      case 'o': outPath = optarg; break;
+      default:
+        printSweepUsage(argv[0]);
+        return 1;
+    }
+  }
+  if (argc - optind != 1) {
+    printSweepUsage(argv[0]);
+    return 1;
+  }
+  // hostd, -t -L quiet, the axes and the list come on top of them
+  int maxWords = MAX_ARGS - 6 - 2 * numAxes;
+  if (countWords(fixedArgs) > maxWords) {
+    printf("Too many words in --hostd-args (at most %d with %d axes).\n", maxWords, numAxes);
+    return 1;
+  }
+  listPath = argv[optind];
+  if (access(listPath, R_OK) != 0) {
+    printf("Could not open file %s.\n", listPath);
+    return 1;
+  }
+  if (threads < 1) threads = 1;
+  if (threads > numConfigs) threads = numConfigs;
+
+  FILE *out = stdout;
+  if (outPath != NULL && (out = fopen(outPath, "w")) == NULL) {
+    printf("Could not create file %s.\n", outPath);
+    return 1;
+  }
+
+  results = calloc(numConfigs, sizeof(RunResult));
+  pthread_t *pool = malloc(threads * sizeof(pthread_t));
+  assert(results != NULL && pool != NULL);
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  int i, started = 0;
+  for (i = 0; i < threads; i++) {
+    if (pthread_create(&pool[started], NULL, sweepWorker, NULL) == 0) started++;
+  }
+  if (started == 0) sweepWorker(NULL); // no threads to be had, do it all here
+  for (i = 0; i < started; i++) pthread_join(pool[i], NULL);
+  gettimeofday(&end, NULL);
+
+  writeCsv(out);
+  bool ok = (out == stdout ? fflush(out) : fclose(out)) == 0;
+  int failed = 0;
+  for (i = 0; i < numConfigs; i++) {
+    if (results[i].ok) continue;
+    failed++;
+    fprintf(stderr, "config %d failed: %s\n", i, results[i].error);
+  }
+  fprintf(stderr, "Swept %d configurations on %d threads in %.3f s (%d failed).\n",
+      numConfigs, started ? started : 1,
+      (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6, failed);
+  free(results);
+  free(pool);
+  return (ok && failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,363 @@
+#include <pthread.h>
+#include <time.h>
+#include "taskbackend.h"
+#include "jobtable.h"
+
+/* Each task belongs to one worker for its whole life. The dispatcher
+   only ever sends messages: start, suspend, resume and kill go into the
+   worker's inbox, and the worker applies them in order between steps.
+   Nothing in a task is touched by both sides, so the only locking is on
+   the inbox and on the list of tasks that ended themselves. Those are
+   collected by reapTasks once a tick, the way the supervisor reports a
+   process exiting, and the task is only freed by its worker, after the
+   kill that follows, so a message still in the inbox never points at a
+   freed task */
+
+typedef enum {
+  TASK_START,
+  TASK_SUSPEND,
+  TASK_RESUME,
+  TASK_KILL    // stop it if it is running, then free it
+} TaskOp;
+
+typedef struct task {
+  pid_t pid;        // set before it is handed to the worker, never changed
+  int slot;         // of its job in the job table
+  // the rest is the worker's
+  int life;         // steps left
+  long long due;    // when the next step is due while running, in ns
+  long long owed;   // running time still needed for that step while stopped
+  int runIndex;     // in the worker's running list, -1 while stopped
+  bool ended;
+} Task;
+
+typedef struct message {
+  Task *task;
+  TaskOp op;
+} Message;
+
+typedef struct taskWorker {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  Message *inbox;   // under lock
+  int inboxSize, inboxCap;
+  Message *batch;   // the inbox taken over by the worker
+  int batchCap;
+  int *ended;       // slots of tasks that ended themselves, under lock
+  pid_t *endedPids;
+  int numEnded, endedCap;
+  Task **running;   // tasks that are running, in no order
+  int numRunning, runningCap;
+  long steps;
+  long endedThemselves;
+  bool stop;        // under lock
+} TaskWorker;
+
+static TaskWorker *workers;
+static int numWorkers = 0;
+static Task **bySlot;  // the dispatcher's view, NULL once it let go of the task
+static int bySlotCap = 0;
+static int alive = 0, peakAlive = 0;
+static long started = 0;
+
+static long long monoNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void addRunning(TaskWorker *w, Task *t) {
+  if (w->numRunning == w->runningCap) {
+    w->runningCap = w->runningCap ? w->runningCap * 2 : 64;
+    w->running = realloc(w->running, w->runningCap * sizeof(Task *));
+    assert(w->running != NULL);
+  }
+  t->runIndex = w->numRunning;
+  w->running[w->numRunning++] = t;
+}
+
+static void removeRunning(TaskWorker *w, Task *t) {
+  Task *last = w->running[--w->numRunning];
+  w->running[t->runIndex] = last;
+  last->runIndex = t->runIndex;
+  t->runIndex = -1;
+}
+
+/* Applies one message from the dispatcher */
+static void handleMessage(TaskWorker *w, Task *t, TaskOp op, long long now) {
+  switch (op) {
+    case TASK_START:
+      t->life = TASK_LIFE;
+      t->due = now + TASK_STEP_MILLIS * 1000000LL;
+      addRunning(w, t);
+      break;
+    case TASK_SUSPEND:
+      if (t->ended || t->runIndex < 0) break;
+      t->owed = t->due > now ? t->due - now : 0;
+      removeRunning(w, t);
+      break;
+    case TASK_RESUME:
+      if (t->ended || t->runIndex >= 0) break;
+      t->due = now + t->owed;
+      addRunning(w, t);
+      break;
+    case TASK_KILL:
+      if (t->runIndex >= 0) removeRunning(w, t);
+      free(t);
+      break;
+  }
+}
+
+/* One step of a running task. Returns true once it has ended itself */
+static bool stepTask(TaskWorker *w, Task *t) {
+  w->steps++;
+  t->due += TASK_STEP_MILLIS * 1000000LL;
+  return --t->life <= 0;
+}
+
+static void *runWorker(void *arg) {
+  TaskWorker *w = arg;
+  long long slice = TASK_SLICE_MILLIS * 1000000LL;
+  while (1) {
+    // sleep until a message comes or the earliest step is due
+    long long now = monoNanos(), next = -1;
+    int i;
+    for (i = 0; i < w->numRunning; i++) {
+      if (next < 0 || w->running[i]->due < next) next = w->running[i]->due;
+    }
+    pthread_mutex_lock(&w->lock);
+    if (w->inboxSize == 0 && !w->stop && (next < 0 || next > now + slice)) {
+      if (next < 0) {
+        pthread_cond_wait(&w->wake, &w->lock);
+      } else {
+        struct timespec until = {next / 1000000000LL, next % 1000000000LL};
+        pthread_cond_timedwait(&w->wake, &w->lock, &until);
+      }
+    }
+    // take the whole inbox, the dispatcher carries on filling an empty one
+    Message *taken = w->inbox;
+    int count = w->inboxSize, cap = w->inboxCap;
+    w->inbox = w->batch;
+    w->inboxCap = w->batchCap;
+    w->inboxSize = 0;
+    w->batch = taken;
+    w->batchCap = cap;
+    bool stop = w->stop;
+    pthread_mutex_unlock(&w->lock);
+
+    now = monoNanos();
+    for (i = 0; i < count; i++) handleMessage(w, taken[i].task, taken[i].op, now);
+    if (stop) break;
+
+    // everything due within the slice runs now, a step at a time
+    for (i = 0; i < w->numRunning; i++) {
+      Task *t = w->running[i];
+      while (t->due <= now + slice && !stepTask(w, t)) continue;
+      if (t->due > now + slice && t->life > 0) continue;
+      t->ended = true;
+      removeRunning(w, t);
+      i--; // the last task moved into i
+      w->endedThemselves++;
+      pthread_mutex_lock(&w->lock);
+      if (w->numEnded == w->endedCap) {
+        w->endedCap = w->endedCap ? w->endedCap * 2 : 64;
+        w->ended = realloc(w->ended, w->endedCap * sizeof(int));
+        w->endedPids = realloc(w->endedPids, w->endedCap * sizeof(pid_t));
+        assert(w->ended != NULL && w->endedPids != NULL);
+      }
+      w->ended[w->numEnded] = t->slot;
+      w->endedPids[w->numEnded++] = t->pid;
+      pthread_mutex_unlock(&w->lock);
+    }
+  }
+  return NULL;
+}
+
+static void post(Task *t, TaskOp op) {
+  TaskWorker *w = &workers[t->pid % numWorkers];
+  pthread_mutex_lock(&w->lock);
+  if (w->inboxSize == w->inboxCap) {
+    w->inboxCap = w->inboxCap ? w->inboxCap * 2 : 256;
+    w->inbox = realloc(w->inbox, w->inboxCap * sizeof(Message));
+    assert(w->inbox != NULL);
+  }
+  w->inbox[w->inboxSize].task = t;
+  w->inbox[w->inboxSize++].op = op;
+  // a worker with messages waiting is awake or about to look
+  if (w->inboxSize == 1) pthread_cond_signal(&w->wake);
+  pthread_mutex_unlock(&w->lock);
+}
+
+/* The dispatcher lets go of a task, it is freed by the kill that follows */
+static void dropTask(Task *t) {
+  bySlot[t->slot] = NULL;
+  alive--;
+  post(t, TASK_KILL);
+}
+
+static Task* taskOf(PCB *job) {
+  assert(job->slot < bySlotCap && bySlot[job->slot] != NULL);
+  return bySlot[job->slot];
+}
+
+static Task* newTask(Dispatcher *d, PCB *job) {
+  Task *t = calloc(1, sizeof(Task));
+  assert(t != NULL);
+  t->pid = job->pid;
+  t->slot = job->slot;
+  t->runIndex = -1;
+  if (job->slot >= bySlotCap) {
+    int cap = bySlotCap ? bySlotCap : JOB_CHUNK;
+    while (cap <= job->slot) cap *= 2;
+    bySlot = realloc(bySlot, cap * sizeof(Task *));
+    assert(bySlot != NULL);
+    memset(bySlot + bySlotCap, 0, (cap - bySlotCap) * sizeof(Task *));
+    bySlotCap = cap;
+  }
+  bySlot[job->slot] = t;
+  started++;
+  if (++alive > peakAlive) peakAlive = alive;
+  post(t, TASK_START);
+  return t;
+}
+
+static bool taskStart(Dispatcher *d, PCB *job, int cpu) {
+  job->pid = d->nextVirtualPid++;
+  newTask(d, job);
+  job->state = JOB_RUNNING;
+  return true;
+}
+
+/* Stopping a task needs no confirmation, it runs no step after the
+   worker has read the message */
+static void taskSuspend(Dispatcher *d, PCB *job, int cpu) {
+  post(taskOf(job), TASK_SUSPEND);
+  job->state = JOB_STOPPED;
+}
+
+static void taskResume(Dispatcher *d, PCB *job, int cpu) {
+  post(taskOf(job), TASK_RESUME);
+  job->state = JOB_RUNNING;
+}
+
+static void taskTerminate(Dispatcher *d, PCB *job) {
+  dropTask(taskOf(job));
+}
+
+const JobBackend taskJobs = {
+  "task", taskStart, taskSuspend, taskResume, taskTerminate
+};
+
+/* Starts the worker threads. Returns false if one could not be made */
+bool initTaskJobs(int count) {
+  numWorkers = count;
+  workers = calloc(count, sizeof(TaskWorker));
+  assert(workers != NULL);
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  int i;
+  for (i = 0; i < count; i++) {
+    pthread_mutex_init(&workers[i].lock, NULL);
+    pthread_cond_init(&workers[i].wake, &attr);
+  }
+  pthread_condattr_destroy(&attr);
+  for (i = 0; i < count; i++) {
+    if (pthread_create(&workers[i].thread, NULL, runWorker, &workers[i]) != 0) {
+      numWorkers = i;
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Hands the tasks that ended themselves since the last call to the
+   dispatcher, as a running job exiting or a stopped one being gone.
+   A task the dispatcher killed in the meantime is already forgotten */
+void reapTasks(Dispatcher *d) {
+  int i, j;
+  for (i = 0; i < numWorkers; i++) {
+    TaskWorker *w = &workers[i];
+    pthread_mutex_lock(&w->lock);
+    int count = w->numEnded;
+    int *slots = w->ended;
+    pid_t *pids = w->endedPids;
+    w->ended = NULL;
+    w->endedPids = NULL;
+    w->numEnded = w->endedCap = 0;
+    pthread_mutex_unlock(&w->lock);
+
+    for (j = 0; j < count; j++) {
+      Task *t = slots[j] < bySlotCap ? bySlot[slots[j]] : NULL;
+      if (t == NULL || t->pid != pids[j]) continue;
+      PCB *job = jobAt(&d->jobs, t->slot);
+      dropTask(t);
+      if (job->state == JOB_RUNNING) jobExited(d, job->pid);
+      else jobGone(d, job);
+    }
+    free(slots);
+    free(pids);
+  }
+}
+
+/* Gives the restored jobs that had started new tasks, since the old
+   ones went with the dispatcher that ran them. They start over with
+   their whole life, stopped again if the job was waiting.
+   Returns how many tasks were made */
+int restartTasks(Dispatcher *d, PCB **jobs, int count) {
+  int made = 0, i;
+  for (i = 0; i < count; i++) {
+    PCB *job = jobs[i];
+    if (job->pid < 0 || job->state == JOB_NEW || job->state == JOB_EXITED) continue;
+    Task *t = newTask(d, job);
+    made++;
+    if (job->state == JOB_RUNNING || job->state == JOB_RESUME_PENDING) {
+      job->state = JOB_RUNNING;
+    } else {
+      post(t, TASK_SUSPEND);
+      job->state = JOB_STOPPED;
+    }
+  }
+  return made;
+}
+
+/* Stops the workers and frees every task, filling in stats */
+void closeTaskJobs(TaskStats *stats) {
+  int i;
+  for (i = 0; i < numWorkers; i++) {
+    pthread_mutex_lock(&workers[i].lock);
+    workers[i].stop = true;
+    pthread_cond_signal(&workers[i].wake);
+    pthread_mutex_unlock(&workers[i].lock);
+  }
+  memset(stats, 0, sizeof(*stats));
+  stats->workers = numWorkers;
+  stats->started = started;
+  stats->peakAlive = peakAlive;
+  for (i = 0; i < numWorkers; i++) {
+    TaskWorker *w = &workers[i];
+    pthread_join(w->thread, NULL);
+    stats->steps += w->steps;
+    stats->endedThemselves += w->endedThemselves;
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->wake);
+    free(w->inbox);
+    free(w->batch);
+    free(w->ended);
+    free(w->endedPids);
+    free(w->running);
+  }
+  // whatever the dispatcher still held, the workers are gone
+  for (i = 0; i < bySlotCap; i++) free(bySlot[i]);
+  free(bySlot);
+  free(workers);
+  bySlot = NULL;
+  workers = NULL;
+  bySlotCap = numWorkers = alive = 0;
+}
+
+void printTaskReport(FILE *out, const TaskStats *stats) {
+  fprintf(out, "Tasks: %ld run by %d workers, at most %d alive at once, %ld steps, %ld ended themselves.\n",
+      stats->started, stats->workers, stats->peakAlive, stats->steps, stats->endedThemselves);
+}
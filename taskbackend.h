@@ -0,0 +1,35 @@
+#ifndef TASKBACKEND_H
+#define TASKBACKEND_H
+
+#include "dispatcher.h"
+
+#define TASK_LIFE 20          // steps a task runs before it ends itself, as process.c
+#define TASK_STEP_MILLIS 1000 // running time per step
+#define TASK_SLICE_MILLIS 10  // how late a worker may run a step that is due
+
+/* Runs every job as a task inside hostd instead of a process. A task
+   is a small state machine that does one step per second of running
+   time and ends itself after TASK_LIFE steps, the way process.c does,
+   driven by a pool of worker threads. Suspending, resuming and killing
+   a job are a message to the task's worker, so there is no fork, no
+   signal and no pid to run out of, and a few hundred thousand jobs can
+   be alive at once. The pids are labels, as with simulatedJobs. Like
+   processJobs it serves a single dispatcher, handed in with each call */
+extern const JobBackend taskJobs;
+
+/* What the workers did, for the report at the end */
+typedef struct taskStats {
+  int workers;
+  long started;     // tasks made, including restored ones
+  long steps;       // steps run by all workers
+  long endedThemselves;
+  int peakAlive;    // most tasks in existence at once
+} TaskStats;
+
+bool initTaskJobs(int workers);
+void reapTasks(Dispatcher *d);
+int restartTasks(Dispatcher *d, PCB **jobs, int count);
+void closeTaskJobs(TaskStats *stats);
+void printTaskReport(FILE *out, const TaskStats *stats);
+
+#endif
@@ -0,0 +1,183 @@
+#include "trace.h"
+
+/* Records the schedule in memory and writes it out at exit as Chrome
+   trace-event JSON, which loads in chrome://tracing and ui.perfetto.dev.
+   Each simulated cpu gets its own track of run slices, waits are async
+   spans keyed by job, and memory in use is drawn as a counter */
+
+#define TRACE_BLOCK 65536       // records per allocation
+#define TRACE_MEMORY_TID 1000   // track for memory events
+#define TRACE_JOB_TID 1001      // track for job events not tied to a cpu
+
+typedef struct traceBlock {
+  struct traceBlock *next;
+  int used;
+  TraceRecord records[TRACE_BLOCK];
+} TraceBlock;
+
+static TraceBlock *first = NULL, *last = NULL;
+static char *tracePath = NULL;
+static long long tickMicros = 1000000; // trace timestamps are in microseconds
+static const char *levelNames[4] = {"realtimeQ", "p1Q", "p2Q", "p3Q"};
+static const Machine *machine; // names the devices in the event args
+
+/* Starts buffering events, they are written to path by writeTrace.
+   Event times are in dispatcher ticks of tickMillis */
+bool initTrace(const char *path, int tickMillis, const Machine *m) {
+  tickMicros = tickMillis * 1000LL;
+  machine = m;
+  first = last = malloc(sizeof(TraceBlock));
+  if (first == NULL) return false;
+  first->next = NULL;
+  first->used = 0;
+  tracePath = strdup(path);
+  return tracePath != NULL;
+}
+
+/* Buffers one event. Does nothing unless initTrace was called */
+void traceEvent(TraceType type, int start, int end, int cpu, int detail, const PCB *job) {
+  if (last == NULL) return;
+  if (last->used == TRACE_BLOCK) {
+    TraceBlock *b = malloc(sizeof(TraceBlock));
+    assert(b != NULL);
+    b->next = NULL;
+    b->used = 0;
+    last->next = b;
+    last = b;
+  }
+  TraceRecord *r = &last->records[last->used++];
+  r->start = start;
+  r->end = end;
+  r->type = type;
+  r->cpu = cpu;
+  r->detail = detail;
+  r->jobId = job->id;
+  r->pid = job->pid;
+  r->priority = job->priority;
+  r->memReq = job->mem_req;
+  r->memStart = job->mem_start;
+  int i;
+  for (i = 0; i < MAX_RESOURCES; i++) r->devices[i] = job->resources[i];
+}
+
+static void writeArgs(FILE *out, const TraceRecord *r) {
+  fprintf(out, "\"args\":{\"pid\":%d,\"job\":%d,\"priority\":%d,\"mem\":%d,\"mem_start\":%d",
+      (int)r->pid, r->jobId, r->priority, r->memReq, r->memStart);
+  int i;
+  for (i = 0; i < machine->numResources; i++) {
+    fprintf(out, ",\"%s\":%d", machine->names[i], r->devices[i]);
+  }
+  fprintf(out, "}");
+}
+
+/* Writes an instant event on the record's cpu track, or tid if it has none */
+static void writeInstant(FILE *out, const TraceRecord *r, const char *name, int tid) {
+  fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"job\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%lld,\"pid\":1,\"tid\":%d,",
+      name, r->start * tickMicros, r->cpu >= 0 ? r->cpu : tid);
+  writeArgs(out, r);
+  fprintf(out, "}");
+}
+
+/* Writes a wait as an async begin/end pair so overlapping waits of
+   different jobs each keep their own row */
+static void writeWait(FILE *out, const TraceRecord *r, const char *name) {
+  if (r->end <= r->start) return;
+  fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"wait\",\"ph\":\"b\",\"id\":%d,\"ts\":%lld,\"pid\":1,\"tid\":%d,",
+      name, r->jobId, r->start * tickMicros, TRACE_JOB_TID);
+  writeArgs(out, r);
+  fprintf(out, "}");
+  fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"wait\",\"ph\":\"e\",\"id\":%d,\"ts\":%lld,\"pid\":1,\"tid\":%d}",
+      name, r->jobId, r->end * tickMicros, TRACE_JOB_TID);
+}
+
+static void writeRecord(FILE *out, const TraceRecord *r) {
+  char name[64];
+  switch ((TraceType)r->type) {
+    case TRACE_DISPATCH:
+      writeInstant(out, r, r->detail ? "resume dispatch" : "dispatch", TRACE_JOB_TID);
+      break;
+    case TRACE_RUN:
+      snprintf(name, sizeof(name), "PID %d (priority %d)", (int)r->pid, r->priority);
+      fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"run\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%d,",
+          name, r->start * tickMicros, (long long)(r->end - r->start) * tickMicros, r->cpu);
+      writeArgs(out, r);
+      fprintf(out, "}");
+      break;
+    case TRACE_SUSPEND:
+      writeInstant(out, r, "SIGTSTP", TRACE_JOB_TID);
+      break;
+    case TRACE_RESUME:
+      writeInstant(out, r, "SIGCONT", TRACE_JOB_TID);
+      break;
+    case TRACE_DEMOTE:
+      snprintf(name, sizeof(name), "demote to %s", levelNames[r->detail & 3]);
+      writeInstant(out, r, name, TRACE_JOB_TID);
+      break;
+    case TRACE_PROMOTE:
+      snprintf(name, sizeof(name), "promote to %s", levelNames[r->detail & 3]);
+      writeInstant(out, r, name, TRACE_JOB_TID);
+      break;
+    case TRACE_RESOURCE_WAIT:
+      writeWait(out, r, "userQ (resources)");
+      break;
+    case TRACE_QUEUE_WAIT:
+      writeWait(out, r, levelNames[r->detail & 3]);
+      break;
+    case TRACE_MEM_ALLOC:
+    case TRACE_MEM_FREE:
+      writeInstant(out, r, r->type == TRACE_MEM_ALLOC ? "alloc" : "free", TRACE_MEMORY_TID);
+      fprintf(out, ",\n{\"name\":\"memory used (mb)\",\"ph\":\"C\",\"ts\":%lld,\"pid\":1,\"args\":{\"used\":%d}}",
+          r->start * tickMicros, r->detail);
+      break;
+    case TRACE_MEM_MOVE:
+      snprintf(name, sizeof(name), "relocate from %d", r->detail);
+      writeInstant(out, r, name, TRACE_MEMORY_TID);
+      break;
+    case TRACE_COMPLETE:
+      writeInstant(out, r, "complete", TRACE_JOB_TID);
+      break;
+  }
+}
+
+static void writeThreadName(FILE *out, int tid, const char *name) {
+  fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+      tid, name);
+}
+
+/* Writes every buffered event to the trace file and frees the buffer */
+bool writeTrace(int numCpus) {
+  if (first == NULL) return true;
+  FILE *out = fopen(tracePath, "w");
+  if (out == NULL) {
+    perror(tracePath);
+  } else {
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"hostd\"}}");
+    int i;
+    char name[32];
+    for (i = 0; i < numCpus; i++) {
+      snprintf(name, sizeof(name), "CPU %d", i);
+      writeThreadName(out, i, name);
+    }
+    writeThreadName(out, TRACE_MEMORY_TID, "memory");
+    writeThreadName(out, TRACE_JOB_TID, "jobs");
+
+    TraceBlock *b;
+    for (b = first; b != NULL; b = b->next) {
+      for (i = 0; i < b->used; i++) writeRecord(out, &b->records[i]);
+    }
+    fprintf(out, "\n]}\n");
+  }
+  bool ok = out != NULL && !ferror(out);
+  if (out != NULL && fclose(out) != 0) ok = false;
+
+  while (first != NULL) {
+    TraceBlock *next = first->next;
+    free(first);
+    first = next;
+  }
+  last = NULL;
+  free(tracePath);
+  tracePath = NULL;
+  return ok;
+}
@@ -0,0 +1,46 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "hostd.h"
+#include "machine.h"
+
+/* Things that happen to a job that end up in the schedule trace */
+typedef enum {
+  TRACE_DISPATCH,      // put on a cpu, detail = 1 if it was a resume
+  TRACE_RUN,           // ran on a cpu from start to end
+  TRACE_SUSPEND,       // SIGTSTP sent
+  TRACE_RESUME,        // SIGCONT sent
+  TRACE_DEMOTE,        // moved down to feedback level detail
+  TRACE_PROMOTE,       // moved up to feedback level detail by a boost or aging
+  TRACE_RESOURCE_WAIT, // sat in userQ from start to end
+  TRACE_QUEUE_WAIT,    // sat in feedback level detail from start to end
+  TRACE_MEM_ALLOC,     // got its memory, detail = mb in use afterwards
+  TRACE_MEM_FREE,      // gave it back, detail = mb in use afterwards
+  TRACE_MEM_MOVE,      // memory slid down by compaction, detail = old start
+  TRACE_COMPLETE       // finished
+} TraceType;
+
+/* One buffered event. Only plain numbers are kept so recording is a
+   copy into a preallocated block, all formatting happens at the end */
+typedef struct traceRecord {
+  int start;          // dispatcher ticks
+  int end;            // same as start for instant events
+  uint8_t type;
+  int16_t cpu;        // -1 when the event is not tied to a cpu
+  uint8_t priority;
+  uint8_t devices[MAX_RESOURCES]; // units of each kind of device
+  int detail;
+  int jobId;
+  pid_t pid;
+  int memReq;
+  int memStart;
+} TraceRecord;
+
+/* The trace is one per process. With several dispatchers in a process
+   their events all go into it, so only one of them should be traced */
+bool initTrace(const char *path, int tickMillis, const Machine *m);
+void traceEvent(TraceType type, int start, int end, int cpu, int detail, const PCB *job);
+bool writeTrace(int numCpus);
+
+#endif
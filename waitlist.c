@@ -0,0 +1,213 @@
+#include "waitlist.h"
+#include "checkpoint.h"
+
+#define MEM_LIST(c) (WAIT_DEVICES * WAIT_MAX_NEED + (c))
+#define DEVICE_LIST(d, n) ((d) * WAIT_MAX_NEED + (n))
+
+static int memClass(int mem) {
+  if (mem <= 1) return 0;
+  int c = 31 - __builtin_clz((unsigned int)mem);
+  return (c < WAIT_MEM_CLASSES) ? c : WAIT_MEM_CLASSES - 1;
+}
+
+/* Heaps compare the job table's copy of the id, so sifting reads one
+   array rather than a PCB per step */
+static void heapPush(const JobTable *t, WaitHeap *h, int slot) {
+  const int *id = t->id;
+  if (h->size == h->capacity) {
+    h->capacity = h->capacity ? h->capacity * 2 : 16;
+    h->slots = realloc(h->slots, h->capacity * sizeof(int));
+    assert(h->slots != NULL);
+  }
+  int i = h->size++;
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (id[h->slots[parent]] <= id[slot]) break;
+    h->slots[i] = h->slots[parent];
+    i = parent;
+  }
+  h->slots[i] = slot;
+}
+
+static void siftDown(const JobTable *t, WaitHeap *h, int i) {
+  const int *id = t->id;
+  int slot = h->slots[i];
+  while (1) {
+    int child = 2 * i + 1;
+    if (child >= h->size) break;
+    if (child + 1 < h->size && id[h->slots[child + 1]] < id[h->slots[child]]) child++;
+    if (id[slot] <= id[h->slots[child]]) break;
+    h->slots[i] = h->slots[child];
+    i = child;
+  }
+  h->slots[i] = slot;
+}
+
+static PCB* heapPop(const JobTable *t, WaitHeap *h) {
+  int top = h->slots[0];
+  h->slots[0] = h->slots[--h->size];
+  if (h->size > 0) siftDown(t, h, 0);
+  return jobAt(t, top);
+}
+
+/* The id of the job at the top of a heap */
+static int topId(const JobTable *t, const WaitHeap *h) {
+  return t->id[h->slots[0]];
+}
+
+/* Holds a job back until endWake files it again */
+static void deferWaiter(WaitList *w, PCB *job, WaitResource blocker) {
+  if (w->numDeferred == w->deferredCap) {
+    w->deferredCap = w->deferredCap ? w->deferredCap * 2 : 64;
+    w->deferred = realloc(w->deferred, w->deferredCap * sizeof(DeferredWaiter));
+    assert(w->deferred != NULL);
+  }
+  w->deferred[w->numDeferred].job = job;
+  w->deferred[w->numDeferred].blocker = blocker;
+  w->numDeferred++;
+}
+
+void initWaitList(WaitList *w, JobTable *jobs) {
+  memset(w, 0, sizeof(*w));
+  w->jobs = jobs;
+}
+
+/* Files a job under the resource it was short of. During a pass the
+   job is held back until endWake so it is not looked at twice */
+void addWaiter(WaitList *w, PCB *job, WaitResource blocker) {
+  w->waiting++;
+  if (w->inPass) {
+    deferWaiter(w, job, blocker);
+    return;
+  }
+
+  if (blocker == WAIT_MEMORY) {
+    heapPush(w->jobs, &w->lists[MEM_LIST(memClass(job->mem_req))], job->slot);
+  } else {
+    int need = job->resources[blocker];
+    if (need >= WAIT_MAX_NEED) need = WAIT_MAX_NEED - 1;
+    heapPush(w->jobs, &w->lists[DEVICE_LIST(blocker, need)], job->slot);
+  }
+}
+
+/* Notes that some of a resource was given back */
+void resourceReleased(WaitList *w, WaitResource resource) {
+  w->released[resource] = true;
+}
+
+/* Starts a pass over the jobs whose resources were released since the
+   last pass */
+void beginWake(WaitList *w) {
+  memcpy(w->waking, w->released, sizeof(w->waking));
+  memset(w->released, 0, sizeof(w->released));
+  w->inPass = true;
+}
+
+/* Takes out the earliest arrived job that could fit in what is free
+   right now, or returns NULL once no released list can be satisfied.
+   Availability only shrinks during a pass, so any job skipped here
+   would have failed had it been looked at. The memory class holding
+   largestMem also holds requests bigger than it, which are held back
+   right here when they reach the top rather than handed out only to be
+   refiled. The last device list
+   mixes needs, so a job from it may still not fit and is simply
+   refiled */
+PCB* nextWaiter(WaitList *w, const int available[WAIT_DEVICES], int largestMem) {
+  WaitHeap *best = NULL;
+  int d, n;
+  for (d = 0; d < WAIT_DEVICES; d++) {
+    if (!w->waking[d]) continue;
+    for (n = 1; n < WAIT_MAX_NEED && n <= available[d]; n++) {
+      WaitHeap *h = &w->lists[DEVICE_LIST(d, n)];
+      if (h->size > 0 && (best == NULL || topId(w->jobs, h) < topId(w->jobs, best))) best = h;
+    }
+  }
+  if (w->waking[WAIT_MEMORY]) {
+    // class c holds requests of at least 2^c, bigger classes can't fit
+    int partial = memClass(largestMem);
+    for (n = 0; n < WAIT_MEM_CLASSES && (1 << n) <= largestMem; n++) {
+      WaitHeap *h = &w->lists[MEM_LIST(n)];
+      while (n == partial && h->size > 0 && w->jobs->memReq[h->slots[0]] > largestMem) {
+        deferWaiter(w, heapPop(w->jobs, h), WAIT_MEMORY);
+      }
+      if (h->size > 0 && (best == NULL || topId(w->jobs, h) < topId(w->jobs, best))) best = h;
+    }
+  }
+  if (best == NULL) return NULL;
+  w->waiting--;
+  return heapPop(w->jobs, best);
+}
+
+/* Ends the pass and files every job that was refiled during it */
+void endWake(WaitList *w) {
+  w->inPass = false;
+  int i;
+  for (i = 0; i < w->numDeferred; i++) {
+    w->waiting--; // addWaiter counts it again
+    addWaiter(w, w->deferred[i].job, w->deferred[i].blocker);
+  }
+  w->numDeferred = 0;
+}
+
+/* The earliest arrived job waiting on memory that asks for between
+   minMem and maxMem, or NULL. Only the size classes that overlap the
+   range are looked at, but those are scanned in full. The scan goes
+   through the job table's memory and id arrays, not the PCBs */
+PCB* oldestMemoryWaiter(WaitList *w, int minMem, int maxMem) {
+  const int *mem = w->jobs->memReq, *id = w->jobs->id;
+  int oldest = -1, oldestId = 0;
+  int c, i;
+  for (c = memClass(minMem); c <= memClass(maxMem); c++) {
+    WaitHeap *h = &w->lists[MEM_LIST(c)];
+    for (i = 0; i < h->size; i++) {
+      int slot = h->slots[i];
+      if (mem[slot] >= minMem && mem[slot] <= maxMem &&
+          (oldest < 0 || id[slot] < oldestId)) {
+        oldest = slot;
+        oldestId = id[slot];
+      }
+    }
+  }
+  return (oldest < 0) ? NULL : jobAt(w->jobs, oldest);
+}
+
+int waitingJobs(WaitList *w) {
+  return w->waiting;
+}
+
+/* Writes every list in heap order, along with which resources were
+   released since the last pass. Only called between passes */
+void saveWaitList(FILE *f, WaitList *w) {
+  int l;
+  assert(!w->inPass);
+  SAVE(f, w->released);
+  for (l = 0; l < WAIT_LISTS; l++) saveSlots(f, w->jobs, w->lists[l].slots, w->lists[l].size);
+}
+
+/* Reads lists written by saveWaitList into an empty wait list. Jobs go
+   back under the resource they were filed under, not the one they are
+   short of now, so they are woken exactly as before */
+bool loadWaitList(FILE *f, WaitList *w) {
+  int l;
+  if (!LOAD(f, w->released)) return false;
+  for (l = 0; l < WAIT_LISTS; l++) {
+    WaitHeap *h = &w->lists[l];
+    if (!loadSlots(f, w->jobs, &h->slots, &h->size)) return false;
+    h->capacity = h->size;
+    w->waiting += h->size;
+  }
+  return true;
+}
+
+/* Frees every list and the jobs still waiting on them */
+void deleteWaitList(WaitList *w) {
+  JobTable *t = w->jobs;
+  int l, i;
+  for (l = 0; l < WAIT_LISTS; l++) {
+    for (i = 0; i < w->lists[l].size; i++) freeJob(t, jobAt(t, w->lists[l].slots[i]));
+    free(w->lists[l].slots);
+  }
+  for (i = 0; i < w->numDeferred; i++) freeJob(t, w->deferred[i].job);
+  free(w->deferred);
+  memset(w, 0, sizeof(*w));
+}
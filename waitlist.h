@@ -0,0 +1,60 @@
+#ifndef WAITLIST_H
+#define WAITLIST_H
+
+#include "jobtable.h"
+
+/* The resource that stopped a user job from being admitted: the index
+   of a kind of device, or WAIT_MEMORY */
+typedef int WaitResource;
+
+#define WAIT_DEVICES MAX_RESOURCES
+#define WAIT_MEMORY WAIT_DEVICES
+#define WAIT_MAX_NEED 8   // device lists for needing 1-6 units and 7 or more (index 0 unused)
+#define WAIT_MEM_CLASSES 32
+#define WAIT_LISTS (WAIT_DEVICES * WAIT_MAX_NEED + WAIT_MEM_CLASSES)
+
+/* Min-heap of waiting jobs' slots in the job table, ordered by
+   arrival (job id) */
+typedef struct waitHeap {
+  int *slots;
+  int size;
+  int capacity;
+} WaitHeap;
+
+/* A job refiled while a pass is still walking the lists */
+typedef struct deferredWaiter {
+  PCB *job;
+  WaitResource blocker;
+} DeferredWaiter;
+
+/* User jobs waiting for resources, filed under the first resource they
+   were short of. Devices are split by how many units the job needs and
+   memory by size class (floor(log2(mem_req))). A job that was short of a
+   resource cannot fit again until some of it is released, so only the
+   lists of released resources that could now satisfy their jobs are
+   looked at, in arrival order, and only until they can't any more */
+typedef struct waitList {
+  JobTable *jobs;                  // the table the heaps' slots are in
+  WaitHeap lists[WAIT_LISTS];
+  bool released[WAIT_DEVICES + 1]; // per resource, since the last beginWake
+  bool waking[WAIT_DEVICES + 1];   // resources released before this pass
+  bool inPass;
+  DeferredWaiter *deferred;        // jobs refiled during a pass
+  int numDeferred;
+  int deferredCap;
+  int waiting;
+} WaitList;
+
+void initWaitList(WaitList *w, JobTable *jobs);
+void addWaiter(WaitList *w, PCB *job, WaitResource blocker);
+void resourceReleased(WaitList *w, WaitResource resource);
+void beginWake(WaitList *w);
+PCB* nextWaiter(WaitList *w, const int available[WAIT_DEVICES], int largestMem);
+void endWake(WaitList *w);
+int waitingJobs(WaitList *w);
+PCB* oldestMemoryWaiter(WaitList *w, int minMem, int maxMem);
+void deleteWaitList(WaitList *w);
+void saveWaitList(FILE *f, WaitList *w);
+bool loadWaitList(FILE *f, WaitList *w);
+
+#endif